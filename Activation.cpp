@@ -0,0 +1,232 @@
+#include "Activation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+const float LOG2E = 1.44269504088896341f;
+const float LN2_HIGH = 0.693359375f; // ln 2 split in two so n * LN2_HIGH is exact
+const float LN2_LOW = -2.12194440e-4f;
+const float ROUNDING_SHIFT = 12582912.0f; // 1.5 * 2^23, adding and subtracting it rounds to the nearest integer
+const float EXP_MIN = -87.0f; // exp(EXP_MIN) is still a normal float
+const float EXP_MAX = 88.0f; // 2^128 would overflow the exponent field
+const std::int32_t LOG_MIN_BITS = 0x00800000; // FLT_MIN
+const float SQRT_HALF = 0.707106781186547524f;
+const float TANH_SMALL = 0.625f; // Below this |x| the odd polynomial is more accurate than the exp formula
+const float GELU_SCALE = 0.797884560802865355f; // sqrt(2 / pi)
+const float GELU_CUBIC = 0.044715f;
+const size_t GELU_BLOCK = 64; // Stack buffer of activationBackward
+
+static inline float bitsToFloat(std::int32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline std::int32_t floatToBits(float value) {
+    std::int32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Compares of non-negative floats on their bit patterns (same order) and selects with bit masks.
+// Compilers keep float compares and conditionally computed values as branches unless trapping math is
+// disabled; integer compares and masks on values that are always computed become SIMD code.
+static inline float select(bool condition, float a, float b) {
+    std::int32_t mask = -static_cast<std::int32_t>(condition);
+    return bitsToFloat((floatToBits(a) & mask) | (floatToBits(b) & ~mask));
+}
+
+static inline bool lessNonNegative(float a, float b) {
+    return floatToBits(a) < floatToBits(b);
+}
+
+static inline bool isPositive(float x) {
+    return floatToBits(x) > 0; // +0 and negative numbers are not
+}
+
+// exp(x) = 2^n * exp(r) with |r| <= ln2 / 2
+static inline float expKernel(float x) {
+    float input = x;
+    // Clamped as integers like lessNonNegative, the lower bound is applied the same way to -x
+    x = bitsToFloat(std::min(floatToBits(x), floatToBits(EXP_MAX)));
+    x = -bitsToFloat(std::min(floatToBits(-x), floatToBits(-EXP_MIN)));
+    float n = (x * LOG2E + ROUNDING_SHIFT) - ROUNDING_SHIFT;
+    float r = x - n * LN2_HIGH - n * LN2_LOW;
+    float p = 1.9875691500e-4f;
+    p = p * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    p = p * r * r + r + 1.0f;
+    float result = p * bitsToFloat((static_cast<std::int32_t>(n) + 127) << 23);
+    return select(input != input, input, result); // The integer clamps would turn NaN into a finite value
+}
+
+// log(x) = e * ln2 + log(m) with m in [sqrt(1/2), sqrt(2))
+static inline float logKernel(float x) {
+    float input = x;
+    std::int32_t bits = floatToBits(x);
+    bits = std::max(bits, LOG_MIN_BITS); // Zero, negative and denormal inputs become FLT_MIN
+    float e = static_cast<float>((bits >> 23) - 126);
+    float m = bitsToFloat((bits & 0x007fffff) | 0x3f000000); // [0.5, 1)
+    bool low = lessNonNegative(m, SQRT_HALF);
+    e = select(low, e - 1.0f, e);
+    m = select(low, m + m, m) - 1.0f;
+    float z = m * m;
+    float p = 7.0376836292e-2f;
+    p = p * m - 1.1514610310e-1f;
+    p = p * m + 1.1676998740e-1f;
+    p = p * m - 1.2420140846e-1f;
+    p = p * m + 1.4249322787e-1f;
+    p = p * m - 1.6668057665e-1f;
+    p = p * m + 2.0000714765e-1f;
+    p = p * m - 2.4999993993e-1f;
+    p = p * m + 3.3333331174e-1f;
+    float y = p * m * z + e * LN2_LOW - 0.5f * z;
+    return select(input != input, input, m + y + e * LN2_HIGH); // NaN has exponent bits too, keep it NaN
+}
+
+static inline float tanhKernel(float x) {
+    float a = std::abs(x);
+    float z = x * x;
+    float p = -5.70498872745e-3f;
+    p = p * z + 2.06390887954e-2f;
+    p = p * z - 5.37397155531e-2f;
+    p = p * z + 1.33314422036e-1f;
+    p = p * z - 3.33332819422e-1f;
+    float small = p * z * x + x;
+    float large = 1.0f - 2.0f / (expKernel(a + a) + 1.0f);
+    return select(lessNonNegative(a, TANH_SMALL), small, std::copysign(large, x));
+}
+
+static inline float sigmoidKernel(float x) {
+    return 1.0f / (1.0f + expKernel(-x));
+}
+
+static inline float geluInner(float x) {
+    return GELU_SCALE * (x + GELU_CUBIC * x * x * x);
+}
+
+const char* activationName(Activation activation) {
+    switch (activation) {
+    case Activation::Sigmoid: return "Sigmoid";
+    case Activation::Tanh: return "Tanh";
+    case Activation::LeakyReLU: return "LeakyReLU";
+    case Activation::GELU: return "GELU";
+    default: return "ReLU";
+    }
+}
+
+Activation nextActivation(Activation activation) {
+    return static_cast<Activation>((static_cast<int>(activation) + 1) % 5);
+}
+
+void vectorExp(const float* x, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = expKernel(x[i]);
+}
+
+void vectorLog(const float* x, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = logKernel(x[i]);
+}
+
+void vectorTanh(const float* x, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = tanhKernel(x[i]);
+}
+
+void vectorSigmoid(const float* x, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = sigmoidKernel(x[i]);
+}
+
+float fastExp(float x) {
+    return expKernel(x);
+}
+
+float fastLog(float x) {
+    return logKernel(x);
+}
+
+void activate(Activation activation, const float* z, float* out, size_t count) {
+    switch (activation) {
+    case Activation::Sigmoid:
+        vectorSigmoid(z, out, count);
+        break;
+    case Activation::Tanh:
+        vectorTanh(z, out, count);
+        break;
+    case Activation::LeakyReLU:
+        for (size_t i = 0; i < count; ++i) out[i] = select(isPositive(z[i]), z[i], LEAKY_RELU_SLOPE * z[i]);
+        break;
+    case Activation::GELU:
+        // Tanh approximation: 0.5 z (1 + tanh(sqrt(2 / pi) (z + 0.044715 z^3)))
+        for (size_t i = 0; i < count; ++i) out[i] = 0.5f * z[i] * (1.0f + tanhKernel(geluInner(z[i])));
+        break;
+    default:
+        for (size_t i = 0; i < count; ++i) out[i] = std::max(0.0f, z[i]);
+        break;
+    }
+}
+
+void activationBackward(Activation activation, const float* z, const float* out, const float* error, float* delta, size_t count) {
+    switch (activation) {
+    case Activation::Sigmoid:
+        for (size_t i = 0; i < count; ++i) delta[i] = error[i] * out[i] * (1.0f - out[i]);
+        break;
+    case Activation::Tanh:
+        for (size_t i = 0; i < count; ++i) delta[i] = error[i] * (1.0f - out[i] * out[i]);
+        break;
+    case Activation::LeakyReLU:
+        for (size_t i = 0; i < count; ++i) delta[i] = select(isPositive(z[i]), error[i], LEAKY_RELU_SLOPE * error[i]);
+        break;
+    case Activation::GELU:
+        // The tanh of the forward pass is recomputed in blocks instead of being stored per layer
+        for (size_t begin = 0; begin < count; begin += GELU_BLOCK) {
+            float t[GELU_BLOCK];
+            size_t n = std::min(GELU_BLOCK, count - begin);
+            const float* zb = z + begin;
+            for (size_t i = 0; i < n; ++i) t[i] = tanhKernel(geluInner(zb[i]));
+            for (size_t i = 0; i < n; ++i) {
+                float x = zb[i];
+                float derivative = 0.5f * (1.0f + t[i]) + 0.5f * x * (1.0f - t[i] * t[i]) * GELU_SCALE * (1.0f + 3.0f * GELU_CUBIC * x * x);
+                delta[begin + i] = error[begin + i] * derivative;
+            }
+        }
+        break;
+    default:
+        for (size_t i = 0; i < count; ++i) delta[i] = select(isPositive(z[i]), error[i], 0.0f);
+        break;
+    }
+}
+
+// exp(logits - max) into probabilities, returns their sum
+static float shiftedExp(const float* logits, float* probabilities, size_t count, float maxLogit) {
+    for (size_t i = 0; i < count; ++i) probabilities[i] = logits[i] - maxLogit;
+    vectorExp(probabilities, probabilities, count);
+    float sum = 0.0f;
+    for (size_t i = 0; i < count; ++i) sum += probabilities[i];
+    return sum;
+}
+
+void softmax(const float* logits, float* probabilities, size_t count) {
+    if (count == 0) return;
+    float maxLogit = *std::max_element(logits, logits + count);
+    float sum = shiftedExp(logits, probabilities, count, maxLogit);
+    for (size_t i = 0; i < count; ++i) probabilities[i] /= sum;
+}
+
+float softmaxCrossEntropy(const float* logits, float* probabilities, float* gradient, size_t count, int label) {
+    if (count == 0) return 0.0f;
+    bool labeled = label >= 0 && label < static_cast<int>(count);
+    float labelLogit = labeled ? logits[label] : 0.0f; // Read first, logits may alias probabilities
+    float maxLogit = *std::max_element(logits, logits + count);
+    float sum = shiftedExp(logits, probabilities, count, maxLogit);
+    for (size_t i = 0; i < count; ++i) probabilities[i] /= sum;
+    if (gradient) {
+        for (size_t i = 0; i < count; ++i) gradient[i] = probabilities[i];
+    }
+    if (!labeled) return 0.0f;
+    if (gradient) gradient[label] -= 1.0f;
+    // -log p = log(sum exp(z - max)) - (z_label - max), sum >= 1 so the log is always well conditioned
+    return std::min(logKernel(sum) - (labelLogit - maxLogit), MAX_SAMPLE_LOSS); // In this order std::min keeps a NaN loss
+}
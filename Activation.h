@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+
+// Nonlinearity of a hidden dense/convolution layer, selectable per layer (A key on a selected layer).
+// The output layer always uses softmax, pooling layers have no activation.
+enum class Activation { ReLU = 0, Sigmoid = 1, Tanh = 2, LeakyReLU = 3, GELU = 4 };
+
+const float LEAKY_RELU_SLOPE = 0.01f; // Slope of LeakyReLU for negative inputs
+const float MAX_SAMPLE_LOSS = 13.815511f; // -log(1e-6), cross-entropy is clamped like Network::computeLoss always did
+
+const char* activationName(Activation activation); // Short name used in the GUI and logs
+Activation nextActivation(Activation activation); // Cycle order of the GUI (ReLU -> Sigmoid -> Tanh -> LeakyReLU -> GELU)
+
+// Vectorized float math. Cephes-style polynomial approximations after range reduction, written as
+// branch-free loops over arrays so the compiler turns them into SIMD code; results are within a few ULP
+// of the C library. exp saturates below -87 (no denormals) and above 88 to about 1.65e38 rather than inf,
+// log treats inputs below FLT_MIN as FLT_MIN. NaN inputs give NaN, so a diverged network shows NaN losses.
+void vectorExp(const float* x, float* out, size_t count);
+void vectorLog(const float* x, float* out, size_t count);
+void vectorTanh(const float* x, float* out, size_t count);
+void vectorSigmoid(const float* x, float* out, size_t count);
+float fastExp(float x); // Scalar versions, same results as the array functions
+float fastLog(float x);
+
+// out = f(z), z and out may be the same array
+void activate(Activation activation, const float* z, float* out, size_t count);
+// delta = error * f'(z), out holds f(z) from the forward pass (sigmoid and tanh derivatives use it)
+void activationBackward(Activation activation, const float* z, const float* out, const float* error, float* delta, size_t count);
+
+// Numerically stable softmax (the maximum logit is subtracted first)
+void softmax(const float* logits, float* probabilities, size_t count);
+// Fused softmax + cross-entropy: writes the probabilities and dL/dlogits = p - onehot(label) in one pass
+// and returns the clamped loss from log-sum-exp, without taking the log of a rounded probability.
+// gradient may be nullptr; a label outside [0, count) gives loss 0 and gradient p.
+float softmaxCrossEntropy(const float* logits, float* probabilities, float* gradient, size_t count, int label);
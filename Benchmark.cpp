@@ -0,0 +1,252 @@
+#include "Benchmark.h"
+#include "Network.h"
+#include "Checkpoint.h"
+#include "Export.h"
+#include "Sweep.h"
+#include "GUI.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <iostream>
+#include <type_traits>
+#if __has_include("ExportedNetwork.h")
+#include "ExportedNetwork.h"
+#define HAS_EXPORTED_NETWORK
+#endif
+#if __has_include("ExportedModel.h")
+#include "ExportedModel.h"
+#define HAS_EXPORTED_MODEL
+#endif
+
+// Seconds elapsed since start
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void runSpecializedBenchmark([[maybe_unused]] const std::vector<std::pair<int, std::vector<float>>>& dataset, [[maybe_unused]] float learning_rate) {
+#ifndef HAS_EXPORTED_NETWORK
+    std::cout << "No ExportedNetwork.h found. Build a network, press E to export it and rebuild." << std::endl;
+#else
+    if (dataset.empty()) return;
+    Checkpoint checkpoint;
+    if (!loadCheckpoint(EXPORTED_CHECKPOINT, checkpoint)) return;
+
+    Network generic(checkpoint, learning_rate, 1); // Input shape, layer types and activations of the checkpoint
+    std::unique_ptr<ExportedNetwork> specialized(new ExportedNetwork());
+    if (!generic.isReady() || !specialized->setCheckpoint(checkpoint)) {
+        std::cout << EXPORTED_CHECKPOINT << " does not match ExportedNetwork.h, export again and rebuild." << std::endl;
+        return;
+    }
+
+    // Both builds must agree before timing them
+    float maxDiff = 0.f;
+    int agree = 0;
+    for (auto& sample : dataset) {
+        std::vector<float> out = generic.forwardPass(sample);
+        const float* staticOut = specialized->forwardPass(sample.second.data());
+        for (int i = 0; i < ExportedNetwork::outputSize; ++i) {
+            maxDiff = std::max(maxDiff, std::abs(out[i] - staticOut[i]));
+        }
+        if (generic.predict(out) == specialized->predict(sample.second.data())) agree++;
+    }
+    std::cout << "Max output difference: " << maxDiff << ", same prediction on " << agree << "/" << dataset.size() << " samples" << std::endl;
+
+    const int passes = 5;
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < passes; ++p) {
+        for (auto& sample : dataset) generic.forwardPass(sample);
+    }
+    double genericInference = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    volatile int sink = 0;
+    for (int p = 0; p < passes; ++p) {
+        for (auto& sample : dataset) sink += specialized->predict(sample.second.data());
+    }
+    double staticInference = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for (auto& sample : dataset) {
+        generic.forwardPass(sample);
+        generic.backPropagation(sample);
+    }
+    double genericTraining = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for (auto& sample : dataset) {
+        specialized->forwardPass(sample.second.data());
+        specialized->backPropagation(sample.second.data(), sample.first, learning_rate);
+    }
+    double staticTraining = secondsSince(start);
+
+    double samples = static_cast<double>(dataset.size());
+    std::cout << "Inference: runtime " << samples * passes / genericInference << " samples/s, specialized "
+        << samples * passes / staticInference << " samples/s (x" << genericInference / staticInference << ")" << std::endl;
+    std::cout << "Training:  runtime " << samples / genericTraining << " samples/s, specialized "
+        << samples / staticTraining << " samples/s (x" << genericTraining / staticTraining << ")" << std::endl;
+#endif
+}
+
+bool runExportCheck([[maybe_unused]] const std::vector<std::pair<int, std::vector<float>>>& dataset) {
+    if (!checkFloatLiterals() || !checkStringLiterals()) return false;
+#ifndef HAS_EXPORTED_MODEL
+    std::cout << "No ExportedModel.h found. Build a network, press X (Shift+X for int8) to export it and rebuild." << std::endl;
+    return false;
+#else
+    Checkpoint checkpoint;
+    if (dataset.empty() || !loadCheckpoint(exported_model::CHECKPOINT, checkpoint)) return false;
+    if (checkpoint.sizes.front() != exported_model::INPUT_SIZE || checkpoint.sizes.back() != exported_model::OUTPUT_SIZE) {
+        std::cout << exported_model::CHECKPOINT << " does not match ExportedModel.h, export again and rebuild." << std::endl;
+        return false;
+    }
+    Network network(checkpoint, 0.f, 1);
+
+    float maxDiff = 0.f;
+    int agree = 0;
+    float exported[exported_model::OUTPUT_SIZE];
+    for (auto& sample : dataset) {
+        std::vector<float> out = network.forwardPass(sample);
+        exported_model::forward(sample.second.data(), exported);
+        for (int i = 0; i < exported_model::OUTPUT_SIZE; ++i) {
+            maxDiff = std::max(maxDiff, std::abs(out[i] - exported[i]));
+        }
+        if (network.predict(out) == exported_model::predict(sample.second.data())) agree++;
+    }
+
+    // Float weights are written exactly, only the summation order differs; int8 is judged by its predictions
+    bool quantized = !std::is_same<std::remove_cv<std::remove_extent<decltype(exported_model::layer0_weights)>::type>::type, float>::value;
+    float agreement = static_cast<float>(agree) / dataset.size();
+    bool passed = quantized ? agreement >= 0.98f : maxDiff <= 1e-4f;
+    std::cout << "Exported model (" << (quantized ? "int8" : "float") << "): max output difference " << maxDiff
+        << ", same prediction on " << agree << "/" << dataset.size() << " samples: " << (passed ? "PASSED" : "FAILED") << std::endl;
+    return passed;
+#endif
+}
+// Sample upscaled to width x width by nearest pixel, channel by channel
+static void upscale(const DatasetView& dataset, size_t index, int width, std::pair<int, std::vector<float>>& out) {
+    Shape shape = dataset.shape().input;
+    std::vector<float> source(dataset.inputSize());
+    dataset.input(index, source.data());
+    out.first = dataset.label(index);
+    out.second.resize(static_cast<size_t>(shape.channels) * width * width);
+    for (int c = 0; c < shape.channels; ++c) {
+        for (int y = 0; y < width; ++y) {
+            for (int x = 0; x < width; ++x) {
+                out.second[(c * width + y) * width + x] = source[(c * shape.height + y * shape.height / width) * shape.width + x * shape.width / width];
+            }
+        }
+    }
+}
+
+void runInputScalingBenchmark(const DatasetView& dataset, const std::vector<int>& widths) {
+    if (dataset.empty() || widths.empty()) return;
+    DataShape data = dataset.shape();
+    std::string classes = std::to_string(std::max(2, data.classes));
+    size_t count = std::min(dataset.size(), INPUT_SCALING_SAMPLES);
+    std::cout << "Training throughput by input width (" << count << " samples of " << data.input.channels << "x" << data.input.height
+        << "x" << data.input.width << ", " << data.classes << " classes)" << std::endl;
+
+    for (const std::string& topology : { "128-" + classes, "c8-m-c16-m-64-" + classes }) {
+        SweepRun run;
+        parseTopology(topology, run);
+        std::cout << "Topology " << topology << ":" << std::endl;
+        double baseNanoseconds = 0.0;
+        for (int width : widths) {
+            std::vector<std::pair<int, std::vector<float>>> samples(count);
+            for (size_t i = 0; i < count; ++i) upscale(dataset, i, width, samples[i]);
+            Shape input = { data.input.channels, width, width };
+            Network network(run.sizes, 0.001f, 1, run.types, {}, input);
+            if (!network.isReady()) continue;
+
+            auto start = std::chrono::steady_clock::now();
+            for (auto& sample : samples) {
+                network.forwardPass(sample);
+                network.backPropagation(sample);
+            }
+            double seconds = secondsSince(start);
+            double nanoseconds = seconds * 1e9 / (static_cast<double>(count) * input.size());
+            if (baseNanoseconds == 0.0) baseNanoseconds = nanoseconds;
+            std::cout << "  " << width << "x" << width << " (" << input.size() << " inputs): " << count / seconds << " samples/s, "
+                << nanoseconds << " ns per input value (x" << nanoseconds / baseNanoseconds << " of the first width)" << std::endl;
+        }
+    }
+}
+
+// Mean milliseconds per frame, events are drained so the window stays responsive.
+// drawCalls receives the draw calls the window counted per timed frame.
+template <typename DrawFrame>
+static double timeFrames(GUI& window, DrawFrame drawFrame, size_t& drawCalls) {
+    auto renderFrame = [&](int frame) {
+        sf::Event event;
+        while (window.pollEvent(event)) {}
+        window.clear(sf::Color::White);
+        drawFrame(frame);
+        window.display();
+    };
+    for (int frame = 0; frame < 10; ++frame) renderFrame(frame); // Warm-up: texture uploads, driver caches
+    window.takeDrawCalls();
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAME_BENCHMARK_FRAMES; ++frame) renderFrame(frame);
+    double milliseconds = secondsSince(start) * 1000.0 / FRAME_BENCHMARK_FRAMES;
+    drawCalls = window.takeDrawCalls() / FRAME_BENCHMARK_FRAMES;
+    return milliseconds;
+}
+
+void runFrameBenchmark(const DatasetView& dataset) {
+    if (dataset.empty()) return;
+    GUI window(1000, 600, "Frame benchmark");
+    window.setFramerateLimit(0); // Measure the renderer, not the limiter
+    window.setVerticalSyncEnabled(false);
+    for (int l = 0; l < FRAME_BENCHMARK_LAYERS; ++l) {
+        window.addLayer();
+        window.addNeuron(window.getLayerList().back(), FRAME_BENCHMARK_NEURONS);
+        for (int n = 0; n < FRAME_BENCHMARK_NEURONS; n += 2) window.getLayerList().back()->getNeuronList()[n]->setActive(true);
+    }
+    Input* input = window.getInput();
+    DataShape shape = dataset.shape();
+    size_t lineCount = window.drawLines().size();
+
+    // Layer rectangles, one neuron batch per layer, the connections, the grid frame and its sprite
+    size_t batchedCalls = 0;
+    double batched = timeFrames(window, [&](int frame) {
+        window.drawLayers();
+        input->showInGridArr(dataset.pixels(frame % dataset.size()), shape.input);
+        for (auto& layer : window.getLayerList()) window.drawNeurons(layer);
+        window.drawConnections(window.drawLines());
+        window.drawInput();
+    }, batchedCalls);
+
+    // The same frame with one draw call per cell, neuron and line
+    size_t separateCalls = 0;
+    sf::RectangleShape frameShape(sf::Vector2f(GRID_COUNT * CELL_SIZE, GRID_COUNT * CELL_SIZE));
+    frameShape.setOutlineColor(sf::Color::Black);
+    frameShape.setOutlineThickness(3.f);
+    frameShape.setPosition(input->getPosition());
+    sf::RectangleShape cell(sf::Vector2f(CELL_SIZE, CELL_SIZE));
+    double separate = timeFrames(window, [&](int frame) {
+        window.drawLayers();
+        input->showInGridArr(dataset.pixels(frame % dataset.size()), shape.input);
+        for (auto& layer : window.getLayerList()) {
+            for (auto& neuron : layer->getNeuronList()) neuron->draw(window);
+        }
+        for (auto& line : window.drawLines()) window.draw(line.data(), 2, sf::Lines);
+        window.draw(frameShape);
+        std::vector<float> values = input->getData();
+        for (int row = 0; row < GRID_COUNT; ++row) {
+            for (int col = 0; col < GRID_COUNT; ++col) {
+                sf::Uint8 gray = static_cast<sf::Uint8>(255.f - values[row * GRID_COUNT + col] * 255.f + 0.5f);
+                cell.setFillColor(sf::Color(gray, gray, gray));
+                cell.setPosition(input->getPosition().x + col * CELL_SIZE, input->getPosition().y + row * CELL_SIZE);
+                window.draw(cell);
+            }
+        }
+    }, separateCalls);
+
+    std::cout << "Frame time over " << FRAME_BENCHMARK_FRAMES << " frames (" << FRAME_BENCHMARK_LAYERS << " layers of "
+        << FRAME_BENCHMARK_NEURONS << " neurons, " << lineCount << " connections, a new " << shape.input.height << "x"
+        << shape.input.width << " sample every frame):" << std::endl;
+    std::cout << "  Batched: " << batched << " ms (" << batchedCalls << " draw calls, " << 1000.0 / batched << " fps)" << std::endl;
+    std::cout << "  One call per shape: " << separate << " ms (" << separateCalls << " draw calls, " << 1000.0 / separate
+        << " fps, x" << separate / batched << " of batched)" << std::endl;
+}
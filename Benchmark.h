@@ -0,0 +1,29 @@
+#pragma once
+#include "Dataset.h"
+#include <vector>
+#include <utility>
+
+// Command line benchmarks (run the app with --bench)
+
+// Compares the StaticNetwork from ExportedNetwork.h against the runtime Network on the same checkpoint
+void runSpecializedBenchmark(const std::vector<std::pair<int, std::vector<float>>>& dataset, float learning_rate);
+
+// Checks the standalone header in ExportedModel.h against the runtime Network (run the app with --check-export).
+// Returns false if the outputs differ by more than the tolerance (float export) or predictions disagree too often (int8).
+bool runExportCheck(const std::vector<std::pair<int, std::vector<float>>>& dataset);
+
+const size_t INPUT_SCALING_SAMPLES = 200; // Training samples timed per input width and topology
+
+// Training throughput as the input grows (run the app with --bench-inputs [28,56,112,224]).
+// Every sample of the dataset is upscaled to each width by nearest pixel, so the images and their sparsity stay
+// the same, and a dense and a convolutional network are trained on them. Prints samples/s and ns per input value.
+void runInputScalingBenchmark(const DatasetView& dataset, const std::vector<int>& widths);
+
+const int FRAME_BENCHMARK_FRAMES = 600; // Frames timed per renderer
+const int FRAME_BENCHMARK_LAYERS = 3;
+const int FRAME_BENCHMARK_NEURONS = 10; // Per layer, drawn in detail (at most DETAIL_NEURONS)
+
+// Frame time of the main window (run the app with --bench-frame). A small network with selected neurons and its
+// connections is drawn next to the input grid, which shows a new dataset sample every frame like during training.
+// The batched renderer of the app is compared with drawing every cell, neuron and line on its own.
+void runFrameBenchmark(const DatasetView& dataset);
@@ -1,4 +1,5 @@
 #include "Button.h"
+#include "GUI.h"
 Button::Button(sf::String txt, const sf::String f) {
     shape.setSize(sf::Vector2f(180.f, 70.f)); // Set button size
     shape.setFillColor(sf::Color::Green); // Default color
@@ -20,7 +21,7 @@ void Button::setPosition(float x, float y) {
     text.setPosition(textX, textY);
 }
 
-void Button::draw(sf::RenderWindow& window) {
+void Button::draw(GUI& window) {
     window.draw(shape); // Draw button shape
     window.draw(text); // Draw button text
 }
@@ -49,3 +50,16 @@ bool Button::isPressed(sf::Event &event, sf::RenderWindow &window) {
     }
     return false; // Not clicked
 }
+
+bool Button::isRightClicked(sf::Event& event, sf::RenderWindow& window) {
+    if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Right) {
+        sf::Vector2i mouse_pos = sf::Mouse::getPosition(window);
+        sf::Vector2f mouse_world = window.mapPixelToCoords(mouse_pos);
+        return this->getBounds().contains(mouse_world);
+    }
+    return false;
+}
+
+void Button::setText(sf::String txt) {
+    text.setString(txt); // Position is updated by setPosition on the next frame
+}
\ No newline at end of file
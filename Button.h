@@ -3,6 +3,8 @@
 #include <SFML/Window.hpp>
 #include <iostream>
 
+class GUI;
+
 // Button class for GUI interactions
 class Button
 {
@@ -15,8 +17,10 @@ private:
 public:
 	Button(sf::String txt, sf::String f = "assets/font.ttf"); // Constructor
 	void setPosition(float x, float y); // Set position of button
-	void draw(sf::RenderWindow& window); // Draw button on screen
+	void draw(GUI& window); // Draw button on screen
 	sf::FloatRect getBounds(); // Get button boundaries for interaction
 	bool isPressed(sf::Event& event, sf::RenderWindow& window); // Check for mouse press event
+	bool isRightClicked(sf::Event& event, sf::RenderWindow& window); // Check for right mouse press event
+	void setText(sf::String txt); // Change button label
 };
 
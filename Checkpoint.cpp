@@ -0,0 +1,151 @@
+#include "Checkpoint.h"
+#include "Trace.h"
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+// Shape::size and weightsPerNeuron in 64 bits, so the dimensions of a corrupt file cannot wrap around
+static std::uint64_t wideSize(const Shape& shape) {
+    return static_cast<std::uint64_t>(shape.channels) * static_cast<std::uint64_t>(shape.height) * static_cast<std::uint64_t>(shape.width);
+}
+
+static std::uint64_t wideWeightsPerNeuron(LayerType type, const Shape& input) {
+    if (type == LayerType::Conv2D) return static_cast<std::uint64_t>(input.channels) * CONV_KERNEL * CONV_KERNEL;
+    return hasParameters(type) ? wideSize(input) : 0;
+}
+
+size_t Checkpoint::expectedParamCount() const {
+    std::uint64_t count = 0;
+    Shape shape = input;
+    for (size_t i = 1; i < sizes.size(); ++i) {
+        LayerType type = (i - 1 < types.size()) ? static_cast<LayerType>(types[i - 1]) : LayerType::Dense;
+        if (hasParameters(type)) {
+            count += static_cast<std::uint64_t>(sizes[i]) * (wideWeightsPerNeuron(type, shape) + 1); // weights + bias per neuron
+        }
+        shape = outputShape(type, shape, sizes[i]);
+    }
+    return static_cast<size_t>(count);
+}
+
+bool Checkpoint::fitsInt() const {
+    const std::uint64_t limit = static_cast<std::uint64_t>(std::numeric_limits<int>::max());
+    Shape shape = input;
+    if (wideSize(shape) > limit) return false;
+    for (size_t i = 1; i < sizes.size(); ++i) {
+        LayerType type = (i - 1 < types.size()) ? static_cast<LayerType>(types[i - 1]) : LayerType::Dense;
+        std::uint64_t weights = wideWeightsPerNeuron(type, shape) + 1;
+        if (weights > limit || static_cast<std::uint64_t>(sizes[i]) * weights > limit) return false;
+        shape = outputShape(type, shape, sizes[i]);
+        if (wideSize(shape) > limit) return false;
+    }
+    return true;
+}
+
+// File layout: magic, layer count (including input), sizes, layer types, input shape, parameters, activations.
+// The activations come last so files written before they existed still load (as ReLU networks).
+bool saveCheckpoint(const std::string& path, const Checkpoint& checkpoint) {
+    TraceScope trace("Save checkpoint", "io");
+    if (checkpoint.params.size() != checkpoint.expectedParamCount()) {
+        std::cerr << "Checkpoint has " << checkpoint.params.size() << " parameters, expected "
+            << checkpoint.expectedParamCount() << std::endl;
+        return false;
+    }
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error writing checkpoint " << path << std::endl;
+        return false;
+    }
+    std::uint32_t count = static_cast<std::uint32_t>(checkpoint.sizes.size());
+    file.write(reinterpret_cast<const char*>(&CHECKPOINT_MAGIC), sizeof(CHECKPOINT_MAGIC));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char*>(checkpoint.sizes.data()), count * sizeof(int));
+    std::vector<int> types(checkpoint.types);
+    types.resize(count - 1, static_cast<int>(LayerType::Dense));
+    file.write(reinterpret_cast<const char*>(types.data()), types.size() * sizeof(int));
+    file.write(reinterpret_cast<const char*>(&checkpoint.input), sizeof(Shape));
+    file.write(reinterpret_cast<const char*>(checkpoint.params.data()), checkpoint.params.size() * sizeof(float));
+    std::vector<int> activations(checkpoint.activations);
+    activations.resize(count - 1, static_cast<int>(Activation::ReLU));
+    file.write(reinterpret_cast<const char*>(activations.data()), activations.size() * sizeof(int));
+    return static_cast<bool>(file);
+}
+
+bool loadCheckpoint(const std::string& path, Checkpoint& checkpoint) {
+    TraceScope trace("Load checkpoint", "io");
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error loading checkpoint " << path << std::endl;
+        return false;
+    }
+    std::uint32_t magic = 0, count = 0;
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!file || magic != CHECKPOINT_MAGIC || count < 2 || count > CHECKPOINT_MAX_LAYERS) {
+        std::cerr << path << " is not a valid checkpoint" << std::endl;
+        return false;
+    }
+    checkpoint.sizes.resize(count);
+    file.read(reinterpret_cast<char*>(checkpoint.sizes.data()), count * sizeof(int));
+    checkpoint.types.resize(count - 1);
+    if (file) file.read(reinterpret_cast<char*>(checkpoint.types.data()), checkpoint.types.size() * sizeof(int));
+    if (file) file.read(reinterpret_cast<char*>(&checkpoint.input), sizeof(Shape));
+    if (!file) {
+        std::cerr << path << " is truncated" << std::endl;
+        return false;
+    }
+    for (int size : checkpoint.sizes) {
+        if (size <= 0) {
+            std::cerr << path << " has an invalid layer size" << std::endl;
+            return false;
+        }
+    }
+    for (int type : checkpoint.types) {
+        if (type < 0 || type > static_cast<int>(LayerType::AvgPool)) {
+            std::cerr << path << " has an unknown layer type" << std::endl;
+            return false;
+        }
+    }
+    // Bounded dimensions keep the 64-bit shape products exact, fitsInt then rules out every int overflow
+    const Shape& input = checkpoint.input;
+    if (input.channels <= 0 || input.height <= 0 || input.width <= 0 || input.channels > CHECKPOINT_MAX_DIMENSION
+        || input.height > CHECKPOINT_MAX_DIMENSION || input.width > CHECKPOINT_MAX_DIMENSION
+        || wideSize(input) != static_cast<std::uint64_t>(checkpoint.sizes[0])) {
+        std::cerr << path << " has an invalid input shape" << std::endl;
+        return false;
+    }
+    if (!checkpoint.fitsInt()) {
+        std::cerr << path << " has layers too large to load" << std::endl;
+        return false;
+    }
+    // The parameters must fit in the rest of the file before anything is allocated for them
+    std::streamoff start = file.tellg();
+    file.seekg(0, std::ios::end);
+    std::streamoff remaining = file.tellg() - start;
+    file.seekg(start);
+    size_t paramCount = checkpoint.expectedParamCount();
+    if (!file || paramCount > static_cast<std::uint64_t>(remaining) / sizeof(float)) {
+        std::cerr << path << " is truncated" << std::endl;
+        return false;
+    }
+    checkpoint.params.resize(paramCount);
+    file.read(reinterpret_cast<char*>(checkpoint.params.data()), checkpoint.params.size() * sizeof(float));
+    if (!file) {
+        std::cerr << path << " is truncated" << std::endl;
+        return false;
+    }
+    checkpoint.activations.assign(count - 1, static_cast<int>(Activation::ReLU));
+    if (file.peek() != std::ifstream::traits_type::eof()) {
+        file.read(reinterpret_cast<char*>(checkpoint.activations.data()), checkpoint.activations.size() * sizeof(int));
+        if (!file) {
+            std::cerr << path << " is truncated" << std::endl;
+            return false;
+        }
+        for (int activation : checkpoint.activations) {
+            if (activation < 0 || activation > static_cast<int>(Activation::GELU)) {
+                std::cerr << path << " has an unknown activation" << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
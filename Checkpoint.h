@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Shape.h"
+#include "Activation.h"
+
+// Magic number at the start of every checkpoint file ("NNCK")
+const std::uint32_t CHECKPOINT_MAGIC = 0x4B434E4E;
+const std::uint32_t CHECKPOINT_MAX_LAYERS = 4096; // Layer counts above this are treated as a corrupt file
+const int CHECKPOINT_MAX_DIMENSION = 65536; // Input channels, heights and widths above this are treated as a corrupt file
+
+// Plain, GUI-independent copy of a trained network's parameters.
+// Used to save/load models and to move weights between the runtime Network and other backends.
+struct Checkpoint
+{
+	Shape input = DEFAULT_INPUT_SHAPE; // Shape of one input sample
+	std::vector<int> types; // LayerType of every layer
+	std::vector<int> activations; // Activation of every layer (ReLU where missing, ignored for pooling and the output layer)
+	std::vector<int> sizes; // Input size followed by the neuron count of every layer
+	std::vector<float> params; // For every dense/conv layer and neuron: incoming weights followed by the bias
+
+	size_t expectedParamCount() const; // Number of parameters implied by sizes
+	bool fitsInt() const; // False if a layer shape, weights per neuron or layer parameter count overflows int
+};
+
+bool saveCheckpoint(const std::string& path, const Checkpoint& checkpoint); // Write checkpoint as binary file
+bool loadCheckpoint(const std::string& path, Checkpoint& checkpoint); // Read checkpoint, false on any format error
@@ -0,0 +1,354 @@
+#include "DataParallel.h"
+#include "Network.h"
+#include "Random.h"
+#include "Sweep.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <numeric>
+#include <sstream>
+#include <thread>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Rank buffers start on their own cache lines so neighbours never share one
+const size_t FLOATS_PER_LINE = 16;
+
+// Result slots written by every rank
+const int RESULT_SECONDS = 0; // Training time between the start and end barriers
+const int RESULT_LOSS = 1; // Summed loss of the last epoch (all ranks, after the all-reduce)
+const int RESULT_CHECKSUM = 2; // Weighted sum of the final parameters, equal on all ranks if they stayed in sync
+const int RESULT_ACCURACY = 3; // Validation accuracy (rank 0 only)
+
+RingAllReduce::RingAllReduce(int ranks, size_t count) : ranks(std::max(1, ranks)), count(count) {
+    stride = (count + FLOATS_PER_LINE - 1) / FLOATS_PER_LINE * FLOATS_PER_LINE;
+    size_t controlBytes = 64;
+    size_t bufferBytes = this->ranks * stride * sizeof(float);
+    size_t reportBytes = this->ranks * RESULT_SLOTS * sizeof(double);
+    length = controlBytes + bufferBytes + reportBytes;
+#ifndef _WIN32
+    void* shared = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        std::cerr << "Error mapping " << length << " bytes of shared memory" << std::endl;
+        return;
+    }
+    mapping = shared;
+    std::uint8_t* bytes = static_cast<std::uint8_t*>(mapping);
+    // Lock-free atomics hold no pointers, so they work across processes in a shared mapping
+    control = new (bytes) Control();
+    control->arrived = 0;
+    control->generation = 0;
+    control->aborted = 0;
+    buffers = reinterpret_cast<float*>(bytes + controlBytes);
+    report = reinterpret_cast<double*>(bytes + controlBytes + bufferBytes);
+#endif
+}
+
+RingAllReduce::~RingAllReduce() {
+#ifndef _WIN32
+    if (mapping) munmap(mapping, length);
+#endif
+}
+
+bool RingAllReduce::valid() const {
+    return mapping != nullptr;
+}
+
+float* RingAllReduce::buffer(int rank) {
+    return buffers + rank * stride;
+}
+
+double* RingAllReduce::results(int rank) {
+    return report + rank * RESULT_SLOTS;
+}
+
+size_t RingAllReduce::chunkBegin(int chunk) const {
+    return count * chunk / ranks;
+}
+
+// Sense-free barrier: the last rank to arrive resets the counter and starts the next generation
+bool RingAllReduce::barrier() {
+    int generation = control->generation.load(std::memory_order_acquire);
+    if (control->arrived.fetch_add(1, std::memory_order_acq_rel) == ranks - 1) {
+        control->arrived.store(0, std::memory_order_relaxed);
+        control->generation.fetch_add(1, std::memory_order_release);
+    }
+    else {
+        while (control->generation.load(std::memory_order_acquire) == generation) {
+            if (control->aborted.load(std::memory_order_relaxed)) return false;
+            std::this_thread::yield();
+        }
+    }
+    return !control->aborted.load(std::memory_order_relaxed);
+}
+
+void RingAllReduce::abort() {
+    control->aborted = 1;
+}
+
+// Reduce-scatter then all-gather around the ring. In step k rank r works on chunk (r - k - 1) (reduce) or
+// (r - k) (gather) and reads it from rank r - 1, which finished that chunk in step k - 1 and is now writing
+// a different one. After the reduce phase rank r holds the full sum of chunk r + 1; the gather phase
+// copies every summed chunk once around the ring, so all ranks end with bit-identical buffers.
+// The last barrier lets every rank refill its buffer as soon as reduce returns.
+bool RingAllReduce::reduce(int rank) {
+    float* own = buffer(rank);
+    const float* left = buffer((rank + ranks - 1) % ranks);
+    if (ranks > 1 && !barrier()) return false; // Every rank has filled its buffer
+    for (int step = 0; step < ranks - 1; ++step) {
+        int chunk = ((rank - step - 1) % ranks + ranks) % ranks;
+        for (size_t i = chunkBegin(chunk); i < chunkBegin(chunk + 1); ++i) {
+            own[i] += left[i];
+        }
+        if (!barrier()) return false;
+    }
+    for (int step = 0; step < ranks - 1; ++step) {
+        int chunk = ((rank - step) % ranks + ranks) % ranks;
+        std::copy(left + chunkBegin(chunk), left + chunkBegin(chunk + 1), own + chunkBegin(chunk));
+        if (!barrier()) return false;
+    }
+    return true;
+}
+
+// Hyperparameters shared by all runs
+struct DataParallelSpec
+{
+	std::vector<int> sizes;
+	std::vector<LayerType> types;
+	float learningRate = 0.f;
+	int epochs = 1;
+	size_t batch = 32;
+	size_t trainCount = 0; // Samples before the validation split
+};
+
+// Weighted parameter sum, distinguishes copies that drifted apart
+static double checksum(const Checkpoint& checkpoint) {
+    double sum = 0.0;
+    for (size_t i = 0; i < checkpoint.params.size(); ++i) {
+        sum += checkpoint.params[i] * static_cast<double>(i % 97 + 1);
+    }
+    return sum;
+}
+
+// One process of the group: trains its shard of every batch. The summed gradients give the same step
+// as one process training the whole batch
+static bool trainRank(int rank, int ranks, RingAllReduce& ring, const Checkpoint& start, const DataParallelSpec& spec,
+    const DatasetView& dataset, const std::string& outPath) {
+    Network network(start, spec.learningRate, spec.epochs);
+    int layerCount = network.getLayerCount();
+    std::vector<std::vector<float>> gradients(layerCount);
+    std::vector<size_t> offsets(layerCount + 1, 0);
+    for (int l = 0; l < layerCount; ++l) {
+        gradients[l].assign(network.gradientSize(l), 0.0f);
+        offsets[l + 1] = offsets[l] + gradients[l].size();
+    }
+    float* shared = ring.buffer(rank);
+    double* results = ring.results(rank);
+    std::fill(results, results + RingAllReduce::RESULT_SLOTS, 0.0);
+
+    std::vector<size_t> order(spec.trainCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::pair<int, std::vector<float>> sample;
+    Workspace work;
+
+    if (!ring.barrier()) return false;
+    auto startTime = std::chrono::steady_clock::now();
+    for (int epoch = 0; epoch < spec.epochs; ++epoch) {
+        RandomStream generator = randomStream(epoch); // Same order in every process
+        std::shuffle(order.begin(), order.end(), generator);
+        double epochLoss = 0.0;
+        for (size_t begin = 0; begin < order.size(); begin += spec.batch) {
+            size_t length = std::min(spec.batch, order.size() - begin);
+            float loss = 0.f;
+            for (size_t i = begin + length * rank / ranks; i < begin + length * (rank + 1) / ranks; ++i) {
+                dataset.sample(order[i], sample);
+                network.prepareWorkspace(work, sample.second);
+                for (int l = 0; l < layerCount; ++l) network.forwardLayer(l, work);
+                loss += network.outputError(sample.first, work);
+                for (int l = layerCount - 1; l >= 0; --l) network.backwardLayer(l, work, gradients[l]);
+            }
+
+            // Gradients and loss travel in one buffer
+            for (int l = 0; l < layerCount; ++l) {
+                std::copy(gradients[l].begin(), gradients[l].begin() + (offsets[l + 1] - offsets[l]), shared + offsets[l]);
+            }
+            shared[offsets[layerCount]] = loss;
+            if (!ring.reduce(rank)) return false;
+            for (int l = 0; l < layerCount; ++l) {
+                std::copy(shared + offsets[l], shared + offsets[l + 1], gradients[l].begin());
+                network.applyGradients(l, gradients[l], 1.0f);
+            }
+            epochLoss += shared[offsets[layerCount]];
+        }
+        results[RESULT_LOSS] = epochLoss;
+    }
+    if (!ring.barrier()) return false;
+    results[RESULT_SECONDS] = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    Checkpoint trained = network.getCheckpoint();
+    results[RESULT_CHECKSUM] = checksum(trained);
+    if (rank == 0) {
+        int correct = 0;
+        for (size_t i = spec.trainCount; i < dataset.size(); ++i) {
+            dataset.sample(i, sample);
+            auto out = network.forwardPass(sample);
+            if (network.predict(out) == sample.first) correct++;
+        }
+        results[RESULT_ACCURACY] = static_cast<double>(correct) / (dataset.size() - spec.trainCount);
+        saveCheckpoint(outPath, trained);
+    }
+    return true;
+}
+
+// Forks one process per rank and waits for all of them; a failing process releases the others
+static bool runGroup(int ranks, RingAllReduce& ring, const Checkpoint& start, const DataParallelSpec& spec,
+    const DatasetView& dataset, const std::string& outPath) {
+#ifdef _WIN32
+    return false;
+#else
+    // Every process gets its share of the hardware threads for its own layer loops
+    int threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / ranks);
+    std::cout.flush();
+    std::vector<pid_t> children;
+    for (int rank = 0; rank < ranks; ++rank) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            setTaskSchedulerWorkers(threads - 1);
+            bool ok = trainRank(rank, ranks, ring, start, spec, dataset, outPath);
+            std::cout.flush();
+            _exit(ok ? 0 : 1);
+        }
+        if (pid < 0) {
+            std::cerr << "Error starting training process " << rank << std::endl;
+            ring.abort();
+            break;
+        }
+        children.push_back(pid);
+    }
+
+    bool ok = static_cast<int>(children.size()) == ranks;
+    for (size_t i = 0; i < children.size(); ++i) {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) break;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ok = false;
+            ring.abort();
+        }
+    }
+    return ok;
+#endif
+}
+
+// Splits text at every separator
+static std::vector<std::string> splitList(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator)) {
+        if (!part.empty()) parts.push_back(part);
+    }
+    return parts;
+}
+
+void runDataParallel(const DatasetView& dataset, const std::vector<std::string>& args) {
+#ifdef _WIN32
+    std::cout << "Multi-process training forks the trainer processes and is only available on POSIX systems." << std::endl;
+    return;
+#endif
+    std::map<std::string, std::string> options = {
+        { "processes", "1,2,4" }, { "layers", "64-10" }, { "lr", "0.001" }, { "epochs", "1" }, { "batch", "32" },
+        { "val", "0.1" }, { "seed", std::to_string(getRandomSeed()) }, { "out", "data_parallel.ckpt" }
+    };
+    for (auto& arg : args) {
+        size_t equals = arg.find('=');
+        if (equals == std::string::npos || !options.count(arg.substr(0, equals))) {
+            std::cout << "Unknown data-parallel option " << arg << ", see DataParallel.h for the options." << std::endl;
+            return;
+        }
+        options[arg.substr(0, equals)] = arg.substr(equals + 1);
+    }
+
+    DataParallelSpec spec;
+    SweepRun topology;
+    if (!parseTopology(options["layers"], topology)) {
+        std::cout << "Invalid topology " << options["layers"] << ", the last layer must be dense." << std::endl;
+        return;
+    }
+    spec.sizes = topology.sizes;
+    spec.types = topology.types;
+    spec.learningRate = static_cast<float>(std::atof(options["lr"].c_str()));
+    spec.epochs = std::max(1, std::atoi(options["epochs"].c_str()));
+    spec.batch = static_cast<size_t>(std::max(1, std::atoi(options["batch"].c_str())));
+    size_t valCount = static_cast<size_t>(dataset.size() * std::atof(options["val"].c_str()));
+    spec.trainCount = dataset.size() - std::min(valCount, dataset.size());
+    if (valCount == 0 || spec.trainCount == 0) {
+        std::cout << "val must leave samples for both training and validation." << std::endl;
+        return;
+    }
+
+    // The single-process run is the baseline, so it always runs first
+    std::vector<int> processCounts = { 1 };
+    for (auto& value : splitList(options["processes"], ',')) {
+        int count = std::atoi(value.c_str());
+        if (count > 1 && std::find(processCounts.begin(), processCounts.end(), count) == processCounts.end()) processCounts.push_back(count);
+    }
+
+    // Every run starts from the same weights
+    std::uint64_t seed = std::strtoull(options["seed"].c_str(), nullptr, 10);
+    setRandomSeed(seed);
+    Checkpoint start;
+    {
+        DataShape shape = dataset.shape();
+        Network network(spec.sizes, spec.learningRate, spec.epochs, spec.types, {}, shape.input);
+        if (!network.isReady() || spec.sizes.back() < shape.classes) {
+            std::cout << "Topology " << options["layers"] << " does not fit the " << shape.input.channels << "x" << shape.input.height << "x"
+                << shape.input.width << " input and " << shape.classes << " classes." << std::endl;
+            return;
+        }
+        start = network.getCheckpoint();
+    }
+    size_t gradientCount = 0;
+    {
+        Network network(start, spec.learningRate, spec.epochs);
+        for (int l = 0; l < network.getLayerCount(); ++l) gradientCount += network.gradientSize(l);
+    }
+
+    std::cout << "Data-parallel training of " << options["layers"] << " (seed " << seed << ", " << spec.trainCount << " training / "
+        << valCount << " validation samples, batches of " << spec.batch << ", " << std::thread::hardware_concurrency()
+        << " hardware threads)" << std::endl;
+    std::cout << std::endl << "Processes  Seconds  Samples/s  Speedup  Efficiency  Loss     ValAcc  In sync" << std::endl;
+    double baseline = 0.0;
+    for (int ranks : processCounts) {
+        RingAllReduce ring(ranks, gradientCount + 1); // The last float carries the batch loss
+        if (!ring.valid() || !runGroup(ranks, ring, start, spec, dataset, options["out"])) {
+            std::cout << "Run with " << ranks << " processes failed." << std::endl;
+            return;
+        }
+        double seconds = ring.results(0)[RESULT_SECONDS];
+        bool inSync = true;
+        for (int r = 1; r < ranks; ++r) {
+            inSync = inSync && ring.results(r)[RESULT_CHECKSUM] == ring.results(0)[RESULT_CHECKSUM];
+        }
+        if (ranks == 1) baseline = seconds;
+        double speedup = seconds > 0.0 ? baseline / seconds : 0.0;
+        std::cout << std::left << std::fixed << std::setw(11) << ranks << std::setprecision(2) << std::setw(9) << seconds
+            << std::setprecision(0) << std::setw(11) << spec.trainCount * spec.epochs / std::max(seconds, 1e-9)
+            << std::setprecision(2) << std::setw(9) << speedup << std::setprecision(1) << std::setw(12) << speedup / ranks * 100.0
+            << std::setprecision(4) << std::setw(9) << ring.results(0)[RESULT_LOSS] / spec.trainCount
+            << std::setw(8) << ring.results(0)[RESULT_ACCURACY] << (inSync ? "yes" : "NO") << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+    std::cout << std::right << std::setprecision(6);
+    std::cout << "Efficiency is speedup / processes against the single-process run. Weights of the last run saved to "
+        << options["out"] << std::endl;
+}
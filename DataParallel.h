@@ -0,0 +1,63 @@
+#pragma once
+#include "Dataset.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Multi-process data-parallel training on one machine (run the app with --data-parallel [key=value ...])
+//
+//   processes=1,2,4         process counts to run one after another (the single-process run is the baseline)
+//   layers=64-10            topology, same syntax as the sweep
+//   lr=0.001                learning rate
+//   epochs=1                epochs per run
+//   batch=32                samples per weight update, split evenly across the processes
+//   val=0.1                 fraction of the training file held out for validation
+//   seed=N                  seed for the initial weights and shuffling (default: the app seed)
+//   out=data_parallel.ckpt  where the weights of the last run are written
+//
+// Every process owns an interleaved shard of each batch. Gradients are summed with a ring all-reduce over
+// shared memory, so every process applies the same update and all copies of the weights stay identical.
+// The processes are forked, which needs a POSIX system.
+
+// Shared-memory ring all-reduce between a fixed group of processes.
+// Every rank owns a buffer in one shared mapping; a step reads the left neighbour's buffer directly,
+// so each rank moves 2 (ranks - 1) / ranks of the buffer in total, like a ring over sockets would.
+class RingAllReduce
+{
+public:
+	RingAllReduce(int ranks, size_t count); // Map the buffers, must happen before the processes are forked
+	~RingAllReduce();
+	RingAllReduce(const RingAllReduce&) = delete;
+	RingAllReduce& operator=(const RingAllReduce&) = delete;
+
+	bool valid() const; // False if the shared mapping could not be created
+	float* buffer(int rank); // count floats owned by rank
+	bool reduce(int rank); // Sum all buffers into every buffer, false if the group was aborted
+	bool barrier(); // Wait until every rank arrived, false if the group was aborted
+	void abort(); // Release all waiting ranks (a process of the group died)
+	double* results(int rank); // Small per-rank report area (RESULT_SLOTS values)
+
+	static const int RESULT_SLOTS = 4;
+
+private:
+	struct Control
+	{
+		std::atomic<int> arrived; // Ranks waiting at the current barrier
+		std::atomic<int> generation; // Completed barriers
+		std::atomic<int> aborted;
+	};
+
+	int ranks;
+	size_t count;
+	size_t stride; // Floats between two rank buffers (cache-line aligned)
+	void* mapping = nullptr;
+	size_t length = 0;
+	Control* control = nullptr;
+	float* buffers = nullptr;
+	double* report = nullptr;
+
+	size_t chunkBegin(int chunk) const; // Buffers are cut into one chunk per rank
+};
+
+// Trains the spec with every process count on the shared dataset and prints the scaling efficiency
+void runDataParallel(const DatasetView& dataset, const std::vector<std::string>& args);
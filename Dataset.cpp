@@ -0,0 +1,148 @@
+#include "Dataset.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+Shape inferShape(size_t pixels) {
+    int side = static_cast<int>(std::lround(std::sqrt(static_cast<double>(pixels))));
+    if (pixels > 0 && static_cast<size_t>(side) * side == pixels) return { 1, side, side };
+    return { 1, 1, static_cast<int>(pixels) };
+}
+
+bool DatasetView::empty() const {
+    return size() == 0;
+}
+
+void DatasetView::input(size_t index, float* out) const {
+    const std::uint8_t* source = pixels(index);
+    size_t count = inputSize();
+    // Same scaling as the original CSV loader (byte / 255), independent iterations so it vectorizes
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<float>(source[i]) / 255.0f;
+    }
+}
+
+void DatasetView::sample(size_t index, std::pair<int, std::vector<float>>& out) const {
+    out.first = label(index);
+    out.second.resize(inputSize());
+    input(index, out.second.data());
+}
+
+void DatasetView::fillBatch(size_t begin, size_t end, float* inputs, int* labels) const {
+    size_t count = inputSize();
+    for (size_t i = begin; i < end; ++i) {
+        input(i, inputs + (i - begin) * count);
+        if (labels) labels[i - begin] = label(i);
+    }
+}
+
+std::vector<std::pair<int, std::vector<float>>> DatasetView::decode() const {
+    std::vector<std::pair<int, std::vector<float>>> samples(size());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        sample(i, samples[i]);
+    }
+    return samples;
+}
+
+bool parseCsvLine(const std::string& line, int& label, std::vector<std::uint8_t>& pixels) {
+    const char* cursor = line.c_str();
+    char* next = nullptr;
+    long value = std::strtol(cursor, &next, 10);
+    if (next == cursor || value < 0 || value > 255) return false;
+    label = static_cast<int>(value);
+    pixels.clear();
+    while (*next == ',') {
+        cursor = next + 1;
+        value = std::strtol(cursor, &next, 10);
+        if (next == cursor) break;
+        pixels.push_back(static_cast<std::uint8_t>(std::min(255L, std::max(0L, value))));
+    }
+    return true;
+}
+
+bool Dataset::loadCsv(const std::string& path, size_t expectedPixels) {
+    TraceScope trace("Load dataset", "io");
+    clear();
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error loading dataset " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    std::vector<std::uint8_t> row;
+    int label = 0;
+    while (std::getline(file, line)) {
+        if (!parseCsvLine(line, label, row) || row.empty()) continue;
+        if (expectedPixels == 0) expectedPixels = row.size();
+        if (row.size() == expectedPixels) add(label, row.data(), row.size());
+    }
+    return !empty();
+}
+
+void Dataset::add(int label, const std::uint8_t* pixels, size_t count) {
+    if (labelBytes.empty() && count != pixelCount) {
+        pixelCount = count;
+        dataShape.input = inferShape(count);
+    }
+    if (count != pixelCount) return;
+    dataShape.classes = std::max(dataShape.classes, label + 1);
+    labelBytes.push_back(static_cast<std::uint8_t>(label));
+    pixelBytes.insert(pixelBytes.end(), pixels, pixels + count);
+}
+
+void Dataset::setShape(const DataShape& shape) {
+    if (!labelBytes.empty() && static_cast<size_t>(shape.input.size()) != pixelCount) return;
+    pixelCount = shape.input.size();
+    dataShape.input = shape.input;
+    dataShape.classes = std::max(dataShape.classes, shape.classes);
+}
+
+void Dataset::clear() {
+    labelBytes.clear();
+    pixelBytes.clear();
+    pixelCount = 0;
+    dataShape = DataShape();
+}
+
+Dataset Dataset::split(size_t count) {
+    count = std::min(count, size());
+    size_t first = size() - count;
+    Dataset tail;
+    tail.pixelCount = pixelCount;
+    tail.dataShape = dataShape;
+    tail.labelBytes.assign(labelBytes.begin() + first, labelBytes.end());
+    tail.pixelBytes.assign(pixelBytes.begin() + first * pixelCount, pixelBytes.end());
+    labelBytes.resize(first);
+    pixelBytes.resize(first * pixelCount);
+    return tail;
+}
+
+void Dataset::swapSamples(size_t a, size_t b) {
+    if (a == b) return;
+    std::swap(labelBytes[a], labelBytes[b]);
+    std::swap_ranges(pixelBytes.begin() + a * pixelCount, pixelBytes.begin() + (a + 1) * pixelCount, pixelBytes.begin() + b * pixelCount);
+}
+
+size_t Dataset::size() const {
+    return labelBytes.size();
+}
+
+size_t Dataset::inputSize() const {
+    return pixelCount;
+}
+
+int Dataset::label(size_t index) const {
+    return labelBytes[index];
+}
+
+const std::uint8_t* Dataset::pixels(size_t index) const {
+    return pixelBytes.data() + index * pixelCount;
+}
+
+DataShape Dataset::shape() const {
+    return dataShape;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "Shape.h"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// What a dataset tells the network: the tensor shape of one sample and the number of classes
+struct DataShape
+{
+	Shape input = DEFAULT_INPUT_SHAPE;
+	int classes = 0; // Largest label + 1
+};
+
+// Shape of flat samples without stored dimensions: a square grayscale image when the pixel count is a square, else (1, 1, pixels)
+Shape inferShape(size_t pixels);
+
+// Read access shared by the in-memory Dataset and the memory-mapped MappedDataset.
+// Samples are stored as one byte per label and per pixel; pixels are scaled to [0, 1] floats only when
+// an input is filled, in a plain loop over contiguous bytes that the compiler turns into SIMD conversions.
+class DatasetView
+{
+public:
+	virtual ~DatasetView() = default;
+	virtual size_t size() const = 0; // Number of samples
+	virtual size_t inputSize() const = 0; // Pixels per sample
+	virtual int label(size_t index) const = 0; // Label of one sample
+	virtual const std::uint8_t* pixels(size_t index) const = 0; // inputSize() raw pixels of one sample
+	virtual DataShape shape() const = 0; // Sample shape and class count (shape().input.size() == inputSize())
+
+	bool empty() const;
+	void input(size_t index, float* out) const; // Pixels of one sample scaled to [0, 1]
+	void sample(size_t index, std::pair<int, std::vector<float>>& out) const; // Label and scaled pixels, reuses out's storage
+	void fillBatch(size_t begin, size_t end, float* inputs, int* labels) const; // Samples [begin, end) into row-major arrays
+	std::vector<std::pair<int, std::vector<float>>> decode() const; // Every sample as floats (benchmarks that must not time the conversion)
+};
+
+// One "label,pixel,..." line: label in 0-255, pixels clamped to 0-255. False for lines without a label.
+bool parseCsvLine(const std::string& line, int& label, std::vector<std::uint8_t>& pixels);
+
+// Dataset held in memory: all labels in one array, all pixels in another, sample after sample
+class Dataset : public DatasetView
+{
+private:
+	size_t pixelCount = 0; // Pixels per sample
+	DataShape dataShape; // Inferred from the first sample unless set, classes grow with the labels
+	std::vector<std::uint8_t> labelBytes; // One label per sample
+	std::vector<std::uint8_t> pixelBytes; // size() * pixelCount raw pixels
+
+	void swapSamples(size_t a, size_t b);
+
+public:
+	// "label,pixel,..." lines with pixels in 0-255, other sizes are skipped (expectedPixels 0: the first line fixes the size)
+	bool loadCsv(const std::string& path, size_t expectedPixels = 0);
+	void add(int label, const std::uint8_t* pixels, size_t count); // Append one sample (the first one fixes the input size)
+	void setShape(const DataShape& shape); // Known dimensions (binary header), ignored if the pixel count differs
+	void clear();
+	Dataset split(size_t count); // Move the last count samples into a new dataset
+
+	// Fisher-Yates shuffle of whole samples, in place so the arrays stay contiguous
+	template <typename Generator>
+	void shuffle(Generator& generator) {
+		for (size_t i = size(); i > 1; --i) {
+			swapSamples(i - 1, std::uniform_int_distribution<size_t>(0, i - 1)(generator));
+		}
+	}
+
+	size_t size() const override;
+	size_t inputSize() const override;
+	int label(size_t index) const override;
+	const std::uint8_t* pixels(size_t index) const override;
+	DataShape shape() const override;
+};
@@ -0,0 +1,199 @@
+#include "Ensemble.h"
+#include "Network.h"
+#include "TaskScheduler.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+Ensemble::Ensemble() {}
+
+Ensemble::~Ensemble() {}
+
+bool Ensemble::add(const Checkpoint& checkpoint, float weight, const std::string& name) {
+    if (checkpoint.sizes.size() < 2 || checkpoint.params.size() != checkpoint.expectedParamCount()) {
+        std::cout << name << " is not a complete checkpoint, not added to the ensemble" << std::endl;
+        return false;
+    }
+    if (!(weight > 0.f)) {
+        std::cout << "Ensemble weight of " << name << " must be positive" << std::endl;
+        return false;
+    }
+    size_t classes = static_cast<size_t>(checkpoint.sizes.back());
+    if (!members.empty() && (checkpoint.input != input || classes != classCount)) {
+        std::cout << name << " has " << checkpoint.input.channels << "x" << checkpoint.input.height << "x" << checkpoint.input.width
+            << " inputs and " << classes << " classes, the ensemble " << input.channels << "x" << input.height << "x" << input.width
+            << " and " << classCount << std::endl;
+        return false;
+    }
+    Member member;
+    member.network.reset(new Network(checkpoint, 0.f, 1));
+    if (!member.network->isReady()) {
+        std::cout << name << " has no valid topology, not added to the ensemble" << std::endl;
+        return false;
+    }
+    member.weight = weight;
+    member.name = name;
+    members.push_back(std::move(member));
+    input = checkpoint.input;
+    inputLength = input.size();
+    classCount = classes;
+    return true;
+}
+
+bool Ensemble::addFile(const std::string& path, float weight) {
+    Checkpoint checkpoint;
+    if (!loadCheckpoint(path, checkpoint)) {
+        std::cout << "Could not load " << path << " for the ensemble" << std::endl;
+        return false;
+    }
+    return add(checkpoint, weight, path);
+}
+
+bool Ensemble::addFiles(const std::vector<std::string>& specs) {
+    for (const std::string& spec : specs) {
+        // The weight follows the last colon, unless that colon belongs to the path (e.g. a drive letter)
+        std::string path = spec;
+        float weight = 1.f;
+        size_t colon = spec.rfind(':');
+        if (colon != std::string::npos && colon + 1 < spec.size()) {
+            char* end = nullptr;
+            float value = std::strtof(spec.c_str() + colon + 1, &end);
+            if (*end == '\0') {
+                path = spec.substr(0, colon);
+                weight = value;
+            }
+        }
+        if (!addFile(path, weight)) return false;
+    }
+    return true;
+}
+
+void Ensemble::clear() {
+    members.clear();
+    memberOutputs.clear();
+    input = DEFAULT_INPUT_SHAPE;
+    inputLength = classCount = 0;
+}
+
+size_t Ensemble::size() const {
+    return members.size();
+}
+
+bool Ensemble::empty() const {
+    return members.empty();
+}
+
+size_t Ensemble::inputSize() const {
+    return inputLength;
+}
+
+const Shape& Ensemble::inputShape() const {
+    return input;
+}
+
+// Members run in parallel, each on the whole batch with its own network and buffers.
+// The layers of a member split their work further on the same scheduler when threads are left.
+void Ensemble::runBatch(const std::vector<std::pair<int, std::vector<float>>>& batch, size_t memberBegin, size_t memberEnd) {
+    memberOutputs.resize(members.size());
+    taskScheduler().parallelFor(memberBegin, memberEnd, 1, [&](size_t first, size_t last) {
+        for (size_t m = first; m < last; ++m) {
+            TraceScope trace("Ensemble member", "inference", static_cast<int>(m));
+            std::vector<float>& out = memberOutputs[m];
+            out.resize(batch.size() * classCount);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                std::vector<float> probabilities = members[m].network->forwardPass(batch[i]);
+                std::copy(probabilities.begin(), probabilities.end(), out.begin() + i * classCount);
+            }
+        }
+    });
+}
+
+void Ensemble::combine(size_t sampleCount, std::vector<float>& probabilities) const {
+    float totalWeight = 0.f;
+    for (const Member& member : members) totalWeight += member.weight;
+    probabilities.assign(sampleCount * classCount, 0.f);
+    for (size_t m = 0; m < members.size(); ++m) {
+        float scale = members[m].weight / totalWeight;
+        const float* out = memberOutputs[m].data();
+        for (size_t i = 0; i < sampleCount * classCount; ++i) probabilities[i] += scale * out[i];
+    }
+}
+
+std::vector<float> Ensemble::predict(const std::vector<float>& input) {
+    std::vector<float> probabilities;
+    if (members.empty() || input.size() != inputLength) return probabilities;
+    std::vector<std::pair<int, std::vector<float>>> batch = { { -1, input } };
+    runBatch(batch, 0, members.size());
+    combine(1, probabilities);
+    return probabilities;
+}
+
+static int argmax(const float* values, size_t count) {
+    return static_cast<int>(std::max_element(values, values + count) - values);
+}
+
+EnsembleReport Ensemble::evaluate(const DatasetView& samples) {
+    EnsembleReport report;
+    if (members.empty() || samples.size() == 0 || samples.inputSize() != inputLength) return report;
+    TraceScope trace("Ensemble evaluation", "inference");
+    std::vector<int> memberCorrect(members.size(), 0);
+    int correct = 0;
+    std::vector<std::pair<int, std::vector<float>>> batch;
+    std::vector<float> probabilities;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t begin = 0; begin < samples.size(); begin += ENSEMBLE_BATCH) {
+        // Decoded once for all members
+        batch.resize(std::min(ENSEMBLE_BATCH, samples.size() - begin));
+        for (size_t i = 0; i < batch.size(); ++i) samples.sample(begin + i, batch[i]);
+        runBatch(batch, 0, members.size());
+        combine(batch.size(), probabilities);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (argmax(probabilities.data() + i * classCount, classCount) == batch[i].first) correct++;
+            for (size_t m = 0; m < members.size(); ++m) {
+                if (argmax(memberOutputs[m].data() + i * classCount, classCount) == batch[i].first) memberCorrect[m]++;
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t best = 0;
+    for (size_t m = 0; m < members.size(); ++m) {
+        report.memberAccuracies.push_back(static_cast<float>(memberCorrect[m]) / samples.size());
+        if (memberCorrect[m] > memberCorrect[best]) best = m;
+    }
+    report.accuracy = static_cast<float>(correct) / samples.size();
+    report.bestMemberAccuracy = report.memberAccuracies[best];
+    report.samplesPerSecond = samples.size() / std::max(seconds, 1e-9);
+
+    // The best member alone on the same batches, so the cost of the ensemble is measured rather than estimated
+    start = std::chrono::steady_clock::now();
+    for (size_t begin = 0; begin < samples.size(); begin += ENSEMBLE_BATCH) {
+        batch.resize(std::min(ENSEMBLE_BATCH, samples.size() - begin));
+        for (size_t i = 0; i < batch.size(); ++i) samples.sample(begin + i, batch[i]);
+        runBatch(batch, best, best + 1);
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report.bestMemberSamplesPerSecond = samples.size() / std::max(seconds, 1e-9);
+    return report;
+}
+
+void Ensemble::printMembers() const {
+    std::cout << "Ensemble of " << members.size() << " networks:" << std::endl;
+    for (const Member& member : members) {
+        std::cout << "  " << member.name << " (weight " << member.weight << ")" << std::endl;
+    }
+}
+
+void Ensemble::printReport(const EnsembleReport& report) {
+    for (size_t m = 0; m < report.memberAccuracies.size(); ++m) {
+        std::cout << "  Member " << m + 1 << " accuracy: " << report.memberAccuracies[m] * 100.0f << "%" << std::endl;
+    }
+    std::cout << "Ensemble accuracy: " << report.accuracy * 100.0f << "% (" << (report.accuracy - report.bestMemberAccuracy) * 100.0f
+        << " points over the best member)" << std::endl;
+    std::cout << "Throughput: ensemble " << report.samplesPerSecond << " samples/s, best member alone "
+        << report.bestMemberSamplesPerSecond << " samples/s (" << report.bestMemberSamplesPerSecond / std::max(report.samplesPerSecond, 1e-9)
+        << "x cost)" << std::endl;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "Checkpoint.h"
+#include "Dataset.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+class Network;
+
+const size_t ENSEMBLE_BATCH = 256; // Samples decoded once and run through every member per step
+
+// Accuracy and throughput of an ensemble on a test set
+struct EnsembleReport
+{
+	std::vector<float> memberAccuracies;
+	float accuracy = 0.f; // Combined prediction
+	float bestMemberAccuracy = 0.f;
+	double samplesPerSecond = 0.0; // Whole ensemble
+	double bestMemberSamplesPerSecond = 0.0; // Best member alone
+};
+
+// Several trained networks (different topologies, seeds or snapshots) used as one classifier.
+// Every member is a headless copy of its checkpoint; a batch of samples is decoded once and the members run on it
+// in parallel, then their softmax outputs are averaged with the member weights (plain mean for equal weights).
+// All members need the same input shape and class count.
+class Ensemble
+{
+private:
+	struct Member
+	{
+		std::unique_ptr<Network> network;
+		float weight;
+		std::string name;
+	};
+	std::vector<Member> members;
+	std::vector<std::vector<float>> memberOutputs; // Probabilities of the current batch per member, sample after sample
+	Shape input = DEFAULT_INPUT_SHAPE; // Input shape of the members
+	size_t inputLength = 0; // Input size of the members (0 while empty)
+	size_t classCount = 0;
+
+	void runBatch(const std::vector<std::pair<int, std::vector<float>>>& batch, size_t memberBegin, size_t memberEnd); // Fill memberOutputs
+	void combine(size_t sampleCount, std::vector<float>& probabilities) const; // Weighted mean of memberOutputs
+
+public:
+	Ensemble();
+	~Ensemble();
+	Ensemble(const Ensemble&) = delete;
+	Ensemble& operator=(const Ensemble&) = delete;
+
+	bool add(const Checkpoint& checkpoint, float weight, const std::string& name); // False if the checkpoint is invalid or does not fit the members
+	bool addFile(const std::string& path, float weight); // Load a checkpoint file as a member
+	bool addFiles(const std::vector<std::string>& specs); // "path" or "path:weight" per member, stops at the first failure
+	void clear();
+	size_t size() const;
+	bool empty() const;
+	size_t inputSize() const;
+	const Shape& inputShape() const;
+
+	std::vector<float> predict(const std::vector<float>& input); // Combined class probabilities of one input
+	EnsembleReport evaluate(const DatasetView& samples); // Member and ensemble accuracy, throughput against the best member alone
+	void printMembers() const;
+	static void printReport(const EnsembleReport& report);
+};
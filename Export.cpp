@@ -0,0 +1,224 @@
+#include "Export.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+// Writes values as a brace-enclosed initializer, a few per line
+template <typename T, typename Format>
+static void writeArray(std::ofstream& file, const T* values, size_t count, Format format) {
+    file << "{";
+    for (size_t i = 0; i < count; ++i) {
+        file << (i % 8 == 0 ? "\n\t" : " ");
+        format(values[i]);
+        file << (i + 1 < count ? "," : "");
+    }
+    file << "\n};\n";
+}
+
+std::string floatLiteral(float value) {
+    // showpoint keeps the decimal point of integral values: "0f" or "1f" would not compile
+    std::ostringstream text;
+    text.precision(std::numeric_limits<float>::max_digits10);
+    text << std::showpoint << value << "f";
+    return text.str();
+}
+
+bool checkFloatLiterals() {
+    // Zero biases and the 1.0 scale of all-zero int8 rows are the integral values an export writes
+    const float values[] = { 0.f, -0.f, 1.f, -1.f, 127.f, 0.1f, 1e-30f, std::numeric_limits<float>::denorm_min(),
+        std::numeric_limits<float>::min(), std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+    for (float value : values) {
+        std::string literal = floatLiteral(value);
+        bool decimal = literal.find_first_of(".eE") != std::string::npos && literal.back() == 'f';
+        float parsed = std::strtof(literal.c_str(), nullptr);
+        if (!decimal || parsed != value || std::signbit(parsed) != std::signbit(value)) {
+            std::cerr << "Float literal " << literal << " does not read back as " << value << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string stringLiteral(const std::string& text) {
+    std::string literal = "\"";
+    for (char c : text) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (c == '\\' || c == '"') {
+            literal += '\\';
+            literal += c;
+        }
+        else if (byte < 0x20 || byte == 0x7F) {
+            // Three octal digits always end the escape, a following digit cannot extend it
+            literal += '\\';
+            literal += static_cast<char>('0' + (byte >> 6));
+            literal += static_cast<char>('0' + ((byte >> 3) & 7));
+            literal += static_cast<char>('0' + (byte & 7));
+        }
+        else {
+            literal += c;
+        }
+    }
+    return literal + "\"";
+}
+
+bool checkStringLiterals() {
+    const std::string texts[] = { "ExportedModel.ckpt", "C:\\models\\net.ckpt", "C:\\models\\", "say \"hi\".ckpt",
+        std::string("tab\tnew\nline\0" "7", 14), "\\\\server\\share\\x41.ckpt" };
+    for (const std::string& text : texts) {
+        // Decode the literal the way the compiler reads it
+        std::string literal = stringLiteral(text), decoded;
+        bool valid = literal.size() >= 2 && literal.front() == '"' && literal.back() == '"';
+        for (size_t i = 1; valid && i + 1 < literal.size(); ++i) {
+            char c = literal[i];
+            if (c == '"') valid = false;
+            else if (c != '\\') decoded += c;
+            else if (literal[i + 1] == '\\' || literal[i + 1] == '"') decoded += literal[++i];
+            else if (i + 4 < literal.size() && literal[i + 1] >= '0' && literal[i + 1] <= '3') {
+                decoded += static_cast<char>(((literal[i + 1] - '0') << 6) | ((literal[i + 2] - '0') << 3) | (literal[i + 3] - '0'));
+                i += 3;
+            }
+            else valid = false;
+        }
+        if (!valid || decoded != text) {
+            std::cerr << "String literal " << literal << " does not read back as " << text << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool exportStandaloneHeader(const Checkpoint& checkpoint, const std::string& headerPath, const std::string& checkpointPath, bool quantize) {
+    for (int type : checkpoint.types) {
+        if (type != static_cast<int>(LayerType::Dense)) {
+            std::cerr << "Cannot export, only dense topologies can be written as standalone headers" << std::endl;
+            return false;
+        }
+    }
+    for (size_t l = 0; l + 1 < checkpoint.activations.size(); ++l) {
+        if (checkpoint.activations[l] != static_cast<int>(Activation::ReLU)) {
+            std::cerr << "Cannot export, standalone headers only support ReLU hidden layers" << std::endl;
+            return false;
+        }
+    }
+    if (checkpoint.params.size() != checkpoint.expectedParamCount()) return false;
+    for (float value : checkpoint.params) {
+        if (!std::isfinite(value)) {
+            std::cerr << "Cannot export, the network has inf or NaN weights (diverged training)" << std::endl;
+            return false;
+        }
+    }
+    if (!saveCheckpoint(checkpointPath, checkpoint)) return false;
+
+    std::ofstream file(headerPath);
+    if (!file) {
+        std::cerr << "Error writing " << headerPath << std::endl;
+        return false;
+    }
+    auto writeFloat = [&file](float value) { file << floatLiteral(value); };
+    auto writeInt8 = [&file](signed char value) { file << static_cast<int>(value); };
+
+    const std::vector<int>& sizes = checkpoint.sizes;
+    std::string topology;
+    int maxWidth = 0;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        topology += (i ? "-" : "") + std::to_string(sizes[i]);
+        if (i > 0) maxWidth = std::max(maxWidth, sizes[i]);
+    }
+
+    file << "#pragma once\n"
+        << "// Generated by exportStandaloneHeader, do not edit.\n"
+        << "// Dense network " << topology << " (ReLU hidden layers, softmax output), "
+        << (quantize ? "int8 weights with per-neuron scales" : "float weights") << ".\n"
+        << "// Self-contained: no allocation, no file I/O, no dependencies besides <cmath>.\n"
+        << "#include <cmath>\n\n"
+        << "namespace exported_model {\n\n"
+        << "constexpr int INPUT_SIZE = " << sizes.front() << ";\n"
+        << "constexpr int OUTPUT_SIZE = " << sizes.back() << ";\n"
+        << "constexpr const char* CHECKPOINT = " << stringLiteral(checkpointPath) << "; // Same weights for the runtime Network\n\n";
+
+    // Split the checkpoint (per neuron: weights, bias) into one weight matrix and bias vector per layer
+    const float* params = checkpoint.params.data();
+    for (size_t l = 1; l < sizes.size(); ++l) {
+        int in = sizes[l - 1], out = sizes[l];
+        std::vector<float> weights, biases;
+        for (int o = 0; o < out; ++o) {
+            weights.insert(weights.end(), params, params + in);
+            params += in;
+            biases.push_back(*params++);
+        }
+        std::string name = "layer" + std::to_string(l - 1);
+        if (quantize) {
+            // Symmetric per-neuron quantization: w ~ q * scale with q in [-127, 127]
+            std::vector<signed char> quantized(weights.size());
+            std::vector<float> scales(out);
+            for (int o = 0; o < out; ++o) {
+                float maxAbs = 0.f;
+                for (int i = 0; i < in; ++i) maxAbs = std::max(maxAbs, std::abs(weights[o * in + i]));
+                scales[o] = maxAbs > 0.f ? maxAbs / 127.0f : 1.0f;
+                for (int i = 0; i < in; ++i) {
+                    quantized[o * in + i] = static_cast<signed char>(std::lround(weights[o * in + i] / scales[o]));
+                }
+            }
+            file << "alignas(64) static constexpr signed char " << name << "_weights[" << out << " * " << in << "] = ";
+            writeArray(file, quantized.data(), quantized.size(), writeInt8);
+            file << "alignas(64) static constexpr float " << name << "_scales[" << out << "] = ";
+            writeArray(file, scales.data(), scales.size(), writeFloat);
+        }
+        else {
+            file << "alignas(64) static constexpr float " << name << "_weights[" << out << " * " << in << "] = ";
+            writeArray(file, weights.data(), weights.size(), writeFloat);
+        }
+        file << "alignas(64) static constexpr float " << name << "_biases[" << out << "] = ";
+        writeArray(file, biases.data(), biases.size(), writeFloat);
+        file << "\n";
+    }
+
+    file << "// out = W * in + b, with ReLU on hidden layers; scales are per neuron for int8 weights\n"
+        << "template <int In, int Out, typename Weight>\n"
+        << "inline void dense(const Weight* weights, const float* scales, const float* biases, const float* in, float* out, bool relu) {\n"
+        << "\tfor (int o = 0; o < Out; ++o) {\n"
+        << "\t\tconst Weight* row = weights + o * In;\n"
+        << "\t\tfloat sum = 0.f;\n"
+        << "\t\tfor (int i = 0; i < In; ++i) sum += static_cast<float>(row[i]) * in[i];\n"
+        << "\t\tfloat z = (scales ? sum * scales[o] : sum) + biases[o];\n"
+        << "\t\tout[o] = (relu && z < 0.f) ? 0.f : z;\n"
+        << "\t}\n"
+        << "}\n\n"
+        << "// Softmax probabilities of the OUTPUT_SIZE classes\n"
+        << "inline void forward(const float input[INPUT_SIZE], float output[OUTPUT_SIZE]) {\n"
+        << "\talignas(64) float buffers[2][" << maxWidth << "];\n";
+    for (size_t l = 1; l < sizes.size(); ++l) {
+        std::string name = "layer" + std::to_string(l - 1);
+        bool last = l + 1 == sizes.size();
+        std::string source = (l == 1) ? "input" : "buffers[" + std::to_string(l % 2) + "]";
+        std::string target = last ? "output" : "buffers[" + std::to_string((l + 1) % 2) + "]";
+        file << "\tdense<" << sizes[l - 1] << ", " << sizes[l] << ">(" << name << "_weights, "
+            << (quantize ? name + "_scales" : std::string("nullptr")) << ", " << name << "_biases, "
+            << source << ", " << target << ", " << (last ? "false" : "true") << ");\n";
+    }
+    file << "\tfloat maxLogit = output[0];\n"
+        << "\tfor (int o = 1; o < OUTPUT_SIZE; ++o) maxLogit = output[o] > maxLogit ? output[o] : maxLogit;\n"
+        << "\tfloat sumExp = 0.f;\n"
+        << "\tfor (int o = 0; o < OUTPUT_SIZE; ++o) {\n"
+        << "\t\toutput[o] = std::exp(output[o] - maxLogit);\n"
+        << "\t\tsumExp += output[o];\n"
+        << "\t}\n"
+        << "\tfor (int o = 0; o < OUTPUT_SIZE; ++o) output[o] /= sumExp;\n"
+        << "}\n\n"
+        << "// Index of the most likely class\n"
+        << "inline int predict(const float input[INPUT_SIZE]) {\n"
+        << "\tfloat output[OUTPUT_SIZE];\n"
+        << "\tforward(input, output);\n"
+        << "\tint best = 0;\n"
+        << "\tfor (int o = 1; o < OUTPUT_SIZE; ++o) best = output[o] > output[best] ? o : best;\n"
+        << "\treturn best;\n"
+        << "}\n\n"
+        << "} // namespace exported_model\n";
+
+    std::cout << "Exported " << headerPath << " (" << topology << (quantize ? ", int8" : ", float") << ") and " << checkpointPath << std::endl;
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "Checkpoint.h"
+#include <string>
+
+// Writes a dense checkpoint as a self-contained C++ header for deployment without the app:
+// alignas(64) static constexpr weight arrays and forward()/predict(const float[INPUT_SIZE]) functions.
+// The header needs only <cmath>: no allocation, no SFML and no file I/O at load time.
+// With quantize, weights are stored as int8 with one float scale per neuron (about 4x smaller).
+// The checkpoint is written next to it so --check-export can compare the header against Network.
+// Non-finite weights cannot be written as literals and make the export fail.
+bool exportStandaloneHeader(const Checkpoint& checkpoint, const std::string& headerPath, const std::string& checkpointPath, bool quantize);
+
+// C++ float literal of a finite value that reads back to the same float, always with a decimal point ("0.00000000f")
+std::string floatLiteral(float value);
+bool checkFloatLiterals(); // Round-trips zero, one and extreme values through floatLiteral (part of --check-export)
+
+// Quoted C++ string literal of text: backslashes, quotes and control characters are escaped (Windows paths)
+std::string stringLiteral(const std::string& text);
+bool checkStringLiterals(); // Round-trips paths with backslashes, quotes and control characters (part of --check-export)
@@ -1,4 +1,6 @@
 ﻿#include "GUI.h"
+#include "Network.h"
+#include "Trace.h"
 
 // Constructor that initializes the window with given width (x), height (y), window title (name),
 // and optionally sets initial button and layer counts
@@ -22,32 +24,50 @@ void GUI::addButton(const Button& button) {
     }
 }
 
-// Repositions all layers horizontally with a fixed padding between them
+// Repositions all layers horizontally with a fixed padding between them.
+// Up to VISIBLE_LAYERS layers keep their full width, deeper networks share the same area.
 void GUI::repositionLayers(int padding) {
+    const float fullWidth = 90.f;
+    int slots = std::max(VISIBLE_LAYERS, static_cast<int>(layerList.size()));
+    float slotWidth = std::max(8.f, VISIBLE_LAYERS * (fullWidth + padding) / slots);
+    float layerWidth = std::max(4.f, slotWidth * fullWidth / (fullWidth + padding));
     for (int i = 0; i < layerList.size(); i++) {
         Layer* layer = layerList[i];
-        float xPos = this->getSize().x - (MAX_LAYERS - i) * (layer->getBounds().width + padding);
+        layer->setWidth(layerWidth);
+        float xPos = this->getSize().x - (slots - i) * slotWidth;
         layer->setPosition(xPos, 50);
         repositionNeurons(layer);
     }
+    hitIndexStale = true;
 }
 
-// Adds a new Layer to the GUI if the limit is not reached; auto-positions it using padding
+// Adds a new Layer of the selected type to the GUI and auto-positions all layers using padding
 void GUI::addLayer(int padding) {
-    if (layerCount < MAX_LAYERS) {
-        Layer* layer = new Layer();
-        layerList.push_back(layer);
-        layerCount++;
-        float xPos = this->getSize().x - (MAX_LAYERS - layerCount + 1) * (layer->getBounds().width + padding);
-        layer->setPosition(xPos, 50);
-    }
-    else {
-        std::cout << "Max Layers Reached!\n";
+    Layer* layer = new Layer();
+    layer->setType(nextLayerType);
+    layerList.push_back(layer);
+    layerCount++;
+    if (network) network->onLayerAdded(layer);
+    if (!hasParameters(nextLayerType)) {
+        // Pooling layers have no weights, a single neuron stands for the operation
+        layer->addNeuron(new Neuron());
+        layer->setNeuronCount(1);
+        if (network) network->syncLayers();
     }
+    repositionLayers(padding);
+}
+
+void GUI::cycleLayerType() {
+    nextLayerType = static_cast<LayerType>((static_cast<int>(nextLayerType) + 1) % 4);
+}
+
+LayerType GUI::getNextLayerType() {
+    return nextLayerType;
 }
 
 // Draws all layer rectangles onto the window
 void GUI::drawLayers() {
+    TraceScope trace("drawLayers", "frame");
     for (auto& layer : layerList) {
         layer->draw(*this);
     }
@@ -57,13 +77,17 @@ void GUI::drawLayers() {
 void GUI::deleteLayer(Layer* layer) {
     auto it = std::find(layerList.begin(), layerList.end(), layer);
     if (it != layerList.end()) {
+        if (network) network->onLayerRemoved(layer);
         for (auto& neuron : layer->getNeuronList()) {
             delete neuron;
         }
         layer->getNeuronList().clear();
+        neuronMeshes.erase(layer);
         delete* it;
         layerList.erase(it);
         layerCount--;
+        hitIndexStale = true;
+        if (network) network->syncLayers();
     }
 }
 
@@ -72,48 +96,109 @@ std::vector<Layer*>& GUI::getLayerList() {
     return layerList;
 }
 
-// Adds a neuron to the specified layer if the limit is not exceeded
-void GUI::addNeuron(Layer* layer) {
+// Adds count neurons to the specified layer
+void GUI::addNeuron(Layer* layer, int count) {
+    if (!hasParameters(layer->getType())) {
+        std::cout << "Pooling layers keep the channels of the previous layer!\n";
+        return;
+    }
     std::vector<Neuron*>& neuronList = layer->getNeuronList();
-    if (neuronList.size() < MAX_NEURONS) {
+    for (int i = 0; i < count; i++) {
         Neuron* neuron = new Neuron();
         neuronList.push_back(neuron);
         layer->setNeuronCount(1);
-        repositionNeurons(layer);
-    }
-    else {
-        std::cout << "Max Neurons Reached!\n";
+        if (network) network->onNeuronAdded(layer, neuron);
     }
+    repositionNeurons(layer);
 }
 
 // Removes the given neuron from its layer and updates layout
 void GUI::deleteNeuron(Layer* layer, Neuron* neuron) {
+    if (!hasParameters(layer->getType())) return; // Pooling layers always keep their single neuron
     auto it = std::find(layer->getNeuronList().begin(), layer->getNeuronList().end(), neuron);
     if (it != layer->getNeuronList().end() && !layer->getNeuronList().empty()) {
+        if (network) network->onNeuronRemoved(layer, it - layer->getNeuronList().begin());
         delete* it;
         layer->getNeuronList().erase(it);
         layer->setNeuronCount(-1);
+        hitIndexStale = true;
+        if (network) network->syncLayers();
     }
 }
 
-// Draws all neurons within a specific layer
+// Draws all neurons within a specific layer, or the aggregated strip for wide layers.
+// The circles of a layer are kept in one vertex array and rebuilt only when a neuron moves, is added or removed,
+// or its selection changes, so a layer costs a single draw call.
 void GUI::drawNeurons(Layer* layer){
+    if (layer->isAggregated()) {
+        drawStrip(layer);
+        return;
+    }
+    meshKey.clear();
     for (auto& neuron : layer->getNeuronList()) {
-        neuron->draw(*this);
+        meshKey.push_back(neuron->getPosition().x);
+        meshKey.push_back(neuron->getPosition().y);
+        meshKey.push_back(neuron->checkActive() ? 1.f : 0.f);
+    }
+    NeuronMesh& mesh = neuronMeshes[layer];
+    if (mesh.key != meshKey) {
+        mesh.vertices.clear();
+        for (auto& neuron : layer->getNeuronList()) {
+            neuron->appendVertices(mesh.vertices);
+        }
+        mesh.key.swap(meshKey);
     }
+    this->draw(mesh.vertices);
+}
+
+// Level-of-detail view: neurons are grouped into at most STRIP_BINS cells colored by their mean activation
+void GUI::drawStrip(Layer* layer) {
+    auto& neuronList = layer->getNeuronList();
+    sf::FloatRect bounds = layer->getBounds();
+    int bins = std::min(STRIP_BINS, static_cast<int>(neuronList.size()));
+    float left = bounds.left + bounds.width * 0.3f;
+    float right = bounds.left + bounds.width * 0.7f;
+    float top = bounds.top + PADDING / 2.f;
+    float cellHeight = (bounds.height - PADDING) / bins;
+
+    std::vector<float> means(bins, 0.f);
+    float maxMean = 0.f;
+    for (int b = 0; b < bins; b++) {
+        size_t first = neuronList.size() * b / bins;
+        size_t last = neuronList.size() * (b + 1) / bins;
+        for (size_t i = first; i < last; i++) {
+            means[b] += neuronList[i]->getOutput();
+        }
+        means[b] /= static_cast<float>(last - first);
+        maxMean = std::max(maxMean, means[b]);
+    }
+
+    sf::VertexArray strip(sf::Quads, bins * 4);
+    for (int b = 0; b < bins; b++) {
+        // Black -> green -> yellow heat map
+        float v = (maxMean > 0.f) ? means[b] / maxMean : 0.f;
+        sf::Color color(static_cast<sf::Uint8>(std::max(0.f, 2.f * v - 1.f) * 255.f), static_cast<sf::Uint8>(std::min(1.f, 2.f * v) * 255.f), 0);
+        float y = top + b * cellHeight;
+        strip[b * 4] = sf::Vertex(sf::Vector2f(left, y), color);
+        strip[b * 4 + 1] = sf::Vertex(sf::Vector2f(right, y), color);
+        strip[b * 4 + 2] = sf::Vertex(sf::Vector2f(right, y + cellHeight), color);
+        strip[b * 4 + 3] = sf::Vertex(sf::Vector2f(left, y + cellHeight), color);
+    }
+    this->draw(strip);
 }
 
 // Recalculates and repositions all neurons vertically within the layer
 void GUI::repositionNeurons(Layer* layer) {
     auto& neuronList = layer->getNeuronList();
-    if (neuronList.empty()) return;
+    hitIndexStale = true;
+    if (neuronList.empty() || layer->isAggregated()) return; // Wide layers are drawn as a strip
     Neuron* sampleNeuron = neuronList[0];
     float neuronRadius = sampleNeuron->getRadius();
     float neuronDiameter = 2 * neuronRadius;
     float layerHeight = layer->getBounds().height;
-    float maxTotalNeuronHeight = MAX_NEURONS * neuronDiameter;
+    float maxTotalNeuronHeight = DETAIL_NEURONS * neuronDiameter;
     float availableSpace = layerHeight - maxTotalNeuronHeight ;
-    float padding = availableSpace / (MAX_NEURONS + 1);
+    float padding = availableSpace / (DETAIL_NEURONS + 1);
 
     for (int i = 0; i < neuronList.size(); i++) {
         Neuron* neuron = neuronList[i];
@@ -124,9 +209,29 @@ void GUI::repositionNeurons(Layer* layer) {
     }
 }
 
-// Returns a list of line segments connecting neurons between consecutive layers
+// Line endpoints of a layer: every neuron, or DETAIL_NEURONS evenly spaced samples along a strip
+std::vector<sf::Vector2f> GUI::anchorPoints(Layer* layer) {
+    std::vector<sf::Vector2f> points;
+    if (!layer->isAggregated()) {
+        for (auto& neuron : layer->getNeuronList()) {
+            points.push_back(neuron->getPosition());
+        }
+        return points;
+    }
+    sf::FloatRect bounds = layer->getBounds();
+    float top = bounds.top + PADDING / 2.f;
+    float step = (bounds.height - PADDING) / DETAIL_NEURONS;
+    for (int i = 0; i < DETAIL_NEURONS; i++) {
+        points.push_back(sf::Vector2f(bounds.left + bounds.width / 2.f, top + step * (i + 0.5f)));
+    }
+    return points;
+}
+
+// Returns a list of line segments connecting neurons between consecutive layers.
+// Wide layers only contribute sampled endpoints, so there are at most DETAIL_NEURONS^2 lines per layer pair.
 std::vector <std::array<sf::Vertex, 2>> GUI::drawLines() {
-    auto layerList = this->getLayerList();
+    TraceScope trace("drawLines", "frame");
+    auto& layerList = this->getLayerList();
     std::vector <std::array<sf::Vertex, 2>> lineList;
     auto it = layerList.begin();
     if (layerList.empty() || layerList.size() == 1) return lineList; 
@@ -145,11 +250,12 @@ std::vector <std::array<sf::Vertex, 2>> GUI::drawLines() {
             continue;
         }
 
-        for (auto& currNeuron : currLayer->getNeuronList()) {
-            for (auto& prevNeuron : prevLayer->getNeuronList()) {
+        std::vector<sf::Vector2f> prevPoints = anchorPoints(prevLayer);
+        for (auto& currPoint : anchorPoints(currLayer)) {
+            for (auto& prevPoint : prevPoints) {
                 std::array<sf::Vertex, 2> line = {
-                    sf::Vertex(prevNeuron->getPosition()),
-                    sf::Vertex(currNeuron->getPosition())
+                    sf::Vertex(prevPoint),
+                    sf::Vertex(currPoint)
                 };
                 line.begin()->color = sf::Color::Black;
                 line.back().color = sf::Color::Black;
@@ -162,6 +268,12 @@ std::vector <std::array<sf::Vertex, 2>> GUI::drawLines() {
     return lineList;
 }
 
+// Draws the lines returned by drawLines as one vertex batch (the pairs are contiguous in memory)
+void GUI::drawConnections(const std::vector<std::array<sf::Vertex, 2>>& lineList) {
+    if (lineList.empty()) return;
+    this->draw(lineList.front().data(), lineList.size() * 2, sf::Lines);
+}
+
 // Draws the input grid (used to receive user-drawn digits)
 void GUI::drawInput() {
     input->draw(*this);
@@ -170,4 +282,37 @@ void GUI::drawInput() {
 // Returns a pointer to the input grid 
 Input* GUI::getInput() {
     return input;
+}
+
+// Attaches the built network; later edits update it instead of forcing a rebuild
+void GUI::setNetwork(Network* net) {
+    network = net;
+}
+
+// Maps the click position to world coordinates once and looks it up in the hit index,
+// which is rebuilt here if the layout changed since the last click
+HitIndex::Hit GUI::hitTest(const sf::Event& event) {
+    if (event.type != sf::Event::MouseButtonPressed || event.mouseButton.button != sf::Mouse::Left) return HitIndex::Hit();
+    if (hitIndexStale) {
+        hitIndex.build(layerList);
+        hitIndexStale = false;
+    }
+    return hitIndex.query(this->mapPixelToCoords(sf::Vector2i(event.mouseButton.x, event.mouseButton.y)));
+}
+
+// Every draw of the window and of the shapes drawn onto it goes through here, so the count is exact
+void GUI::draw(const sf::Drawable& drawable, const sf::RenderStates& states) {
+    drawCalls++;
+    sf::RenderWindow::draw(drawable, states);
+}
+
+void GUI::draw(const sf::Vertex* vertices, std::size_t vertexCount, sf::PrimitiveType type, const sf::RenderStates& states) {
+    drawCalls++;
+    sf::RenderWindow::draw(vertices, vertexCount, type, states);
+}
+
+size_t GUI::takeDrawCalls() {
+    size_t calls = drawCalls;
+    drawCalls = 0;
+    return calls;
 }
\ No newline at end of file
@@ -5,19 +5,24 @@
 #include "Layer.h"
 #include "Neuron.h"
 #include "Input.h"
+#include "Shape.h"
+#include "HitIndex.h"
 #include <iostream>
 #include <vector>
 #include <array>
+#include <unordered_map>
 
-// Size limits
+// Size limits and layout
 #define MAX_BUTTONS 5
-#define MAX_LAYERS 5
-#define MAX_NEURONS 12
+#define VISIBLE_LAYERS 5 // Layers drawn at full width, deeper networks get narrower layers
+#define DETAIL_NEURONS 12 // Wider layers are drawn as an aggregated heat-map strip
+#define STRIP_BINS 64 // Maximum number of cells in a heat-map strip
 #define PADDING 25
 
 class Layer;
 class Neuron;
 class Input;
+class Network;
 
 // GUI class that extends SFML's RenderWindow
 class GUI : public sf::RenderWindow
@@ -28,22 +33,45 @@ private:
 	int layerCount;
 	int buttonCount;
 	Input* input; // Pointer to the input grid
+	Network* network = nullptr; // Live network updated in place on topology edits (if built)
+	LayerType nextLayerType = LayerType::Dense; // Type used by the next addLayer call
+	HitIndex hitIndex; // Hit boxes of layers and neurons
+	bool hitIndexStale = true; // Set by layout changes, the index is rebuilt by the next hitTest
+	struct NeuronMesh
+	{
+		std::vector<float> key; // Position and selection of every neuron the vertices were built from
+		sf::VertexArray vertices{ sf::Triangles }; // All circles of the layer, drawn with one call
+	};
+	std::unordered_map<const Layer*, NeuronMesh> neuronMeshes;
+	std::vector<float> meshKey; // Scratch key of the layer being drawn
+	size_t drawCalls = 0; // Draw calls issued through this window since the last takeDrawCalls
+
+	std::vector<sf::Vector2f> anchorPoints(Layer* layer); // Line endpoints of a layer (sampled for wide layers)
+	void drawStrip(Layer* layer); // Level-of-detail view of a wide layer
 
 public:
 	
 	GUI(int x, int y, sf::String name, int buttonCount=0, int layerCount = 0); // Constructor: initialize window and input grid
 	void addButton(const Button& button); // Add a button to the button list (if limit not reached)
-	void addLayer(int padding = PADDING); // Add new layer and position it
+	void addLayer(int padding = PADDING); // Add new layer of the selected type and position it
+	void cycleLayerType(); // Select the next layer type (Dense -> Conv -> MaxPool -> AvgPool)
+	LayerType getNextLayerType(); // Type used by the next addLayer call
 	void deleteLayer(Layer* layer); // Delete layer and its neurons
 	void drawLayers(); // Draw all layers
 	void repositionLayers(int padding = PADDING); // Position layers with spacing
-	void addNeuron(Layer*); // Add a neuron to a layer
+	void addNeuron(Layer*, int count = 1); // Add neurons to a layer
 	void deleteNeuron(Layer* layer, Neuron* neuron); // Remove a neuron from a layer
-	void drawNeurons(Layer* layer); // Draw neurons of a layer
+	void drawNeurons(Layer* layer); // Draw neurons of a layer (one draw call, rebuilt when they move or change selection)
 	void repositionNeurons(Layer* layer); // Recalculate neuron positions inside a layer
 	std::vector<Layer*>& getLayerList(); // Return reference to layer list
 	std::vector <std::array<sf::Vertex, 2>> drawLines(); // Generate connection lines between layers
+	void drawConnections(const std::vector<std::array<sf::Vertex, 2>>& lineList); // All lines with one draw call
 	void drawInput(); // Draw input grid
 	Input* getInput(); // Return input grid pointer
+	void setNetwork(Network* net); // Attach the built network so edits keep its trained weights
+	HitIndex::Hit hitTest(const sf::Event& event); // Layer and neuron under a left click (empty for other events)
+	void draw(const sf::Drawable& drawable, const sf::RenderStates& states = sf::RenderStates::Default); // Counted sf::RenderWindow::draw
+	void draw(const sf::Vertex* vertices, std::size_t vertexCount, sf::PrimitiveType type, const sf::RenderStates& states = sf::RenderStates::Default);
+	size_t takeDrawCalls(); // Draw calls since the last call, then resets the count
 };
 
@@ -0,0 +1,74 @@
+#include "HitIndex.h"
+#include "Layer.h"
+#include "Neuron.h"
+#include <algorithm>
+#include <cmath>
+
+const float HIT_CELL_SIZE = 32.f; // About two neuron diameters
+
+void HitIndex::build(std::vector<Layer*>& layers) {
+    entries.clear();
+    cells.clear();
+    columns = rows = 0;
+    for (auto& layer : layers) {
+        entries.push_back({ layer->getBounds(), layer, nullptr });
+        if (layer->isAggregated()) continue; // Strips have no clickable neurons
+        for (auto& neuron : layer->getNeuronList()) {
+            entries.push_back({ neuron->getBounds(), layer, neuron });
+        }
+    }
+    if (entries.empty()) return;
+
+    // Grid covers the union of all boxes
+    float left = entries[0].box.left, top = entries[0].box.top;
+    float right = left + entries[0].box.width, bottom = top + entries[0].box.height;
+    for (const Entry& entry : entries) {
+        left = std::min(left, entry.box.left);
+        top = std::min(top, entry.box.top);
+        right = std::max(right, entry.box.left + entry.box.width);
+        bottom = std::max(bottom, entry.box.top + entry.box.height);
+    }
+    origin = sf::Vector2f(left, top);
+    columns = std::max(1, static_cast<int>(std::ceil((right - left) / HIT_CELL_SIZE)));
+    rows = std::max(1, static_cast<int>(std::ceil((bottom - top) / HIT_CELL_SIZE)));
+    cells.assign(columns * rows, std::vector<int>());
+
+    for (int i = 0; i < static_cast<int>(entries.size()); i++) {
+        const sf::FloatRect& box = entries[i].box;
+        int firstColumn = std::min(columns - 1, static_cast<int>((box.left - origin.x) / HIT_CELL_SIZE));
+        int lastColumn = std::min(columns - 1, static_cast<int>((box.left + box.width - origin.x) / HIT_CELL_SIZE));
+        int firstRow = std::min(rows - 1, static_cast<int>((box.top - origin.y) / HIT_CELL_SIZE));
+        int lastRow = std::min(rows - 1, static_cast<int>((box.top + box.height - origin.y) / HIT_CELL_SIZE));
+        for (int r = firstRow; r <= lastRow; r++) {
+            for (int c = firstColumn; c <= lastColumn; c++) {
+                cells[r * columns + c].push_back(i);
+            }
+        }
+    }
+}
+
+int HitIndex::cellIndex(float x, float y) const {
+    if (columns == 0 || x < origin.x || y < origin.y) return -1;
+    int column = static_cast<int>((x - origin.x) / HIT_CELL_SIZE);
+    int row = static_cast<int>((y - origin.y) / HIT_CELL_SIZE);
+    if (column >= columns || row >= rows) return -1;
+    return row * columns + column;
+}
+
+HitIndex::Hit HitIndex::query(sf::Vector2f point) const {
+    Hit hit;
+    int cell = cellIndex(point.x, point.y);
+    if (cell < 0) return hit;
+    // Neurons are drawn over their layer, so a neuron hit takes precedence
+    for (int i : cells[cell]) {
+        const Entry& entry = entries[i];
+        if (!entry.box.contains(point)) continue;
+        if (entry.neuron) {
+            hit.layer = entry.layer;
+            hit.neuron = entry.neuron;
+            return hit;
+        }
+        if (!hit.layer) hit.layer = entry.layer;
+    }
+    return hit;
+}
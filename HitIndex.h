@@ -0,0 +1,37 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+
+class Layer;
+class Neuron;
+
+// Uniform grid of layer and neuron hit boxes for mouse hit-testing.
+// Built once after the layout changes, a query only tests the boxes registered in the clicked cell.
+class HitIndex
+{
+public:
+	struct Hit
+	{
+		Layer* layer = nullptr; // Layer under the point
+		Neuron* neuron = nullptr; // Neuron under the point (only in layers that draw their neurons)
+	};
+
+	void build(std::vector<Layer*>& layers); // Register the hit boxes of every layer and its visible neurons
+	Hit query(sf::Vector2f point) const; // Topmost layer and neuron containing point
+
+private:
+	struct Entry
+	{
+		sf::FloatRect box;
+		Layer* layer;
+		Neuron* neuron; // nullptr for the layer box itself
+	};
+
+	std::vector<Entry> entries;
+	std::vector<std::vector<int>> cells; // Entry indices overlapping every cell, row-major
+	sf::Vector2f origin; // Top left corner of the grid
+	int columns = 0;
+	int rows = 0;
+
+	int cellIndex(float x, float y) const; // -1 outside the grid
+};
@@ -1,65 +1,73 @@
 #include "Input.h"
+#include "Trace.h"
+#include <algorithm>
 
 Input::Input() {
     // Initialize input area and grid layout
 	shape.setSize(sf::Vector2f(280.f, 280.f));
 	shape.setOutlineColor(sf::Color::Black);
 	shape.setOutlineThickness(3.f); 
-    // Create 28x28 white squares
-    for (size_t i = 0; i < GRID_COUNT; ++i) {
-        for (size_t j = 0; j < GRID_COUNT; ++j) {
-            grid[i][j].setSize(sf::Vector2f(CELL_SIZE, CELL_SIZE));
-            grid[i][j].setFillColor(sf::Color::White);
-        }
-    }
+    // 28x28 white cells, one texel each, scaled up to CELL_SIZE pixels
+    cells.fill(255);
+    coverage.fill(0.f);
+    texture.create(GRID_COUNT, GRID_COUNT);
+    sprite.setTexture(texture, true);
+    sprite.setScale(CELL_SIZE, CELL_SIZE);
 }
 void Input::setPosition(GUI* window, float x, float inc) {
     // Center the input grid vertically
     float yPos = window->getSize().y/2 - shape.getSize().y/2 - inc;
 	shape.setPosition(x, yPos);
-    // Set grid cell positions
-    for (size_t i = 0; i < GRID_COUNT; ++i) {
-        for (size_t j = 0; j < GRID_COUNT; ++j) {
-            grid[i][j].setPosition(shape.getPosition().x + i * CELL_SIZE, shape.getPosition().y + j * CELL_SIZE);
-        }
-    }
+    sprite.setPosition(shape.getPosition());
+    // Strokes are measured against the cell positions, measure them again
+    coverage.fill(0.f);
+    coveredPoints = 0;
  }
 
+sf::Vector2f Input::getPosition() const {
+    return shape.getPosition();
+}
+
 void Input::draw(GUI& window) {
 	window.draw(shape);
     this->drawGrid(window);
 }
 
 void Input::drawGrid(GUI& window) {
-    // For each cell, calculate how much user drawing overlaps with it
-    int row = 0, col = 0;
-    auto tempGrid = grid;
-    while (row < GRID_COUNT) {
-        sf::FloatRect cellBound = grid[row][col].getGlobalBounds();
-        float ratio = 0.f;
-        for (auto& point : pointList) {
-            sf::FloatRect pointBound = point.getBounds();
-            if (cellBound.intersects(pointBound)) {
-                // Calculate overlapping area and boost grayscale intensity
-                float leftCoord = std::max(cellBound.left, pointBound.left);
-                float rightCoord = std::min(cellBound.left + cellBound.width, pointBound.left + pointBound.width);
-                float upCoord = std::max(cellBound.top, pointBound.top);
-                float downCoord = std::min(cellBound.top + cellBound.height, pointBound.top + pointBound.height);
-                float intersectArea = std::abs(rightCoord - leftCoord) * std::abs(upCoord - downCoord);
-                ratio += 5.f * (intersectArea / (cellBound.height * cellBound.width));
+    TraceScope trace("drawGrid", "frame");
+    // For each new stroke, calculate how much it overlaps with every cell (strokes are summed in the order they were drawn)
+    for (; coveredPoints < pointList.size(); ++coveredPoints) {
+        sf::FloatRect pointBound = pointList[coveredPoints].getBounds();
+        for (int row = 0; row < GRID_COUNT; ++row) {
+            for (int col = 0; col < GRID_COUNT; ++col) {
+                sf::FloatRect cellBound(shape.getPosition().x + col * CELL_SIZE, shape.getPosition().y + row * CELL_SIZE, CELL_SIZE, CELL_SIZE);
+                if (cellBound.intersects(pointBound)) {
+                    // Calculate overlapping area and boost grayscale intensity
+                    float leftCoord = std::max(cellBound.left, pointBound.left);
+                    float rightCoord = std::min(cellBound.left + cellBound.width, pointBound.left + pointBound.width);
+                    float upCoord = std::max(cellBound.top, pointBound.top);
+                    float downCoord = std::min(cellBound.top + cellBound.height, pointBound.top + pointBound.height);
+                    float intersectArea = std::abs(rightCoord - leftCoord) * std::abs(upCoord - downCoord);
+                    coverage[row * GRID_COUNT + col] += 5.f * (intersectArea / (cellBound.height * cellBound.width));
+                }
             }
         }
-        if (ratio > 0.f) {
-            int intensity = 255.f - std::min(255.f, ratio * 255.f);
-            grid[row][col].setFillColor(sf::Color(intensity, intensity, intensity));
-        }
-        window.draw(grid[row][col]);
-        col++;
-        if (col == GRID_COUNT) {
-            col = 0;
-            row++;
+        textureStale = true;
+    }
+    if (textureStale) {
+        // Drawn cells cover whatever the grid showed before (e.g. a dataset sample)
+        for (size_t i = 0; i < cells.size(); ++i) {
+            if (coverage[i] > 0.f) {
+                int intensity = 255.f - std::min(255.f, coverage[i] * 255.f);
+                cells[i] = static_cast<sf::Uint8>(intensity);
+            }
+            texels[i * 4] = texels[i * 4 + 1] = texels[i * 4 + 2] = cells[i];
+            texels[i * 4 + 3] = 255;
         }
+        texture.update(texels.data());
+        textureStale = false;
     }
+    window.draw(sprite);
 }
 
 std::vector<sf::VertexArray> Input::takeInput(sf::Event& event, GUI& window) {
@@ -70,7 +78,10 @@ std::vector<sf::VertexArray> Input::takeInput(sf::Event& event, GUI& window) {
 
     // On mouse press: start drawing
     if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
-        for (auto& row : grid) for (auto& cell : row) cell.setFillColor(sf::Color::White);
+        cells.fill(255);
+        coverage.fill(0.f);
+        coveredPoints = 0;
+        textureStale = true;
         pointList.clear();
         isDrawing = true;
         hasDrawn = false;
@@ -150,37 +161,56 @@ std::vector<sf::VertexArray> Input::takeInput(sf::Event& event, GUI& window) {
     return pointList;
 }
 
-void Input::showInGridArr(std::vector<float> arr) {
-    // Display a digit from a vector of floats (e.g., dataset sample)
-    int i = 0;
+void Input::showInGridArr(const std::uint8_t* pixels, const Shape& shape) {
+    // Display a sample from raw dataset pixels (e.g., Dataset::pixels), other sizes are scaled to the grid by nearest pixel
     for (size_t row = 0; row < GRID_COUNT; ++row) {
         for (size_t col = 0; col < GRID_COUNT; ++col) {
-            int color = static_cast<int>((1.f - arr[i++]) * 255.f);
-            grid[col][row].setFillColor(sf::Color(color, color, color));
+            sf::Uint8 color = 255 - pixels[row * shape.height / GRID_COUNT * shape.width + col * shape.width / GRID_COUNT];
+            if (cells[row * GRID_COUNT + col] != color) {
+                cells[row * GRID_COUNT + col] = color;
+                textureStale = true;
+            }
         }
     }
 }
 
+std::vector<float> Input::resample(const std::vector<float>& values, const Shape& shape) {
+    if (shape.channels == 1 && shape.height == GRID_COUNT && shape.width == GRID_COUNT) return values;
+    // Every target pixel averages the grid cells it covers (at least the nearest one when upscaling)
+    std::vector<float> out(shape.size());
+    for (int y = 0; y < shape.height; ++y) {
+        int rowBegin = y * GRID_COUNT / shape.height;
+        int rowEnd = std::max(rowBegin + 1, (y + 1) * GRID_COUNT / shape.height);
+        for (int x = 0; x < shape.width; ++x) {
+            int colBegin = x * GRID_COUNT / shape.width;
+            int colEnd = std::max(colBegin + 1, (x + 1) * GRID_COUNT / shape.width);
+            float sum = 0.f;
+            for (int row = rowBegin; row < rowEnd; ++row) {
+                for (int col = colBegin; col < colEnd; ++col) sum += values[row * GRID_COUNT + col];
+            }
+            out[y * shape.width + x] = sum / ((rowEnd - rowBegin) * (colEnd - colBegin));
+        }
+    }
+    for (int c = 1; c < shape.channels; ++c) {
+        std::copy(out.begin(), out.begin() + shape.height * shape.width, out.begin() + c * shape.height * shape.width);
+    }
+    return out;
+}
+
 
 std::vector<float> Input::getData() {
     // Convert grid pixels to float array in [0, 1] range (normalized inverse grayscale)
     std::vector<float> out(GRID_COUNT * GRID_COUNT);
-    for (size_t col = 0; col < GRID_COUNT; ++col) {
-        for (size_t row = 0; row < GRID_COUNT; ++row) {
-            int index = row * GRID_COUNT + col;
-            out[index] = static_cast<float>(255 - grid[col][row].getFillColor().r) / 255.f;
-        }
+    for (size_t index = 0; index < out.size(); ++index) {
+        out[index] = static_cast<float>(255 - cells[index]) / 255.f;
     }
     return out;
 }
 
 // Utility: clears the grid and resets prediction status
 void Input::clearGrid() {
-    for (auto& row : grid) {
-        for (auto& cell : row) {
-            cell.setFillColor(sf::Color::White);
-        }
-    }
+    cells.fill(255);
+    textureStale = true;
 }
 
 std::vector<float> Input::getGridValues() {
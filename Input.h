@@ -1,9 +1,11 @@
 #pragma once
 #include "GUI.h"
 #include "Layer.h"
+#include "Shape.h"
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
 #include <array>
+#include <cstdint>
 
 // Constants defining grid size and cell/brush dimensions
 const float BRUSH_SIZE = 18.f;
@@ -13,12 +15,20 @@ class GUI;
 
 // Input class handles the 28x28 grid drawing area where the user writes digits.
 // It captures mouse strokes and provides the normalized grid values for prediction.
+// The cells are the texels of a 28x28 texture drawn as one scaled sprite; the texture is uploaded only when a
+// cell changes and new strokes are measured once, instead of re-measuring every stroke against every cell each frame.
 class Input
 {
 private: 
 	sf::RectangleShape shape; // Outer container of the grid
 	std::vector<sf::VertexArray> pointList; // Stores drawn strokes
-	std::array<std::array<sf::RectangleShape, GRID_COUNT>, GRID_COUNT> grid; // 28x28 drawable cells
+	std::array<sf::Uint8, GRID_COUNT * GRID_COUNT> cells; // Gray level of every cell (255 is white), row by row
+	std::array<float, GRID_COUNT * GRID_COUNT> coverage; // Stroke overlap of every cell, summed over pointList
+	size_t coveredPoints = 0; // Strokes of pointList already added to coverage
+	std::array<sf::Uint8, GRID_COUNT * GRID_COUNT * 4> texels; // RGBA copy of the cells for the texture upload
+	sf::Texture texture; // One texel per cell
+	sf::Sprite sprite; // The texture scaled to the grid area
+	bool textureStale = true; // Cells changed since the last upload
 	std::vector<float> gridValues; // Normalized pixel values from user input
 	bool canDrawable = true; // Drawing enabled flag
 	bool readyToPredict = false; // Indicates if drawing is ready to be fed to the model
@@ -26,14 +36,16 @@ private:
 public:
 	Input(); // Constructor
 	void setPosition(GUI* window, float x = 50.f, float inc = 50.f); // Set position of the input grid in the GUI window
+	sf::Vector2f getPosition() const; // Top-left corner of the grid
 	void draw(GUI& window); // Draw grid outline and contents
 	std::vector<sf::VertexArray> takeInput(sf::Event& event, GUI& window); // Capture strokes based on mouse events
-	void drawGrid(GUI& window); // Calculating output from pointlist in order to set color intensity
+	void drawGrid(GUI& window); // Calculating output from pointlist in order to set color intensity, one draw call
 	std::vector<float> getData(); // Get normalized data from current drawing
-	void showInGridArr(std::vector<float> arr);// Display a digit from dataset as a grayscale grid
+	void showInGridArr(const std::uint8_t* pixels, const Shape& shape = DEFAULT_INPUT_SHAPE); // Display a dataset sample (raw 0-255 pixels, first channel) as a grayscale grid
 	void clearGrid(); // Reset grid to white
 	std::vector<float> getGridValues(); // Get the last predicted input
 	bool shouldPredict() const; // Whether a new prediction should be triggered
 	void resetPredictFlag(); // Reset the prediction flag
+	static std::vector<float> resample(const std::vector<float>& values, const Shape& shape); // Grid values scaled to a network input, every channel gets the drawing
 }; 
 
@@ -0,0 +1,212 @@
+#include "Kernels.h"
+#include <algorithm>
+
+static KernelTuning tuning;
+
+const KernelTuning& kernelTuning() {
+    return tuning;
+}
+
+void setKernelTuning(const KernelTuning& value) {
+    tuning = value;
+}
+
+// Partial sums break the dependency chain of one accumulator, so several multiply-adds are in flight
+template <int UNROLL>
+static float dotUnrolled(const float* a, const float* b, size_t count, float init) {
+    float sums[UNROLL] = {};
+    sums[0] = init;
+    size_t k = 0;
+    for (; k + UNROLL <= count; k += UNROLL) {
+        for (int u = 0; u < UNROLL; ++u) {
+            sums[u] += a[k + u] * b[k + u];
+        }
+    }
+    float sum = sums[0];
+    for (int u = 1; u < UNROLL; ++u) sum += sums[u];
+    for (; k < count; ++k) sum += a[k] * b[k];
+    return sum;
+}
+
+float dot(const float* a, const float* b, size_t count, float init) {
+    switch (tuning.dotUnroll) {
+    case 8: return dotUnrolled<8>(a, b, count, init);
+    case 4: return dotUnrolled<4>(a, b, count, init);
+    case 2: return dotUnrolled<2>(a, b, count, init);
+    default: return dotUnrolled<1>(a, b, count, init);
+    }
+}
+
+float sparseDot(const float* a, const float* b, const int* index, size_t count, float init) {
+    float sum = init;
+    for (size_t k = 0; k < count; ++k) {
+        sum += a[index[k]] * b[index[k]];
+    }
+    return sum;
+}
+
+// Blocks keep a (blockK x blockN) tile of B in cache while every row of A passes over it.
+// Each element of C still sums over k in ascending order, so the result does not depend on the blocking.
+void gemm(int M, int N, int K, const float* A, const float* B, float* C, bool accumulate) {
+    if (!accumulate) std::fill(C, C + static_cast<size_t>(M) * N, 0.0f);
+    int blockN = tuning.gemmBlockN > 0 ? tuning.gemmBlockN : N;
+    int blockK = tuning.gemmBlockK > 0 ? tuning.gemmBlockK : K;
+    for (int j0 = 0; j0 < N; j0 += blockN) {
+        int j1 = std::min(N, j0 + blockN);
+        for (int k0 = 0; k0 < K; k0 += blockK) {
+            int k1 = std::min(K, k0 + blockK);
+            // i-k-j order: the inner loop streams one row of B and one row of C
+            for (int i = 0; i < M; ++i) {
+                float* c = C + static_cast<size_t>(i) * N;
+                for (int k = k0; k < k1; ++k) {
+                    float a = A[static_cast<size_t>(i) * K + k];
+                    if (a == 0.0f) continue;
+                    const float* b = B + static_cast<size_t>(k) * N;
+                    for (int j = j0; j < j1; ++j) {
+                        c[j] += a * b[j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+void gemmNT(int M, int N, int K, const float* A, const float* B, float* C, bool accumulate) {
+    // Rows of A and B are both contiguous, every output is a dot product
+    for (int i = 0; i < M; ++i) {
+        const float* a = A + static_cast<size_t>(i) * K;
+        for (int j = 0; j < N; ++j) {
+            float sum = dot(a, B + static_cast<size_t>(j) * K, K);
+            C[static_cast<size_t>(i) * N + j] = accumulate ? C[static_cast<size_t>(i) * N + j] + sum : sum;
+        }
+    }
+}
+
+void gemmTN(int M, int N, int K, const float* A, const float* B, float* C, bool accumulate, int lda) {
+    if (!accumulate) std::fill(C, C + static_cast<size_t>(M) * N, 0.0f);
+    if (lda <= 0) lda = M;
+    int blockN = tuning.gemmBlockN > 0 ? tuning.gemmBlockN : N;
+    for (int j0 = 0; j0 < N; j0 += blockN) {
+        int j1 = std::min(N, j0 + blockN);
+        // k-i-j order: row k of A^T * B is a rank-1 update of C
+        for (int k = 0; k < K; ++k) {
+            const float* a = A + static_cast<size_t>(k) * lda;
+            const float* b = B + static_cast<size_t>(k) * N;
+            for (int i = 0; i < M; ++i) {
+                if (a[i] == 0.0f) continue;
+                float* c = C + static_cast<size_t>(i) * N;
+                for (int j = j0; j < j1; ++j) {
+                    c[j] += a[i] * b[j];
+                }
+            }
+        }
+    }
+}
+
+void im2col(const float* image, const Shape& shape, float* columns) {
+    const int H = shape.height, W = shape.width;
+    for (int c = 0; c < shape.channels; ++c) {
+        for (int ky = 0; ky < CONV_KERNEL; ++ky) {
+            for (int kx = 0; kx < CONV_KERNEL; ++kx) {
+                float* row = columns + static_cast<size_t>((c * CONV_KERNEL + ky) * CONV_KERNEL + kx) * H * W;
+                for (int y = 0; y < H; ++y) {
+                    int sy = y + ky - CONV_PADDING;
+                    for (int x = 0; x < W; ++x) {
+                        int sx = x + kx - CONV_PADDING;
+                        bool inside = sy >= 0 && sy < H && sx >= 0 && sx < W;
+                        row[y * W + x] = inside ? image[(c * H + sy) * W + sx] : 0.0f;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void col2im(const float* columns, const Shape& shape, float* image) {
+    const int H = shape.height, W = shape.width;
+    for (int c = 0; c < shape.channels; ++c) {
+        for (int ky = 0; ky < CONV_KERNEL; ++ky) {
+            for (int kx = 0; kx < CONV_KERNEL; ++kx) {
+                const float* row = columns + static_cast<size_t>((c * CONV_KERNEL + ky) * CONV_KERNEL + kx) * H * W;
+                for (int y = 0; y < H; ++y) {
+                    int sy = y + ky - CONV_PADDING;
+                    if (sy < 0 || sy >= H) continue;
+                    for (int x = 0; x < W; ++x) {
+                        int sx = x + kx - CONV_PADDING;
+                        if (sx < 0 || sx >= W) continue;
+                        image[(c * H + sy) * W + sx] += row[y * W + x];
+                    }
+                }
+            }
+        }
+    }
+}
+
+void maxPoolForward(const float* input, const Shape& shape, float* output, int* maxIndex) {
+    const int outH = shape.height / POOL_SIZE, outW = shape.width / POOL_SIZE;
+    for (int c = 0; c < shape.channels; ++c) {
+        for (int y = 0; y < outH; ++y) {
+            for (int x = 0; x < outW; ++x) {
+                // Start at the window's own first pixel, so an all -inf or NaN window keeps its gradient inside the window
+                int bestIndex = (c * shape.height + y * POOL_SIZE) * shape.width + x * POOL_SIZE;
+                float best = input[bestIndex];
+                for (int dy = 0; dy < POOL_SIZE; ++dy) {
+                    for (int dx = 0; dx < POOL_SIZE; ++dx) {
+                        int index = (c * shape.height + y * POOL_SIZE + dy) * shape.width + x * POOL_SIZE + dx;
+                        if (input[index] > best) {
+                            best = input[index];
+                            bestIndex = index;
+                        }
+                    }
+                }
+                int out = (c * outH + y) * outW + x;
+                output[out] = best;
+                maxIndex[out] = bestIndex;
+            }
+        }
+    }
+}
+
+void maxPoolBackward(const float* outputGrad, const Shape& shape, const int* maxIndex, float* inputGrad) {
+    std::fill(inputGrad, inputGrad + shape.size(), 0.0f);
+    int outSize = shape.channels * (shape.height / POOL_SIZE) * (shape.width / POOL_SIZE);
+    for (int i = 0; i < outSize; ++i) {
+        inputGrad[maxIndex[i]] += outputGrad[i];
+    }
+}
+
+void avgPoolForward(const float* input, const Shape& shape, float* output) {
+    const int outH = shape.height / POOL_SIZE, outW = shape.width / POOL_SIZE;
+    const float scale = 1.0f / (POOL_SIZE * POOL_SIZE);
+    for (int c = 0; c < shape.channels; ++c) {
+        for (int y = 0; y < outH; ++y) {
+            for (int x = 0; x < outW; ++x) {
+                float sum = 0.0f;
+                for (int dy = 0; dy < POOL_SIZE; ++dy) {
+                    for (int dx = 0; dx < POOL_SIZE; ++dx) {
+                        sum += input[(c * shape.height + y * POOL_SIZE + dy) * shape.width + x * POOL_SIZE + dx];
+                    }
+                }
+                output[(c * outH + y) * outW + x] = sum * scale;
+            }
+        }
+    }
+}
+
+void avgPoolBackward(const float* outputGrad, const Shape& shape, float* inputGrad) {
+    const int outH = shape.height / POOL_SIZE, outW = shape.width / POOL_SIZE;
+    const float scale = 1.0f / (POOL_SIZE * POOL_SIZE);
+    std::fill(inputGrad, inputGrad + shape.size(), 0.0f);
+    for (int c = 0; c < shape.channels; ++c) {
+        for (int y = 0; y < outH; ++y) {
+            for (int x = 0; x < outW; ++x) {
+                float g = outputGrad[(c * outH + y) * outW + x] * scale;
+                for (int dy = 0; dy < POOL_SIZE; ++dy) {
+                    for (int dx = 0; dx < POOL_SIZE; ++dx) {
+                        inputGrad[(c * shape.height + y * POOL_SIZE + dy) * shape.width + x * POOL_SIZE + dx] += g;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "Shape.h"
+
+#include <cstddef>
+
+// Low-level numeric kernels on contiguous row-major float arrays.
+// Used by the dense, convolution and pooling layers of Network.
+
+// Machine-dependent kernel parameters, picked per host and topology by the autotuner (Tuning.h).
+// The defaults reproduce the untuned kernels exactly. Only change them while no layer is running.
+struct KernelTuning
+{
+	int gemmBlockN = 0; // Columns of C per cache block in gemm/gemmTN (0: whole rows)
+	int gemmBlockK = 0; // Depth of a gemm cache block (0: all of K)
+	int dotUnroll = 1; // Independent accumulators of dot products (1, 2, 4 or 8)
+	int threads = 0; // Threads a parallel layer loop may use (0: every worker plus the caller)
+	size_t parallelMinWork = 1 << 15; // Multiply-adds per parallel chunk, smaller layers stay on the calling thread
+	float sparseDensity = 0.f; // Dense layers with a smaller share of nonzero inputs skip the zeros (0: never)
+	float backwardDensity = 0.5f; // Dense backward passes with a smaller share of nonzero inputs skip the zeros (0: never, results are the same)
+};
+
+const KernelTuning& kernelTuning(); // Parameters in use
+void setKernelTuning(const KernelTuning& tuning); // Used by all later kernel calls
+
+// init + sum of a[k] * b[k], with kernelTuning().dotUnroll partial sums
+float dot(const float* a, const float* b, size_t count, float init = 0.0f);
+// init + sum of a[index[k]] * b[index[k]] over the given indices (inputs known to be nonzero)
+float sparseDot(const float* a, const float* b, const int* index, size_t count, float init = 0.0f);
+
+// C(MxN) = A(MxK) * B(KxN), added to C if accumulate is true
+void gemm(int M, int N, int K, const float* A, const float* B, float* C, bool accumulate = false);
+// C(MxN) = A(MxK) * B^T, B stored as (NxK)
+void gemmNT(int M, int N, int K, const float* A, const float* B, float* C, bool accumulate = false);
+// C(MxN) = A^T * B(KxN), A stored as (KxM) with rows lda apart (default M), so a block of C's rows can be computed alone
+void gemmTN(int M, int N, int K, const float* A, const float* B, float* C, bool accumulate = false, int lda = 0);
+
+// Unfolds 3x3 "same" patches of a CxHxW image into a (C*9)x(H*W) matrix, so convolution becomes one GEMM
+void im2col(const float* image, const Shape& shape, float* columns);
+// Adds a (C*9)x(H*W) column matrix back into a CxHxW image (gradient of im2col)
+void col2im(const float* columns, const Shape& shape, float* image);
+
+// 2x2 pooling with stride 2. maxIndex stores the input position of every maximum for the backward pass.
+void maxPoolForward(const float* input, const Shape& shape, float* output, int* maxIndex);
+void maxPoolBackward(const float* outputGrad, const Shape& shape, const int* maxIndex, float* inputGrad);
+void avgPoolForward(const float* input, const Shape& shape, float* output);
+void avgPoolBackward(const float* outputGrad, const Shape& shape, float* inputGrad);
@@ -1,6 +1,6 @@
 #include "Layer.h"
 #include <iostream>
-Layer::Layer() {
+Layer::Layer() : neuronCount(0) {
     // Initialize visual properties of the layer rectangle
 	shape.setSize(sf::Vector2f(90.f, 408.f));
 	shape.setFillColor(sf::Color::Blue);
@@ -9,14 +9,8 @@ Layer::Layer() {
 }
 
 sf::FloatRect Layer::getBounds() {
-    // Temporarily disables outline to return correct hitbox
-    if (isActive) {
-        shape.setOutlineThickness(0.f);
-        auto noOutline = shape.getGlobalBounds();
-        shape.setOutlineThickness(5.f);
-        return noOutline;
-    }
-    return shape.getGlobalBounds();
+    // Rectangle itself, the outline of a selected layer is not part of the hitbox
+    return sf::FloatRect(shape.getPosition() - shape.getOrigin(), shape.getSize());
 }
 
 void Layer::setPosition(float x, float y) {
@@ -27,27 +21,16 @@ bool Layer::checkActive() {
     return isActive;
 }
 
-void Layer::draw(sf::RenderWindow& window) {
+void Layer::draw(GUI& window) {
     window.draw(shape);
 }
 
-bool Layer::isSelected(sf::Event& event, GUI& window) {
+bool Layer::isSelected(sf::Event& event, bool underMouse) {
     // Handles mouse click interaction for selecting this layer
+    // (underMouse is false when the click hit one of its neurons)
     if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left && !wasPressed) {
-        
-        std::vector<sf::Vector2f> neuron_pos;
-        sf::Vector2i mouse_pos = sf::Mouse::getPosition(window);
-        sf::Vector2f mouse_world = window.mapPixelToCoords(mouse_pos);
-        
-        // Prevent selection if clicking directly on a neuron
-        for (int i = 0; i < neuronList.size(); i++) {
-            if (neuronList[i]->getBounds().contains(mouse_world)) {
-                return false;
-            }
-        }
-
         // Select layer if mouse is inside the rectangle bounds
-        if (this->getBounds().contains(mouse_world)) {
+        if (underMouse) {
             isActive = !isActive;
             wasPressed = true;
             if (isActive) {              
@@ -65,6 +48,7 @@ bool Layer::isSelected(sf::Event& event, GUI& window) {
     if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Left) {
         wasPressed = false;
     }   
+    return false;
 }
 
 sf::Vector2f Layer::getPosition() {
@@ -90,4 +74,34 @@ void Layer::setActive(bool value) {
 
 void Layer::addNeuron(Neuron* neuron) {
     neuronList.push_back(neuron);
+}
+
+void Layer::setWidth(float width) {
+    shape.setSize(sf::Vector2f(width, shape.getSize().y));
+}
+
+bool Layer::isAggregated() {
+    return neuronCount > DETAIL_NEURONS;
+}
+
+void Layer::setType(LayerType value) {
+    type = value;
+    switch (type) {
+    case LayerType::Conv2D: shape.setFillColor(sf::Color(128, 0, 128)); break;
+    case LayerType::MaxPool:
+    case LayerType::AvgPool: shape.setFillColor(sf::Color(0, 128, 128)); break;
+    default: shape.setFillColor(sf::Color::Blue); break;
+    }
+}
+
+LayerType Layer::getType() {
+    return type;
+}
+
+void Layer::setActivation(Activation value) {
+    activation = value;
+}
+
+Activation Layer::getActivation() {
+    return activation;
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include <SFML/Graphics.hpp>
 #include "GUI.h"
 #include "Neuron.h"
+#include "Shape.h"
+#include "Activation.h"
 #include <cstdlib>
 class GUI;
 class Neuron;
@@ -16,18 +18,26 @@ private:
 	bool wasPressed = false; // Used to debounce mouse click events
 	std::vector<Neuron*> neuronList; // List of neuron pointers inside the layer
 	int neuronCount; // Number of neurons in this layer
+	LayerType type = LayerType::Dense; // Dense, convolution (neurons are filters) or pooling
+	Activation activation = Activation::ReLU; // Nonlinearity of a hidden dense/conv layer (the output layer is softmax)
 public:
 	Layer(); // Constructor
-	bool isSelected(sf::Event& event, GUI& window); // Handles user interaction with the layer (selection)
+	bool isSelected(sf::Event& event, bool underMouse); // Handles user interaction with the layer (selection), underMouse from GUI::hitTest
 	bool checkActive(); // Returns true if the layer is currently active
-	sf::FloatRect getBounds(); // Gets the bounding box of the layer (optionally without outline)
+	sf::FloatRect getBounds(); // Gets the bounding box of the layer (without the selection outline)
 	void setPosition(float x, float y); // Set the position of the layer on the screen
-	void draw(sf::RenderWindow& window); // Draws the layer rectangle on the window
+	void draw(GUI& window); // Draws the layer rectangle on the window
 	sf::Vector2f getPosition(); // Get the position of the layer on the screen
 	int getNeuronCount(); // Access neuron count
 	std::vector<Neuron*>& getNeuronList(); // Access and modify the neuron list
 	void setNeuronCount(int inc); // Modify neuron count
 	void setActive(bool value);	// Set selection status
 	void addNeuron(Neuron* neuron); // Add neuron to the model
+	void setWidth(float width); // Narrow the layer box when many layers are shown
+	bool isAggregated(); // True if the layer is too wide to draw individual neurons
+	void setType(LayerType value); // Set layer kind, the box color shows it
+	LayerType getType(); // Get layer kind
+	void setActivation(Activation value);
+	Activation getActivation();
 };
 
@@ -0,0 +1,161 @@
+#include "MappedDataset.h"
+#include "Trace.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::uint64_t DatasetHeader::fileSize() const {
+    return bytes + static_cast<std::uint64_t>(count) * (1 + pixels);
+}
+
+bool parseDatasetHeader(const void* data, size_t available, DatasetHeader& out) {
+    const std::uint32_t* header = static_cast<const std::uint32_t*>(data);
+    if (available < DATASET_HEADER_V1 || header[2] == 0) return false;
+    out.count = header[1];
+    out.pixels = header[2];
+    if (header[0] == DATASET_MAGIC_V1) {
+        out.bytes = DATASET_HEADER_V1;
+        out.shape.input = inferShape(out.pixels);
+        out.shape.classes = 0;
+        return true;
+    }
+    if (header[0] != DATASET_MAGIC || available < DATASET_HEADER) return false;
+    out.bytes = DATASET_HEADER;
+    out.shape.input = { static_cast<int>(header[3]), static_cast<int>(header[4]), static_cast<int>(header[5]) };
+    out.shape.classes = static_cast<int>(header[6]);
+    return header[3] > 0 && header[4] > 0 && header[5] > 0 && static_cast<std::uint64_t>(header[3]) * header[4] * header[5] == out.pixels;
+}
+
+void makeDatasetHeader(size_t count, const DataShape& shape, std::uint32_t (&out)[DATASET_HEADER / sizeof(std::uint32_t)]) {
+    out[0] = DATASET_MAGIC;
+    out[1] = static_cast<std::uint32_t>(count);
+    out[2] = static_cast<std::uint32_t>(shape.input.size());
+    out[3] = static_cast<std::uint32_t>(shape.input.channels);
+    out[4] = static_cast<std::uint32_t>(shape.input.height);
+    out[5] = static_cast<std::uint32_t>(shape.input.width);
+    out[6] = static_cast<std::uint32_t>(shape.classes);
+}
+
+MappedDataset::~MappedDataset() {
+    close();
+}
+
+void MappedDataset::close() {
+#ifdef _WIN32
+    if (base) UnmapViewOfFile(base);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (base) munmap(const_cast<std::uint8_t*>(base), length);
+    if (fileDescriptor >= 0) ::close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+    base = labels = pixelData = nullptr;
+    length = count = pixelCount = 0;
+    dataShape = DataShape();
+}
+
+bool MappedDataset::open(const std::string& path) {
+    TraceScope trace("Map dataset", "io");
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Error opening dataset " << path << std::endl;
+        return false;
+    }
+    fileHandle = file;
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    length = static_cast<size_t>(fileSize.QuadPart);
+    mappingHandle = length ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    base = mappingHandle ? static_cast<const std::uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+    fileDescriptor = ::open(path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        std::cerr << "Error opening dataset " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    fstat(fileDescriptor, &info);
+    length = static_cast<size_t>(info.st_size);
+    if (length) {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+        base = (mapping == MAP_FAILED) ? nullptr : static_cast<const std::uint8_t*>(mapping);
+    }
+#endif
+    if (!base) {
+        std::cerr << "Error mapping dataset " << path << std::endl;
+        close();
+        return false;
+    }
+
+    DatasetHeader header;
+    if (!parseDatasetHeader(base, length, header) || length != header.fileSize()) {
+        std::cerr << path << " is not a valid dataset file" << std::endl;
+        close();
+        return false;
+    }
+    count = header.count;
+    pixelCount = header.pixels;
+    dataShape = header.shape;
+    labels = base + header.bytes;
+    pixelData = labels + count;
+    if (dataShape.classes == 0 && count > 0) dataShape.classes = *std::max_element(labels, labels + count) + 1;
+    return true;
+}
+
+size_t MappedDataset::size() const {
+    return count;
+}
+
+size_t MappedDataset::inputSize() const {
+    return pixelCount;
+}
+
+int MappedDataset::label(size_t index) const {
+    return labels[index];
+}
+
+const std::uint8_t* MappedDataset::pixels(size_t index) const {
+    return pixelData + index * pixelCount;
+}
+
+DataShape MappedDataset::shape() const {
+    return dataShape;
+}
+
+bool MappedDataset::write(const std::string& path, const DatasetView& dataset) {
+    if (dataset.empty()) {
+        std::cerr << "Cannot write an empty dataset" << std::endl;
+        return false;
+    }
+    std::uint32_t header[DATASET_HEADER / sizeof(std::uint32_t)];
+    makeDatasetHeader(dataset.size(), dataset.shape(), header);
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error writing dataset " << path << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (size_t i = 0; i < dataset.size(); ++i) {
+        char label = static_cast<char>(dataset.label(i));
+        file.write(&label, 1);
+    }
+    for (size_t i = 0; i < dataset.size(); ++i) {
+        file.write(reinterpret_cast<const char*>(dataset.pixels(i)), dataset.inputSize());
+    }
+    return static_cast<bool>(file);
+}
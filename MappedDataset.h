@@ -0,0 +1,66 @@
+#pragma once
+#include "Dataset.h"
+#include <string>
+#include <cstdint>
+
+// Magic numbers at the start of binary dataset files: "NNDS" (version 1) and "NND2" (version 2, written by this version)
+const std::uint32_t DATASET_MAGIC_V1 = 0x53444E4E;
+const std::uint32_t DATASET_MAGIC = 0x32444E4E;
+// Version 1 header: magic, sample count, pixels per sample
+const size_t DATASET_HEADER_V1 = 3 * sizeof(std::uint32_t);
+// Version 2 header: magic, sample count, pixels per sample, channels, height, width, classes
+const size_t DATASET_HEADER = 7 * sizeof(std::uint32_t);
+
+// Decoded header of a binary dataset file
+struct DatasetHeader
+{
+	size_t bytes = 0; // Header size, the labels follow
+	size_t count = 0; // Number of samples
+	size_t pixels = 0; // Pixels per sample
+	DataShape shape; // Version 1: inferred from the pixel count, classes 0 until the labels are scanned
+
+	std::uint64_t fileSize() const; // Expected file size for this header
+};
+
+// Header at the start of a file (available bytes read), false for unknown magic numbers or inconsistent dimensions
+bool parseDatasetHeader(const void* data, size_t available, DatasetHeader& out);
+// Version 2 header of count samples
+void makeDatasetHeader(size_t count, const DataShape& shape, std::uint32_t (&out)[DATASET_HEADER / sizeof(std::uint32_t)]);
+
+// Read-only dataset file mapped into memory.
+// Layout: header (DatasetHeader), one uint8 label per sample, then uint8 pixels sample by sample.
+// The mapping is never written, so any number of threads can read it at the same time without copies.
+class MappedDataset : public DatasetView
+{
+private:
+	const std::uint8_t* base = nullptr; // Start of the mapping
+	size_t length = 0; // Mapped bytes
+	size_t count = 0; // Number of samples
+	size_t pixelCount = 0; // Pixels per sample
+	DataShape dataShape;
+	const std::uint8_t* labels = nullptr; // count labels
+	const std::uint8_t* pixelData = nullptr; // count * pixelCount raw pixels
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+	void close(); // Unmap and release the file
+
+public:
+	MappedDataset() = default;
+	MappedDataset(const MappedDataset&) = delete;
+	MappedDataset& operator=(const MappedDataset&) = delete;
+	~MappedDataset();
+
+	bool open(const std::string& path); // Map a file written by write(), false on any format error
+	size_t size() const override; // Number of samples
+	size_t inputSize() const override; // Pixels per sample
+	int label(size_t index) const override; // Label of one sample
+	const std::uint8_t* pixels(size_t index) const override; // Raw pixels of one sample inside the mapping
+	DataShape shape() const override; // From the header (version 1 files: inferred, classes from the labels)
+
+	// Store any dataset in the binary layout
+	static bool write(const std::string& path, const DatasetView& dataset);
+};
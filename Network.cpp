@@ -1,233 +1,870 @@
 #include "Network.h"
+#include "Activation.h"
+#include "Export.h"
+#include "Kernels.h"
+#include "TaskScheduler.h"
+#include "Trace.h"
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <sstream>
 
 
 // Constructor: fetches layers from GUI and initializes network weights
-Network::Network(float learning_rate, int epochs, GUI* window)
-    : learning_rate(learning_rate), epochs(epochs), window(window) {
-    layerList.clear();
-    for (Layer* guiLayer : window->getLayerList()) {
-        layerList.push_back(guiLayer);
-    }
+Network::Network(float learning_rate, int epochs, GUI* window, const Shape& input)
+    : learning_rate(learning_rate), epochs(epochs), window(window), random(threadRandom().split()), inputShape(input) {
+    syncLayers();
 
     std::cout << "Final layer count: " << layerList.size() << std::endl;
 
     this->initializeWeights();
 }
 
-// Initialize weights and biases for all neurons in all layers
-void Network::initializeWeights() {
-    std::cout << "Initializing weights for network with " << layerList.size() << " layers" << std::endl;
-    for (size_t i = 0; i < layerList.size(); ++i) {
-        size_t inputSize = (i == 0) ? 784 : layerList[i - 1]->getNeuronCount();
+// Headless constructor: the network owns its layers (used for benchmarks and background jobs)
+Network::Network(const std::vector<int>& layerSizes, float learning_rate, int epochs, const std::vector<LayerType>& layerTypes,
+    const std::vector<Activation>& activations, const Shape& input)
+    : learning_rate(learning_rate), epochs(epochs), window(nullptr), ownsLayers(true), random(threadRandom().split()), inputShape(input) {
+    createLayers(layerSizes, layerTypes, activations);
+    this->initializeWeights();
+}
+
+// Headless network with the topology and weights of a checkpoint
+Network::Network(const Checkpoint& checkpoint, float learning_rate, int epochs)
+    : learning_rate(learning_rate), epochs(epochs), window(nullptr), ownsLayers(true), random(threadRandom().split()), inputShape(checkpoint.input) {
+    std::vector<LayerType> layerTypes;
+    for (int type : checkpoint.types) {
+        layerTypes.push_back(static_cast<LayerType>(type));
+    }
+    std::vector<Activation> activations;
+    for (int activation : checkpoint.activations) {
+        activations.push_back(static_cast<Activation>(activation));
+    }
+    createLayers(std::vector<int>(checkpoint.sizes.begin() + 1, checkpoint.sizes.end()), layerTypes, activations);
+    if (!setCheckpoint(checkpoint)) {
+        this->initializeWeights();
+    }
+}
+
+// Creates the layers and neurons owned by a headless network
+void Network::createLayers(const std::vector<int>& layerSizes, const std::vector<LayerType>& layerTypes, const std::vector<Activation>& activations) {
+    for (size_t i = 0; i < layerSizes.size(); ++i) {
+        Layer* layer = new Layer();
+        if (i < layerTypes.size()) layer->setType(layerTypes[i]);
+        if (i < activations.size()) layer->setActivation(activations[i]);
+        for (int j = 0; j < layerSizes[i]; ++j) {
+            layer->addNeuron(new Neuron());
+        }
+        layer->setNeuronCount(layerSizes[i]);
+        layerList.push_back(layer);
+    }
+}
 
-        std::cout << "Layer " << i << " expects " << inputSize << " inputs" << std::endl;
+Network::~Network() {
+    if (!ownsLayers) return; // GUI layers belong to the GUI
+    for (Layer* layer : layerList) {
+        for (Neuron* neuron : layer->getNeuronList()) {
+            delete neuron;
+        }
+        delete layer;
+    }
+}
 
+// Initialize weights and biases for all neurons in all layers.
+// Every layer draws from its own stream, so large layers can be filled in parallel with the same result.
+void Network::initializeWeights() {
+    computeShapes();
+    weightsVersion++;
+    std::vector<std::future<void>> jobs;
+    size_t parameterCount = 0;
+    for (size_t i = 0; i < layerList.size(); ++i) {
         Layer* currentLayer = layerList[i];
+        if (!hasParameters(currentLayer->getType())) continue; // Pooling layers have no weights
+        size_t inputSize = fanIn(i);
         size_t neuronCount = currentLayer->getNeuronCount();
-        std::cout << "Initializing weights for " << neuronCount << " neurons in layer " << i << std::endl;
+        parameterCount += neuronCount * (inputSize + 1);
 
-        for (size_t j = 0; j < neuronCount; ++j) {
-            Neuron* neuron = currentLayer->getNeuronList()[j];
-            neuron->initializeWeights(inputSize);
-            if (neuron->getWeights().size() != inputSize) {
-                std::cerr << "ERROR: Neuron " << j << " in layer " << i << " has " << neuron->getWeights().size()
-                    << " weights, but expected " << inputSize << std::endl;
+        auto initializeLayer = [currentLayer, inputSize, neuronCount](RandomStream layerRandom) {
+            for (size_t j = 0; j < neuronCount; ++j) {
+                currentLayer->getNeuronList()[j]->initializeWeights(static_cast<int>(inputSize), layerRandom);
             }
+        };
+        if (neuronCount * inputSize >= PARALLEL_INIT_WEIGHTS) {
+            jobs.push_back(std::async(std::launch::async, initializeLayer, random.split()));
+        }
+        else {
+            initializeLayer(random.split());
         }
     }
+    for (auto& job : jobs) job.get();
 
-    std::cout << "Weight initialization complete" << std::endl;
+    std::cout << "Initialized " << parameterCount << " parameters in " << layerList.size() << " layers" << std::endl;
 }
 
-// Forward pass through all layers with ReLU (hidden) and softmax (output)
+// Forward pass through all layers with each hidden layer's activation and softmax (output)
 std::vector<float> Network::forwardPass(const std::pair<int, std::vector<float>>& input) {
     
-    if (input.second.size() != 784) {
+    if (input.second.size() != static_cast<size_t>(inputShape.size())) {
         std::cout << "WARNING: Input size (" << input.second.size()
-            << ") does not match expected input size (784)" << std::endl;
+            << ") does not match expected input size (" << inputShape.size() << ")" << std::endl;
     }
 
-    const std::vector<float>* currentActivations = &input.second; 
-    std::vector<float> layerOutputs;
-    std::vector<float> nextLayerInputs;
-
-    output.clear();
+    prepareWorkspace(work, input.second);
     for (size_t i = 0; i < layerList.size(); ++i) {
-        Layer* currentLayer = layerList[i];
-        bool isOutputLayer = (i == layerList.size() - 1);
-        size_t neuronCount = currentLayer->getNeuronCount();
-        layerOutputs.clear();
-        layerOutputs.resize(neuronCount);
-        for (size_t j = 0; j < neuronCount; ++j) {
+        forwardLayer(i, work);
+    }
+    output = work.activations.back();
+    return output;
+}
+
+// Sizes the per-layer buffers of a workspace and stores the input sample
+void Network::prepareWorkspace(Workspace& work, const std::vector<float>& input) {
+    size_t numLayers = layerList.size();
+    work.activations.resize(numLayers + 1);
+    work.preActivations.resize(numLayers);
+    work.columns.resize(numLayers);
+    work.poolIndices.resize(numLayers);
+    work.deltas.resize(numLayers);
+    work.activity.resize(numLayers);
+    work.activations[0] = input;
+}
+
+// Computes the output of one layer from work.activations[layerIndex]
+void Network::forwardLayer(int layerIndex, Workspace& work) {
+    TraceScope trace("Forward", "layer", layerIndex);
+    Layer* currentLayer = layerList[layerIndex];
+    if (currentLayer->getType() == LayerType::Conv2D) {
+        convForward(layerIndex, work);
+        return;
+    }
+    if (currentLayer->getType() != LayerType::Dense) {
+        poolForward(layerIndex, work);
+        return;
+    }
+
+    bool isOutputLayer = (layerIndex == static_cast<int>(layerList.size()) - 1);
+    size_t neuronCount = currentLayer->getNeuronCount();
+    const std::vector<float>& currentActivations = work.activations[layerIndex];
+    std::vector<float>& layerOutputs = work.activations[layerIndex + 1];
+    std::vector<float>& layerPreActivations = work.preActivations[layerIndex];
+    layerPreActivations.resize(neuronCount);
+    layerOutputs.resize(neuronCount);
+
+    // Mostly-zero inputs (ReLU outputs) are gathered once, then every neuron only visits the nonzero ones
+    std::vector<int>& active = work.activeInputs;
+    bool sparse = false;
+    if (kernelTuning().sparseDensity > 0.f) {
+        active.clear();
+        for (size_t k = 0; k < currentActivations.size(); ++k) {
+            if (currentActivations[k] != 0.0f) active.push_back(static_cast<int>(k));
+        }
+        sparse = active.size() < kernelTuning().sparseDensity * currentActivations.size();
+    }
+
+    // Output neurons are independent, chunks of them run on the task scheduler
+    taskScheduler().parallelFor(0, neuronCount, minChunk(sparse ? active.size() : currentActivations.size()), [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j) {
             Neuron* neuron = currentLayer->getNeuronList()[j];
             const std::vector<float>& weights = neuron->getWeights();
-            float z = neuron->getBias();
-            if (weights.size() != currentActivations->size()) {
-                std::cerr << "Size mismatch in forwardPass: weights(" << weights.size()
-                    << "), input(" << currentActivations->size() << ") at layer "
-                    << i << ", neuron " << j << "\n";
-                if (i > 0 && j == 0) { 
-                    std::cout << "Attempting to fix weights for layer " << i << " to match input size "
-                        << currentActivations->size() << std::endl;
-                }
 
-                // Weighted sum: z = wx + b
-                for (size_t k = 0; k < currentActivations->size(); ++k) {
-                    z += neuron->getWeights()[k] * (*currentActivations)[k];
-                }
+            // Weighted sum: z = wx + b (sizes are guaranteed by initializeWeights and the edit hooks)
+            float z = sparse ? sparseDot(weights.data(), currentActivations.data(), active.data(), active.size(), neuron->getBias())
+                : dot(weights.data(), currentActivations.data(), weights.size(), neuron->getBias());
+            // Save pre-activation for backprop (only in the workspace, neurons are not written by forward passes)
+            layerPreActivations[j] = z;
+        }
+        if (isOutputLayer) return;
+
+        // Hidden layers apply their activation to the whole chunk at once (vectorized)
+        activate(currentLayer->getActivation(), layerPreActivations.data() + begin, layerOutputs.data() + begin, end - begin);
+    });
+
+    // Apply softmax only at output layer
+    if (isOutputLayer) {
+        softmax(layerPreActivations.data(), layerOutputs.data(), neuronCount);
+    }
+}
+
+// Copies the filters of a convolution layer into one (filters x weights) matrix for GEMM
+void Network::packFilters(int layerIndex, Workspace& work) {
+    auto& neuronList = layerList[layerIndex]->getNeuronList();
+    size_t weightCount = fanIn(layerIndex);
+    work.filters.resize(neuronList.size() * weightCount);
+    for (size_t o = 0; o < neuronList.size(); ++o) {
+        const std::vector<float>& weights = neuronList[o]->getWeights();
+        std::copy(weights.begin(), weights.end(), work.filters.begin() + o * weightCount);
+    }
+}
+
+// 3x3 convolution as im2col + GEMM: z(filters x pixels) = W(filters x C*9) * columns(C*9 x pixels)
+void Network::convForward(int layerIndex, Workspace& work) {
+    const Shape& in = inputShapes[layerIndex];
+    auto& neuronList = layerList[layerIndex]->getNeuronList();
+    int filterCount = static_cast<int>(neuronList.size());
+    int weightCount = static_cast<int>(fanIn(layerIndex));
+    int pixels = in.height * in.width;
+
+    work.columns[layerIndex].resize(static_cast<size_t>(weightCount) * pixels);
+    im2col(work.activations[layerIndex].data(), in, work.columns[layerIndex].data());
+    packFilters(layerIndex, work);
+
+    std::vector<float>& z = work.preActivations[layerIndex];
+    std::vector<float>& out = work.activations[layerIndex + 1];
+    z.resize(static_cast<size_t>(filterCount) * pixels);
+    out.resize(z.size());
+    // Every chunk of filters is a block of rows of the GEMM
+    const float* columnData = work.columns[layerIndex].data();
+    const float* filterData = work.filters.data();
+    taskScheduler().parallelFor(0, filterCount, minChunk(static_cast<size_t>(weightCount) * pixels), [&](size_t begin, size_t end) {
+        int rows = static_cast<int>(end - begin);
+        gemm(rows, pixels, weightCount, filterData + begin * weightCount, columnData, z.data() + begin * pixels);
+
+        Activation activation = layerList[layerIndex]->getActivation();
+        for (size_t o = begin; o < end; ++o) {
+            float bias = neuronList[o]->getBias();
+            float* row = z.data() + o * pixels;
+            for (int p = 0; p < pixels; ++p) {
+                row[p] += bias;
             }
-            else {
-                for (size_t k = 0; k < weights.size(); ++k) {
-                    z += weights[k] * (*currentActivations)[k];
+            activate(activation, row, out.data() + o * pixels, pixels);
+        }
+    });
+}
+
+void Network::poolForward(int layerIndex, Workspace& work) {
+    const Shape& in = inputShapes[layerIndex];
+    std::vector<float>& out = work.activations[layerIndex + 1];
+    out.resize(inputShapes[layerIndex + 1].size());
+    if (layerList[layerIndex]->getType() == LayerType::MaxPool) {
+        work.poolIndices[layerIndex].resize(out.size());
+        maxPoolForward(work.activations[layerIndex].data(), in, out.data(), work.poolIndices[layerIndex].data());
+    }
+    else {
+        avgPoolForward(work.activations[layerIndex].data(), in, out.data());
+    }
+}
+
+// Error with respect to a layer's input, computed from its deltas (dL/dz) and current weights
+void Network::propagateError(int layerIndex, Workspace& work, std::vector<float>& inputError) {
+    Layer* layer = layerList[layerIndex];
+    const Shape& in = inputShapes[layerIndex];
+    const std::vector<float>& delta = work.deltas[layerIndex];
+    inputError.assign(in.size(), 0.0f);
+
+    if (layer->getType() == LayerType::Dense) {
+        // Chunks own a range of inputs and walk the active neurons, so no two chunks write the same element
+        auto& neuronList = layer->getNeuronList();
+        const std::vector<int>& units = work.activeUnits;
+        Layer* prevLayer = layerList[layerIndex - 1];
+        if (work.sparseInputs && hasParameters(prevLayer->getType()) && prevLayer->getActivation() == Activation::ReLU) {
+            // A zero input is a ReLU output with zero derivative, its error would be discarded by passError
+            const std::vector<int>& columns = work.activeInputs;
+            taskScheduler().parallelFor(0, columns.size(), minChunk(units.size()), [&](size_t begin, size_t end) {
+                for (int i : units) {
+                    const float* weights = neuronList[i]->getWeights().data();
+                    float gradient = delta[i];
+                    for (size_t c = begin; c < end; ++c) {
+                        inputError[columns[c]] += gradient * weights[columns[c]];
+                    }
+                }
+            });
+            return;
+        }
+        taskScheduler().parallelFor(0, inputError.size(), minChunk(units.size()), [&](size_t begin, size_t end) {
+            for (int i : units) {
+                const std::vector<float>& weights = neuronList[i]->getWeights();
+                float gradient = delta[i];
+                for (size_t k = begin; k < end; ++k) {
+                    inputError[k] += gradient * weights[k];
                 }
             }
-            // Save pre-activation for backprop
-            neuron->setActivationPreReLU(z);
+        });
+    }
+    else if (layer->getType() == LayerType::Conv2D) {
+        // dColumns(C*9 x pixels) = W^T * delta, folded back into the image by col2im
+        int filterCount = layer->getNeuronCount();
+        int weightCount = static_cast<int>(fanIn(layerIndex));
+        int pixels = in.height * in.width;
+        packFilters(layerIndex, work);
+        std::vector<float> columnError(static_cast<size_t>(weightCount) * pixels);
+        const float* filterData = work.filters.data();
+        taskScheduler().parallelFor(0, weightCount, minChunk(static_cast<size_t>(filterCount) * pixels), [&](size_t begin, size_t end) {
+            gemmTN(static_cast<int>(end - begin), pixels, filterCount, filterData + begin, delta.data(),
+                columnError.data() + begin * pixels, false, weightCount);
+        });
+        col2im(columnError.data(), in, inputError.data());
+    }
+    else if (layer->getType() == LayerType::MaxPool) {
+        maxPoolBackward(delta.data(), in, work.poolIndices[layerIndex].data(), inputError.data());
+    }
+    else {
+        avgPoolBackward(delta.data(), in, inputError.data());
+    }
+}
 
-            // Apply activation: ReLU for hidden, identity for output
-            float activation = (!isOutputLayer) ? std::max(0.0f, z) : z;
-            neuron->setOutput(activation);
-            layerOutputs[j] = activation;
-        }
+// Output layer: initial gradient (dL/dz) = predicted - target, computed from the logits together with the loss
+float Network::outputError(int trueLabel, Workspace& work) {
+    int numLayers = layerList.size();
+    Layer* outputLayer = layerList[numLayers - 1];
+    std::vector<float>& prediction = work.activations.back();
+    std::vector<float>& delta = work.deltas[numLayers - 1];
+    delta.resize(prediction.size());
+    float loss = softmaxCrossEntropy(work.preActivations[numLayers - 1].data(), prediction.data(), delta.data(), delta.size(), trueLabel);
+    for (size_t i = 0; i < delta.size(); ++i) {
+        outputLayer->getNeuronList()[i]->setGradient(delta[i]);
+    }
+    return loss;
+}
 
-        // Apply softmax only at output layer
-        if (isOutputLayer) {
-            float maxLogit = *std::max_element(layerOutputs.begin(), layerOutputs.end());
-            float sumExp = 0.f;
+// Neurons with a nonzero delta and nonzero inputs of a dense layer. With ReLU most of both are zero, and every
+// weight they meet would be updated by exactly zero. Inactive neurons are always skipped (their rows are contiguous);
+// inputs only below kernelTuning().backwardDensity, above it the indexed loops cost more than the zeros they skip.
+void Network::gatherActive(int layerIndex, const std::vector<float>& layerInput, Workspace& work) {
+    const std::vector<float>& delta = work.deltas[layerIndex];
+    work.activeUnits.clear();
+    for (size_t i = 0; i < delta.size(); ++i) {
+        if (delta[i] != 0.0f) work.activeUnits.push_back(static_cast<int>(i));
+    }
+    work.activeInputs.clear();
+    for (size_t k = 0; k < layerInput.size(); ++k) {
+        if (layerInput[k] != 0.0f) work.activeInputs.push_back(static_cast<int>(k));
+    }
+    work.sparseInputs = work.activeInputs.size() < kernelTuning().backwardDensity * layerInput.size();
 
-            for (float& val : layerOutputs) {
-                val = std::exp(val - maxLogit);
-                sumExp += val;
-            }
+    BackwardActivity& activity = work.activity[layerIndex];
+    activity.activeUnits += work.activeUnits.size();
+    activity.units += delta.size();
+    activity.activeInputs += work.activeInputs.size();
+    activity.inputs += layerInput.size();
+    activity.sparsePasses += work.sparseInputs ? 1 : 0;
+    activity.passes++;
+}
 
-            for (size_t j = 0; j < neuronCount; ++j) {
-                float softmaxVal = layerOutputs[j] / sumExp;
-                currentLayer->getNeuronList()[j]->setOutput(softmaxVal);
-                layerOutputs[j] = softmaxVal;
+// Deltas of layer l - 1 from the deltas of layer l
+void Network::passError(int layerIndex, Workspace& work) {
+    std::vector<float>& inputError = work.inputError;
+    propagateError(layerIndex, work, inputError);
+    Layer* prevLayer = layerList[layerIndex - 1];
+    std::vector<float>& prevDelta = work.deltas[layerIndex - 1];
+    if (hasParameters(prevLayer->getType())) {
+        // Derivative of the previous layer's activation, its output is this layer's input
+        prevDelta.resize(inputError.size());
+        activationBackward(prevLayer->getActivation(), work.preActivations[layerIndex - 1].data(), work.activations[layerIndex].data(),
+            inputError.data(), prevDelta.data(), inputError.size());
+        if (prevLayer->getType() == LayerType::Dense) {
+            for (int i = 0; i < prevLayer->getNeuronCount(); ++i) {
+                prevLayer->getNeuronList()[i]->setGradient(prevDelta[i]);
             }
         }
-        nextLayerInputs = layerOutputs;
-        currentActivations = &nextLayerInputs;
     }
-    output = *currentActivations;
-    return output;
+    else {
+        prevDelta = inputError; // Pooling layers have no activation function
+    }
 }
 
-// Backpropagation using cross-entropy loss and gradient descent
-void Network::backPropagation(std::pair<int, std::vector<float>> input) {
-    int trueLabel = input.first;
+// Backpropagation using cross-entropy loss and gradient descent, returns the loss of the sample.
+// Two phases: every delta and parameter gradient is computed first, with the weights of the forward pass, into the
+// gradient buffers; then one SGD step updates all layers. Updating a layer before propagating through it would
+// compute the lower layers' gradients with weights the forward pass never used.
+float Network::backPropagation(std::pair<int, std::vector<float>> input) {
     int numLayers = layerList.size();
-    Layer* outputLayer = layerList[numLayers - 1];
-    int outputSize = outputLayer->getNeuronCount();
-
-    // Output layer: compute initial gradient (dL/dz) = predicted - target
-    for (int i = 0; i < outputSize; ++i) {
-        Neuron* neuron = outputLayer->getNeuronList()[i];
-        float output = neuron->getOutput();
-        float target = (i == trueLabel) ? 1.0f : 0.0f;
-        float error = output - target;
-        neuron->setGradient(error);
-    }
-
-    // Update weights/biases for output layer (if >1 layers)
-    if (numLayers > 1) { 
-        Layer* prevLayer = layerList[numLayers - 2];
-        int prevLayerSize = prevLayer->getNeuronCount();
-        for (int i = 0; i < outputSize; ++i) {
-            Neuron* neuron = outputLayer->getNeuronList()[i];
-            float gradient = neuron->getGradient();
-            for (int j = 0; j < prevLayerSize; ++j) {
-                float prevActivation = prevLayer->getNeuronList()[j]->getOutput();
-                float dw = gradient * prevActivation;
-                float w = neuron->getWeights()[j];
-                float updatedW = w - learning_rate * dw;
-                neuron->updateWeights(j, updatedW);
+    work.deltas.resize(numLayers);
+    gradients.resize(numLayers);
+    gradientRows.resize(numLayers);
+    float loss = outputError(input.first, work);
+    for (int l = numLayers - 1; l >= 0; --l) {
+        backwardLayer(l, work, gradients[l]);
+        if (layerList[l]->getType() == LayerType::Dense) gradientRows[l].swap(work.activeUnits); // Inactive neurons have zero rows
+    }
+    for (int l = 0; l < numLayers; ++l) {
+        applyGradients(l, gradients[l], 1.0f, layerList[l]->getType() == LayerType::Dense ? &gradientRows[l] : nullptr);
+    }
+    return loss;
+}
+
+// Adds dL/dparams of one layer to gradients (weights then bias of every neuron), then passes the error down.
+// Weights are not touched, so the samples of a batch can be processed in any order before applyGradients.
+void Network::backwardLayer(int layerIndex, Workspace& work, std::vector<float>& gradients) {
+    TraceScope trace("Backward", "layer", layerIndex);
+    Layer* currentLayer = layerList[layerIndex];
+    const std::vector<float>& layerInput = work.activations[layerIndex];
+    const std::vector<float>& delta = work.deltas[layerIndex];
+    size_t rowSize = fanIn(layerIndex) + 1;
+    gradients.resize(currentLayer->getNeuronCount() * rowSize, 0.0f);
+
+    if (currentLayer->getType() == LayerType::Dense) {
+        gatherActive(layerIndex, layerInput, work);
+        const std::vector<int>& units = work.activeUnits;
+        const std::vector<int>& columns = work.activeInputs;
+        bool sparseInputs = work.sparseInputs;
+        taskScheduler().parallelFor(0, units.size(), minChunk(sparseInputs ? columns.size() : layerInput.size()), [&](size_t begin, size_t end) {
+            for (size_t u = begin; u < end; ++u) {
+                float* row = gradients.data() + units[u] * rowSize;
+                float gradient = delta[units[u]];
+                if (sparseInputs) {
+                    for (int j : columns) row[j] += gradient * layerInput[j];
+                }
+                else {
+                    for (size_t j = 0; j < layerInput.size(); ++j) {
+                        row[j] += gradient * layerInput[j];
+                    }
+                }
+                row[rowSize - 1] += gradient;
             }
-            float db = gradient;
-            float b = neuron->getBias();
-            float updatedB = b - learning_rate * db;
-            neuron->setBias(updatedB);
-        }
-    }
-
-    // Special case: single-layer network
-    else if (numLayers == 1) {
-        for (int i = 0; i < outputSize; ++i) {
-            Neuron* neuron = outputLayer->getNeuronList()[i];
-            float gradient = neuron->getGradient();
-            for (int j = 0; j < input.second.size(); ++j) {
-                float x = input.second[j];
-                float dw = gradient * x;
-                float w = neuron->getWeights()[j];
-                float updatedW = w - learning_rate * dw;
-                neuron->updateWeights(j, updatedW);
+        });
+    }
+    else if (currentLayer->getType() == LayerType::Conv2D) {
+        int filterCount = currentLayer->getNeuronCount();
+        int weightCount = static_cast<int>(rowSize - 1);
+        int pixels = inputShapes[layerIndex].height * inputShapes[layerIndex].width;
+        std::vector<float>& filterGrads = work.filterGrads;
+        filterGrads.resize(static_cast<size_t>(filterCount) * weightCount);
+        taskScheduler().parallelFor(0, filterCount, minChunk(static_cast<size_t>(weightCount) * pixels), [&](size_t begin, size_t end) {
+            gemmNT(static_cast<int>(end - begin), weightCount, pixels, delta.data() + begin * pixels, work.columns[layerIndex].data(),
+                filterGrads.data() + begin * weightCount);
+            for (size_t o = begin; o < end; ++o) {
+                float* row = gradients.data() + o * rowSize;
+                float db = 0.f;
+                for (int p = 0; p < pixels; ++p) {
+                    db += delta[o * pixels + p];
+                }
+                for (int j = 0; j < weightCount; ++j) {
+                    row[j] += filterGrads[o * weightCount + j];
+                }
+                row[weightCount] += db;
             }
-            float db = gradient;
-            float b = neuron->getBias();
-            float updatedB = b - learning_rate * db;
-            neuron->setBias(updatedB);
-        }
-    }
-
-    // Backpropagate through hidden layers
-    for (int l = numLayers - 2; l >= 0; --l) {
-        Layer* currentLayer = layerList[l];
-        Layer* nextLayer = layerList[l + 1];
-        int currentLayerSize = currentLayer->getNeuronCount();
-        int nextLayerSize = nextLayer->getNeuronCount();
-        for (int i = 0; i < currentLayerSize; ++i) {
-            Neuron* neuron = currentLayer->getNeuronList()[i];
-
-            // Accumulate error from next layer
-            float preActivation = neuron->getActivationPreReLU();
-            float errorSignal = 0.0f;
-            for (int j = 0; j < nextLayerSize; ++j) {
-                Neuron* nextNeuron = nextLayer->getNeuronList()[j];
-                errorSignal += nextNeuron->getGradient() * nextNeuron->getWeights()[i];
+        });
+    }
+
+    if (layerIndex > 0) passError(layerIndex, work);
+}
+
+// Gradient descent step with accumulated gradients (scale is 1 / samples for a mean), clears them afterwards.
+// The batch trainers (PipelineTrainer, the data-parallel workers and the online tuner) all pass scale 1: a step
+// with the summed gradient, batch size times larger than a mean-gradient step. A batch then moves the weights
+// about as far as per-sample SGD over the same samples would, so every trainer uses the learning rate tuned for
+// backPropagation instead of one scaled by its batch size.
+void Network::applyGradients(int layerIndex, std::vector<float>& gradients, float scale, const std::vector<int>* rows) {
+    Layer* currentLayer = layerList[layerIndex];
+    if (!hasParameters(currentLayer->getType()) || gradients.empty()) return;
+    weightsVersion++; // Atomic, pipeline stages update their layers concurrently
+    size_t rowSize = fanIn(layerIndex) + 1;
+    float step = learning_rate * scale;
+    size_t rowCount = rows ? rows->size() : currentLayer->getNeuronCount();
+    taskScheduler().parallelFor(0, rowCount, minChunk(rowSize), [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+            size_t i = rows ? (*rows)[r] : r;
+            float* row = gradients.data() + i * rowSize;
+            currentLayer->getNeuronList()[i]->applyGradient(row, step);
+            std::fill(row, row + rowSize, 0.0f);
+        }
+    });
+}
+
+// Multiply-adds of one layer's forward pass for one sample (used to balance pipeline stages)
+size_t Network::layerWork(int layerIndex) {
+    Layer* layer = layerList[layerIndex];
+    size_t pixels = static_cast<size_t>(inputShapes[layerIndex].height) * inputShapes[layerIndex].width;
+    if (layer->getType() == LayerType::Dense) return layer->getNeuronCount() * fanIn(layerIndex);
+    if (layer->getType() == LayerType::Conv2D) return layer->getNeuronCount() * fanIn(layerIndex) * pixels;
+    return inputShapes[layerIndex].size();
+}
+
+// Neuron-major [weights..., bias] rows of a dense or convolution layer
+size_t Network::gradientSize(int layerIndex) {
+    Layer* layer = layerList[layerIndex];
+    if (!hasParameters(layer->getType())) return 0;
+    return layer->getNeuronCount() * (fanIn(layerIndex) + 1);
+}
+
+std::vector<BackwardActivity> Network::takeActivity() {
+    std::vector<BackwardActivity> activity = work.activity;
+    std::fill(work.activity.begin(), work.activity.end(), BackwardActivity());
+    return activity;
+}
+
+void Network::reportActivity(const std::vector<BackwardActivity>& activity) {
+    std::ostringstream line;
+    double now = traceClock();
+    for (size_t l = 0; l < activity.size(); ++l) {
+        const BackwardActivity& layer = activity[l];
+        if (layer.passes == 0) continue;
+        float units = static_cast<float>(layer.activeUnits) / std::max<size_t>(1, layer.units);
+        float inputs = static_cast<float>(layer.activeInputs) / std::max<size_t>(1, layer.inputs);
+        line << (line.tellp() > 0 ? ", " : "") << "layer " << l + 1 << " " << units * 100.f << "% units / " << inputs * 100.f << "% inputs"
+            << (layer.sparsePasses * 2 > layer.passes ? " (sparse)" : "");
+        traceCounter("Active units", now, units, static_cast<int>(l));
+        traceCounter("Active inputs", now, inputs, static_cast<int>(l));
+    }
+    if (line.tellp() > 0) std::cout << "Backward activity: " << line.str() << std::endl;
+}
+
+int Network::getLayerCount() {
+    return static_cast<int>(layerList.size());
+}
+
+const Shape& Network::getInputShape() const {
+    return inputShape;
+}
+
+int Network::getEpoch() {
+    return epochs;
+}
+
+void Network::setEpoch(int value) {
+    epochs = value;
+}
+
+// Refresh layer pointers after the GUI changed the layer list
+void Network::syncLayers() {
+    if (window) {
+        layerList.clear();
+        for (Layer* guiLayer : window->getLayerList()) {
+            layerList.push_back(guiLayer);
+        }
+    }
+    computeShapes();
+    weightsVersion++; // Every topology edit passes through here
+}
+
+void Network::computeShapes() {
+    inputShapes.assign(1, inputShape);
+    for (Layer* layer : layerList) {
+        inputShapes.push_back(outputShape(layer->getType(), inputShapes.back(), layer->getNeuronCount()));
+    }
+}
+
+// Layers whose input shape changed (e.g. a pooling layer was removed) cannot keep their weights
+void Network::repairWeights() {
+    computeShapes();
+    weightsVersion++;
+    for (size_t i = 0; i < layerList.size(); ++i) {
+        if (!hasParameters(layerList[i]->getType())) continue;
+        size_t inputSize = fanIn(i);
+        bool reinitialized = false;
+        for (Neuron* neuron : layerList[i]->getNeuronList()) {
+            if (neuron->getWeights().size() != inputSize) {
+                neuron->initializeWeights(static_cast<int>(inputSize), random);
+                reinitialized = true;
             }
+        }
+        if (reinitialized) {
+            std::cout << "Layer " << i << " reinitialized for its new input shape" << std::endl;
+        }
+    }
+}
 
-            // Derivative of ReLU
-            float gradient = (preActivation > 0) ? errorSignal : 0.0f;
-            neuron->setGradient(gradient);
-
-            // Update weights and bias
-            if (l > 0) {
-                Layer* prevLayer = layerList[l - 1];
-                int prevLayerSize = prevLayer->getNeuronCount();
-
-                for (int j = 0; j < prevLayerSize; ++j) {
-                    float prevActivation = prevLayer->getNeuronList()[j]->getOutput();
-                    float dw = gradient * prevActivation;
-                    float w = neuron->getWeights()[j];
-                    float updatedW = w - learning_rate * dw;
-                    neuron->updateWeights(j, updatedW);
+int Network::indexOf(Layer* layer) {
+    auto it = std::find(layerList.begin(), layerList.end(), layer);
+    return (it == layerList.end()) ? -1 : static_cast<int>(it - layerList.begin());
+}
+
+size_t Network::fanIn(int layerIndex) {
+    return weightsPerNeuron(layerList[layerIndex]->getType(), inputShapes[layerIndex]);
+}
+
+size_t Network::minChunk(size_t workPerItem) {
+    return std::max<size_t>(1, kernelTuning().parallelMinWork / std::max<size_t>(1, workPerItem));
+}
+
+int Network::nextParametricLayer(int layerIndex) {
+    for (int i = layerIndex + 1; i < static_cast<int>(layerList.size()); ++i) {
+        if (hasParameters(layerList[i]->getType())) return i;
+    }
+    return -1;
+}
+
+// Channels are stored in blocks: 9 weights per channel for convolutions, height*width for dense layers
+int Network::channelBlock(int layerIndex) {
+    if (layerList[layerIndex]->getType() == LayerType::Conv2D) return CONV_KERNEL * CONV_KERNEL;
+    return inputShapes[layerIndex].height * inputShapes[layerIndex].width;
+}
+
+// Adds a neuron to a trained network without touching the other weights.
+// Hidden layers are widened Net2Net-style: the new neuron (or convolution filter) copies a random teacher
+// and both share the teacher's outgoing weights, so the network computes the same function.
+void Network::onNeuronAdded(Layer* layer, Neuron* neuron) {
+    syncLayers();
+    int l = indexOf(layer);
+    if (l < 0 || !hasParameters(layer->getType())) return;
+    edited = true;
+
+    auto& neuronList = layer->getNeuronList();
+    size_t newIndex = std::find(neuronList.begin(), neuronList.end(), neuron) - neuronList.begin();
+    size_t inputSize = fanIn(l);
+    int next = nextParametricLayer(l);
+    bool isIdentityLayer = std::find(identityLayers.begin(), identityLayers.end(), layer) != identityLayers.end();
+    int teacher = -1;
+
+    if (isIdentityLayer && layer->getType() == LayerType::Dense && newIndex < inputSize) {
+        // Deepened layer: pass the matching input straight through
+        std::vector<float> weights(inputSize, 0.0f);
+        weights[newIndex] = 1.0f;
+        neuron->setWeights(weights);
+        neuron->setBias(0.0f);
+    }
+    else if (next >= 0 && neuronList.size() > 1) {
+        // Net2WiderNet: copy a random existing neuron, small noise breaks the symmetry
+        teacher = random.uniformInt(static_cast<int>(neuronList.size()) - 1);
+        if (teacher >= static_cast<int>(newIndex)) teacher++;
+        std::vector<float> weights = neuronList[teacher]->getWeights();
+        std::vector<float> noise(weights.size());
+        random.fillNormal(noise.data(), noise.size(), 0.0f, 1e-3f);
+        for (size_t i = 0; i < weights.size(); ++i) {
+            weights[i] += noise[i];
+        }
+        neuron->setWeights(weights);
+        neuron->setBias(neuronList[teacher]->getBias());
+    }
+    else {
+        // No teacher available (or new output class): fresh He initialization
+        neuron->initializeWeights(static_cast<int>(inputSize), random);
+    }
+
+    if (next >= 0) {
+        // Outgoing weights (one block per channel, pooling layers in between keep the channel order):
+        // split the teacher's block in half, or start at zero so the output is unchanged
+        size_t block = channelBlock(next);
+        for (Neuron* nextNeuron : layerList[next]->getNeuronList()) {
+            std::vector<float> weights = nextNeuron->getWeights();
+            std::vector<float> newBlock(block, 0.0f);
+            if (teacher >= 0) {
+                for (size_t k = 0; k < block; ++k) {
+                    weights[teacher * block + k] *= 0.5f;
+                    newBlock[k] = weights[teacher * block + k];
                 }
             }
-            else {
-                for (int j = 0; j < input.second.size(); ++j) {
-                    float x = input.second[j];
-                    float dw = gradient * x;
-                    float w = neuron->getWeights()[j];
-                    float updatedW = w - learning_rate * dw;
-                    neuron->updateWeights(j, updatedW);
+            weights.insert(weights.begin() + std::min(newIndex * block, weights.size()), newBlock.begin(), newBlock.end());
+            nextNeuron->setWeights(weights);
+        }
+    }
+}
+
+// Called before a neuron is deleted: removes its channel from the next dense/conv layer
+void Network::onNeuronRemoved(Layer* layer, size_t index) {
+    syncLayers();
+    int l = indexOf(layer);
+    if (l < 0 || !hasParameters(layer->getType())) return;
+    edited = true;
+
+    int next = nextParametricLayer(l);
+    if (next >= 0) {
+        size_t block = channelBlock(next);
+        for (Neuron* nextNeuron : layerList[next]->getNeuronList()) {
+            std::vector<float> weights = nextNeuron->getWeights();
+            if ((index + 1) * block <= weights.size()) {
+                weights.erase(weights.begin() + index * block, weights.begin() + (index + 1) * block);
+            }
+            nextNeuron->setWeights(weights);
+        }
+    }
+}
+
+// Called after the GUI appended a new (still empty) layer. Dense neurons start as an identity
+// mapping of the previous layer, the old output layer becomes a ReLU hidden layer. The ReLU clamps its negative
+// logits, so the deeper network starts close to the trained one rather than computing the same function; the
+// fine-tune after the edit recovers the difference.
+void Network::onLayerAdded(Layer* layer) {
+    syncLayers();
+    identityLayers.push_back(layer);
+    edited = true;
+}
+
+// Called before a layer is deleted. A dense layer followed by a dense layer is absorbed by composing
+// the two linear maps (W' = W_next * W, b' = W_next * b + b_next), which keeps the network close to its
+// trained state. Layers whose input shape changes otherwise are reinitialized.
+void Network::onLayerRemoved(Layer* layer) {
+    syncLayers();
+    int l = indexOf(layer);
+    if (l < 0) return;
+    edited = true;
+
+    bool composable = layer->getType() == LayerType::Dense && l + 1 < static_cast<int>(layerList.size())
+        && layerList[l + 1]->getType() == LayerType::Dense;
+    if (composable) {
+        size_t inputSize = fanIn(l);
+        auto& removedNeurons = layer->getNeuronList();
+        for (Neuron* nextNeuron : layerList[l + 1]->getNeuronList()) {
+            if (removedNeurons.empty()) {
+                nextNeuron->initializeWeights(static_cast<int>(inputSize), random);
+                continue;
+            }
+            const std::vector<float> nextWeights = nextNeuron->getWeights();
+            std::vector<float> composed(inputSize, 0.0f);
+            float bias = nextNeuron->getBias();
+            for (size_t i = 0; i < removedNeurons.size() && i < nextWeights.size(); ++i) {
+                const std::vector<float>& weights = removedNeurons[i]->getWeights();
+                for (size_t j = 0; j < inputSize && j < weights.size(); ++j) {
+                    composed[j] += nextWeights[i] * weights[j];
                 }
+                bias += nextWeights[i] * removedNeurons[i]->getBias();
             }
-            float db = gradient;
-            float b = neuron->getBias();
-            float updatedB = b - learning_rate * db;
-            neuron->setBias(updatedB);
+            nextNeuron->setWeights(composed);
+            nextNeuron->setBias(bias);
         }
     }
+
+    layerList.erase(layerList.begin() + l);
+    identityLayers.erase(std::remove(identityLayers.begin(), identityLayers.end(), layer), identityLayers.end());
+    repairWeights();
 }
 
-int Network::getEpoch() {
-    return epochs;
+// Flattens the network into the layout described in Checkpoint.h
+Checkpoint Network::getCheckpoint() {
+    Checkpoint checkpoint;
+    checkpoint.input = inputShape;
+    checkpoint.sizes.push_back(inputShape.size());
+    for (Layer* layer : layerList) {
+        checkpoint.types.push_back(static_cast<int>(layer->getType()));
+        checkpoint.activations.push_back(static_cast<int>(layer->getActivation()));
+        checkpoint.sizes.push_back(layer->getNeuronCount());
+        if (!hasParameters(layer->getType())) continue;
+        for (Neuron* neuron : layer->getNeuronList()) {
+            const std::vector<float>& weights = neuron->getWeights();
+            checkpoint.params.insert(checkpoint.params.end(), weights.begin(), weights.end());
+            checkpoint.params.push_back(neuron->getBias());
+        }
+    }
+    return checkpoint;
+}
+
+bool Network::setCheckpoint(const Checkpoint& checkpoint) {
+    computeShapes();
+    if (checkpoint.sizes.size() != layerList.size() + 1 || checkpoint.input != inputShape || checkpoint.params.size() != checkpoint.expectedParamCount()) {
+        std::cerr << "Checkpoint does not match the network topology" << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < layerList.size(); ++i) {
+        LayerType type = (i < checkpoint.types.size()) ? static_cast<LayerType>(checkpoint.types[i]) : LayerType::Dense;
+        if (checkpoint.sizes[i + 1] != layerList[i]->getNeuronCount() || type != layerList[i]->getType()) {
+            std::cerr << "Checkpoint does not match the network topology at layer " << i << std::endl;
+            return false;
+        }
+    }
+    const float* params = checkpoint.params.data();
+    for (size_t i = 0; i < layerList.size(); ++i) {
+        // The activation belongs to the trained model, not to the topology, so it is taken over
+        layerList[i]->setActivation(i < checkpoint.activations.size() ? static_cast<Activation>(checkpoint.activations[i]) : Activation::ReLU);
+        if (!hasParameters(layerList[i]->getType())) continue;
+        size_t inputSize = fanIn(i);
+        for (Neuron* neuron : layerList[i]->getNeuronList()) {
+            neuron->setWeights(std::vector<float>(params, params + inputSize));
+            neuron->setBias(params[inputSize]);
+            params += inputSize + 1;
+        }
+    }
+    weightsVersion++;
+    return true;
+}
+
+// Snapshots are only built when the weights changed, readers keep theirs until they load the next one
+bool Network::publishSnapshot() {
+    std::uint64_t version = weightsVersion;
+    if (published && version == publishedVersion) return false;
+    if (!isReady()) return false;
+    TraceScope trace("Publish snapshot", "training");
+    std::atomic_store(&published, std::shared_ptr<const WeightSnapshot>(std::make_shared<WeightSnapshot>(getCheckpoint(), version)));
+    publishedVersion = version;
+    return true;
+}
+
+std::shared_ptr<const WeightSnapshot> Network::snapshot() const {
+    return std::atomic_load(&published);
+}
+
+void Network::weightsChanged() {
+    weightsVersion++;
+}
+
+// Dense neurons show their output, convolution filters the mean of their feature map and pooling neurons the mean of the layer
+void Network::showActivity(const Workspace& work) {
+    if (work.activations.size() != layerList.size() + 1) return;
+    for (size_t l = 0; l < layerList.size(); ++l) {
+        auto& neuronList = layerList[l]->getNeuronList();
+        const std::vector<float>& out = work.activations[l + 1];
+        if (neuronList.empty() || out.empty()) continue;
+        if (layerList[l]->getType() == LayerType::Dense) {
+            for (size_t j = 0; j < neuronList.size() && j < out.size(); ++j) neuronList[j]->setOutput(out[j]);
+        }
+        else if (layerList[l]->getType() == LayerType::Conv2D) {
+            size_t pixels = out.size() / neuronList.size();
+            for (size_t o = 0; o < neuronList.size(); ++o) {
+                float sum = 0.f;
+                for (size_t p = 0; p < pixels; ++p) sum += out[o * pixels + p];
+                neuronList[o]->setOutput(sum / pixels);
+            }
+        }
+        else {
+            float sum = 0.f;
+            for (float value : out) sum += value;
+            for (Neuron* neuron : neuronList) neuron->setOutput(sum / out.size());
+        }
+    }
+}
+
+// Writes the current topology as a header with compile-time layer sizes plus the checkpoint to load into it.
+// Rebuild afterwards and run with --bench to compare StaticNetwork against this runtime Network.
+bool Network::exportSpecializedHeader(const std::string& headerPath, const std::string& checkpointPath) {
+    if (!isReady()) {
+        std::cerr << "Cannot export, each layer must have at least one neuron" << std::endl;
+        return false;
+    }
+    for (Layer* layer : layerList) {
+        if (layer->getType() != LayerType::Dense) {
+            std::cerr << "Cannot export, only dense topologies can be specialized" << std::endl;
+            return false;
+        }
+        if (layer != layerList.back() && layer->getActivation() != Activation::ReLU) {
+            std::cerr << "Cannot export, StaticNetwork only supports ReLU hidden layers" << std::endl;
+            return false;
+        }
+    }
+    Checkpoint checkpoint = getCheckpoint();
+    if (!saveCheckpoint(checkpointPath, checkpoint)) return false;
+
+    std::ofstream file(headerPath);
+    if (!file) {
+        std::cerr << "Error writing " << headerPath << std::endl;
+        return false;
+    }
+    std::string sizes;
+    for (size_t i = 0; i < checkpoint.sizes.size(); ++i) {
+        sizes += (i ? ", " : "") + std::to_string(checkpoint.sizes[i]);
+    }
+    file << "#pragma once\n"
+        << "// Generated by Network::exportSpecializedHeader, do not edit.\n"
+        << "#include \"StaticNetwork.h\"\n\n"
+        << "constexpr int EXPORTED_LAYER_COUNT = " << layerList.size() << ";\n"
+        << "constexpr int EXPORTED_SIZES[] = { " << sizes << " };\n"
+        << "constexpr const char* EXPORTED_CHECKPOINT = " << stringLiteral(checkpointPath) << ";\n"
+        << "typedef StaticNetwork<" << sizes << "> ExportedNetwork;\n";
+    std::cout << "Exported " << headerPath << " (" << sizes << ") and " << checkpointPath << std::endl;
+    return static_cast<bool>(file);
+}
+
+bool Network::isReady() {
+    if (layerList.empty() || layerList.back()->getType() != LayerType::Dense) return false;
+    for (Layer* layer : layerList) {
+        if (layer->getNeuronList().empty()) return false;
+    }
+    for (const Shape& shape : inputShapes) {
+        if (shape.size() == 0) return false; // e.g. pooling after a dense layer
+    }
+    return true;
+}
+
+bool Network::wasEdited() const {
+    return edited;
+}
+
+void Network::clearEdited() {
+    edited = false;
+    identityLayers.clear();
 }
 
 // Computes cross-entropy loss for softmax
 float Network::computeLoss(int trueLabel, const std::vector<float>& prediction) {
     if (trueLabel < 0 || trueLabel >= static_cast<int>(prediction.size())) return 0.f;
-    return -std::log(std::max(1e-6f, prediction[trueLabel]));
+    return std::min(-fastLog(prediction[trueLabel]), MAX_SAMPLE_LOSS); // NaN stays NaN, a diverged network must not look converged
 }
 
 // Returns index of highest activation (argmax), i.e., predicted class
@@ -2,26 +2,131 @@
 #include "Input.h"
 #include "GUI.h"
 #include "Layer.h"
-#include <random>
+#include "Checkpoint.h"
+#include "Shape.h"
+#include "Random.h"
+#include "Snapshot.h"
+#include <atomic>
+#include <memory>
+
+// Layers with at least this many weights are initialized on their own thread
+const size_t PARALLEL_INIT_WEIGHTS = 1 << 18;
+
+// Activity of one dense layer in backward passes, summed over samples (Network::takeActivity)
+struct BackwardActivity
+{
+	size_t activeUnits = 0; // Neurons with a nonzero delta
+	size_t units = 0;
+	size_t activeInputs = 0; // Nonzero inputs
+	size_t inputs = 0;
+	size_t sparsePasses = 0; // Passes that visited only the nonzero inputs
+	size_t passes = 0;
+};
+
+// Buffers of one sample's forward and backward pass. Network::forwardPass/backPropagation use their own,
+// pipeline stages keep one per micro-batch slot so several samples can be in flight at once.
+struct Workspace
+{
+	std::vector<std::vector<float>> activations; // activations[l] is the input of layer l, the last one is the network output
+	std::vector<std::vector<float>> preActivations; // z of every layer from the last forward pass
+	std::vector<std::vector<float>> deltas; // dL/dz of every layer during backpropagation
+	std::vector<std::vector<float>> columns; // im2col matrices of convolution layers
+	std::vector<std::vector<int>> poolIndices; // Positions of the maxima of max pooling layers
+	std::vector<float> filters; // Packed (filters x weights) matrix of the current convolution layer
+	std::vector<float> filterGrads; // Weight gradients of the current convolution layer
+	std::vector<float> inputError; // dL/d(input) of the current layer
+	std::vector<int> activeInputs; // Indices of the nonzero inputs of the current dense layer (sparse path)
+	std::vector<int> activeUnits; // Neurons of the current dense layer with a nonzero delta (backward pass)
+	bool sparseInputs = false; // The backward pass of the current dense layer visits only activeInputs
+	std::vector<BackwardActivity> activity; // Per layer, summed until Network::takeActivity
+};
 
 // Represents a feedforward neural network connected to the GUI layer structure.
 // This class handles weight initialization, forward pass, backpropagation, and prediction.
+// Layers can be dense, 3x3 convolutions (one filter per neuron) or 2x2 pooling; the last layer is a dense softmax.
+// Hidden dense/conv layers use their own activation (Layer::getActivation, ReLU by default).
 class Network
 {
 private:
 	std::vector<Layer*> layerList; // Layer pointers representing the neural network structure
 	float learning_rate; // Learning rate for gradient descent
 	int epochs; // Number of training epochs
-	GUI* window; // Reference to the GUI for layer information
+	GUI* window; // Reference to the GUI for layer information (nullptr for headless networks)
+	bool ownsLayers = false; // True if the layers were created by the network itself
 	std::vector<float> output; // Output from the last forward pass
+	std::vector<Layer*> identityLayers; // Layers appended since the last training run, their neurons start as identity mappings
+	bool edited = false; // True if the topology changed since the last training run
+	RandomStream random; // Used for Net2Net teacher choice and symmetry-breaking noise
 
-public: 
-	Network(float learning_rate, int epochs, GUI* window); // Constructor
+	Shape inputShape; // Shape of one input sample (from the dataset)
+	std::vector<Shape> inputShapes; // Input shape of every layer, inputShapes.back() is the output shape
+	Workspace work; // Buffers of forwardPass and backPropagation
+	std::vector<std::vector<float>> gradients; // Per-layer gradients of backPropagation, zero between steps
+	std::vector<std::vector<int>> gradientRows; // Dense layers: neurons with nonzero gradients in the current step
+	std::atomic<std::uint64_t> weightsVersion{ 0 }; // Incremented by every change of the weights or the topology
+	std::uint64_t publishedVersion = 0; // weightsVersion of the published snapshot
+	std::shared_ptr<const WeightSnapshot> published; // Latest snapshot, accessed only with std::atomic_load/store
+
+	void createLayers(const std::vector<int>& layerSizes, const std::vector<LayerType>& layerTypes, const std::vector<Activation>& activations); // Layers of a headless network
+	int indexOf(Layer* layer); // Position of a layer in the network, -1 if not found
+	size_t fanIn(int layerIndex); // Number of incoming weights of one neuron in the given layer
+	static size_t minChunk(size_t workPerItem); // Items per parallel chunk so each chunk does at least kernelTuning().parallelMinWork
+	int nextParametricLayer(int layerIndex); // First dense/conv layer after the given one, -1 if none
+	int channelBlock(int layerIndex); // Weights per input channel of a dense/conv layer
+	void computeShapes(); // Recompute inputShapes from the layer types and neuron counts
+	void repairWeights(); // Reinitialize layers whose input shape changed after an edit
+	void packFilters(int layerIndex, Workspace& work); // Copy a convolution layer's filters into work.filters
+	void convForward(int layerIndex, Workspace& work);
+	void poolForward(int layerIndex, Workspace& work);
+	void propagateError(int layerIndex, Workspace& work, std::vector<float>& inputError); // dL/d(input) of a layer from its deltas
+	void passError(int layerIndex, Workspace& work); // Deltas of the previous layer (propagateError + activation derivative)
+	void gatherActive(int layerIndex, const std::vector<float>& layerInput, Workspace& work); // activeUnits/activeInputs of a dense layer's backward pass
+
+public:
+	Network(float learning_rate, int epochs, GUI* window, const Shape& input = DEFAULT_INPUT_SHAPE); // Constructor
+	Network(const std::vector<int>& layerSizes, float learning_rate, int epochs, const std::vector<LayerType>& layerTypes = {},
+		const std::vector<Activation>& activations = {}, const Shape& input = DEFAULT_INPUT_SHAPE); // Headless network without GUI (missing types are Dense, activations ReLU)
+	Network(const Checkpoint& checkpoint, float learning_rate, int epochs); // Headless network loaded from a checkpoint
+	~Network();
 	std::vector<float> forwardPass(const std::pair<int, std::vector<float>>& input); // Performs forward propagation through all layers
-	void backPropagation(std::pair<int, std::vector<float>> input); // Performs backpropagation using cross-entropy + softmax loss
+	float backPropagation(std::pair<int, std::vector<float>> input); // Performs backpropagation using cross-entropy + softmax loss, returns the loss
 	void initializeWeights(); // Randomly initializes weights of neurons based on layer structure
+
+	// Layer-wise passes for pipeline-parallel training (Pipeline.h), each sample in flight has its own workspace
+	void prepareWorkspace(Workspace& work, const std::vector<float>& input); // Size the buffers and store the input
+	void forwardLayer(int layerIndex, Workspace& work); // Output of one layer from work.activations[layerIndex]
+	float outputError(int trueLabel, Workspace& work); // Deltas of the output layer after the forward pass, returns the loss (fused softmax + cross-entropy)
+	void backwardLayer(int layerIndex, Workspace& work, std::vector<float>& gradients); // Accumulate a layer's gradients, pass its error down
+	// SGD step with accumulated gradients, clears them; rows limits the step to those neurons (the others must have zero gradients)
+	void applyGradients(int layerIndex, std::vector<float>& gradients, float scale, const std::vector<int>* rows = nullptr);
+	size_t layerWork(int layerIndex); // Forward multiply-adds of one layer per sample
+	size_t gradientSize(int layerIndex); // Floats backwardLayer accumulates for a layer (0 for pooling)
+	std::vector<BackwardActivity> takeActivity(); // Activity of backPropagation since the last call, then reset
+	static void reportActivity(const std::vector<BackwardActivity>& activity); // Active fractions per dense layer, printed and traced as counters
+	int getLayerCount();
+	const Shape& getInputShape() const;
 	int getEpoch(); // Get training epoch count
-	float computeLoss(int trueLabel, const std::vector<float>& prediction); // Computes cross-entropy loss for classification
+	void setEpoch(int value); // Set training epoch count (e.g. shorter fine-tune after edits)
+
+	// Incremental topology edits on a live network (Net2Net-style, trained weights are kept)
+	void syncLayers(); // Refresh layer pointers from the GUI
+	void onNeuronAdded(Layer* layer, Neuron* neuron); // Widen a layer, function-preserving where possible
+	void onNeuronRemoved(Layer* layer, size_t index); // Drop a neuron's outgoing connections
+	void onLayerAdded(Layer* layer); // Deepen the network with an identity-initialized layer (not function-preserving, see Network.cpp)
+	void onLayerRemoved(Layer* layer); // Fold a removed layer into the next one
+	bool isReady(); // True if every layer has neurons and a valid shape, and the last layer is dense
+	bool wasEdited() const; // True if the topology changed since the last training run
+	void clearEdited(); // Reset the edit flag when training starts, appended layers become ordinary trained layers
+	static float computeLoss(int trueLabel, const std::vector<float>& prediction); // Computes cross-entropy loss for classification
 	int predict(std::vector<float>& out); // Returns predicted class index based on output vectors
-};
 
+	Checkpoint getCheckpoint(); // Copy of all weights and biases
+	bool setCheckpoint(const Checkpoint& checkpoint); // Load weights, the topology must match
+
+	// Versioned weight snapshots for inference while training runs (Snapshot.h)
+	bool publishSnapshot(); // Called by the trainer's thread: publish the current weights if they changed, false if nothing was published
+	std::shared_ptr<const WeightSnapshot> snapshot() const; // Latest published snapshot from any thread, nullptr before the first one
+	void weightsChanged(); // Outside change that affects inference (e.g. a layer's activation), picked up by the next publishSnapshot
+	void showActivity(const Workspace& work); // Neuron outputs shown by the visualizer, from a snapshot's forward pass
+	bool exportSpecializedHeader(const std::string& headerPath, const std::string& checkpointPath); // Write StaticNetwork header + checkpoint
+};
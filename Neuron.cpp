@@ -1,4 +1,5 @@
 #include "Neuron.h"
+#include <cmath>
 Neuron::Neuron(): bias(0.0f), output(0.0f), gradient(0.0f) {
 	
     // Initialize the visual appearance of the neuron
@@ -9,18 +10,18 @@ Neuron::Neuron(): bias(0.0f), output(0.0f), gradient(0.0f) {
 	shape.setOutlineThickness(0.f); // Outline shown when active
 }
 sf::FloatRect Neuron::getBounds() {
-	return shape.getGlobalBounds(); // Return clickable bounds
+	// Return clickable bounds (the circle, without the selection outline)
+	float diameter = 2.f * shape.getRadius();
+	return sf::FloatRect(shape.getPosition() - shape.getOrigin(), sf::Vector2f(diameter, diameter));
 }
 float Neuron::getRadius() {
     return shape.getRadius();
 }
-bool Neuron::isSelected(sf::Event& event, GUI& window) {
+bool Neuron::isSelected(sf::Event& event, bool underMouse) {
 
     // Handle mouse interaction to toggle selection
     if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left && !wasPressed) {
-        sf::Vector2i mouse_pos = sf::Mouse::getPosition(window);
-        sf::Vector2f mouse_world = window.mapPixelToCoords(mouse_pos);
-        if (this->getBounds().contains(mouse_world)) {
+        if (underMouse) {
             isActive = !isActive;
             wasPressed = true;
             if (isActive) {
@@ -36,6 +37,7 @@ bool Neuron::isSelected(sf::Event& event, GUI& window) {
     if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Left) {
         wasPressed = false;
     }
+    return false;
 }
 void Neuron::setPosition(float x, float y) {
     // Place the neuron shape (circle) on the screen
@@ -43,9 +45,37 @@ void Neuron::setPosition(float x, float y) {
     float yPos = y + shape.getRadius();
     shape.setPosition(x, y);
 }
-void Neuron::draw(sf::RenderWindow& window) {
+void Neuron::draw(GUI& window) {
     window.draw(shape); // Render neuron to the screen
 }
+
+void Neuron::appendVertices(sf::VertexArray& triangles) const {
+    // Same points as sf::CircleShape (starting at the top), the outline grows outwards like its outline
+    const float pi = 3.14159265f;
+    sf::Vector2f center = shape.getPosition(); // The origin is the center of the circle
+    float radius = shape.getRadius();
+    float outline = shape.getOutlineThickness();
+    size_t points = shape.getPointCount();
+    for (size_t i = 0; i < points; ++i) {
+        float angle0 = i * 2.f * pi / points - pi / 2.f;
+        float angle1 = (i + 1) * 2.f * pi / points - pi / 2.f;
+        sf::Vector2f dir0(std::cos(angle0), std::sin(angle0));
+        sf::Vector2f dir1(std::cos(angle1), std::sin(angle1));
+        triangles.append(sf::Vertex(center, shape.getFillColor()));
+        triangles.append(sf::Vertex(center + dir0 * radius, shape.getFillColor()));
+        triangles.append(sf::Vertex(center + dir1 * radius, shape.getFillColor()));
+        if (outline > 0.f) {
+            sf::Vector2f inner0 = center + dir0 * radius, inner1 = center + dir1 * radius;
+            sf::Vector2f outer0 = center + dir0 * (radius + outline), outer1 = center + dir1 * (radius + outline);
+            triangles.append(sf::Vertex(inner0, shape.getOutlineColor()));
+            triangles.append(sf::Vertex(outer0, shape.getOutlineColor()));
+            triangles.append(sf::Vertex(outer1, shape.getOutlineColor()));
+            triangles.append(sf::Vertex(inner0, shape.getOutlineColor()));
+            triangles.append(sf::Vertex(outer1, shape.getOutlineColor()));
+            triangles.append(sf::Vertex(inner1, shape.getOutlineColor()));
+        }
+    }
+}
 bool Neuron::checkActive() {
     return isActive;
 }
@@ -58,21 +88,21 @@ void Neuron::setActive(bool value) {
     shape.setOutlineThickness(value ? 5.f : 0.f); // Toggle outline
 }
 
-float Neuron::activationFunc(float input) {
-    // ReLU activation function
-    return std::max(0.0f, input);
+float Neuron::activationFunc(float input, Activation activation) {
+    float output;
+    activate(activation, &input, &output, 1);
+    return output;
 }
 
 void Neuron::initializeWeights(int inputSize) {
+    initializeWeights(inputSize, threadRandom());
+}
+
+void Neuron::initializeWeights(int inputSize, RandomStream& random) {
     // He initialization for ReLU networks
-    std::default_random_engine generator(std::random_device{}());
     float stddev = std::sqrt(2.0f / static_cast<float>(inputSize));
-    std::normal_distribution<float> distribution(0.0f, stddev);
-
     weights.resize(inputSize);
-    for (size_t i = 0; i < inputSize; ++i) {
-        weights[i] = distribution(generator); // Random weight per input
-    }
+    random.fillNormal(weights.data(), weights.size(), 0.0f, stddev); // Whole weight row at once
 
     bias = 0.0f;
 }
@@ -106,6 +136,20 @@ void Neuron::updateWeights(int i, float newVal) {
     weights[i] = newVal;
 }
 
+void Neuron::setWeights(const std::vector<float>& newWeights) {
+    weights = newWeights;
+}
+
+void Neuron::applyGradient(const float* gradient, float step) {
+    // One pass over contiguous arrays, vectorized by the compiler
+    float* w = weights.data();
+    size_t count = weights.size();
+    for (size_t j = 0; j < count; ++j) {
+        w[j] -= step * gradient[j];
+    }
+    bias -= step * gradient[count];
+}
+
 float Neuron::getOutput() {
     return output;
 }
@@ -114,7 +158,7 @@ void Neuron::setGradient(float f) {
     gradient = f;
 }
 
-std::vector<float> Neuron::getWeights() {
+const std::vector<float>& Neuron::getWeights() const {
     return weights;
 }
 
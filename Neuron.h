@@ -2,7 +2,8 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
 #include "GUI.h"
-#include <random>
+#include "Random.h"
+#include "Activation.h"
 class GUI;
 class Layer;
 
@@ -28,23 +29,27 @@ public:
 	float getRadius();
 	sf::Vector2f getPosition();
 	bool checkActive();
-	bool isSelected(sf::Event& event, GUI& window);
+	bool isSelected(sf::Event& event, bool underMouse); // Toggle selection on a click, underMouse from GUI::hitTest
 	void setPosition(float x, float y);
-	void draw(sf::RenderWindow& window);
+	void draw(GUI& window);
+	void appendVertices(sf::VertexArray& triangles) const; // Circle and selection outline as triangles, for drawing a whole layer at once
 	void setActive(bool value);
 
 
-	float activationFunc(float input); // ReLU
-	void initializeWeights(int inputSize); // Random init using He initialization
+	float activationFunc(float input, Activation activation = Activation::ReLU); // Hidden-layer activation of one value
+	void initializeWeights(int inputSize); // Random init using He initialization (thread's random stream)
+	void initializeWeights(int inputSize, RandomStream& random); // He initialization from the given stream
 	float run(const std::vector<float>& inputs, bool useReLU); // Forward computation
 	
 	// Accessors / Mutators
 	float getBias() const;
 	void setBias(float b);
 	void updateWeights(int i, float newVal);
+	void setWeights(const std::vector<float>& newWeights); // Replace all incoming weights
+	void applyGradient(const float* gradient, float step); // Gradient descent on the weights (gradient[0..n)) and the bias (gradient[n])
 	float getOutput();
 	void setGradient(float f);
-	std::vector<float> getWeights();
+	const std::vector<float>& getWeights() const;
 	float getGradient();
 	void setActivationPreReLU(float value);
 	float getActivationPreReLU() const;
@@ -0,0 +1,135 @@
+#include "OnlineTuning.h"
+#include "Network.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// The OS schedules the UI and the training threads first; the worker only uses otherwise idle time
+static void lowerThreadPriority() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__linux__)
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10); // Linux threads have their own nice value
+#endif
+}
+
+OnlineTuner::OnlineTuner(const std::string& replayPath, float learningRate)
+    : replayPath(replayPath), learningRate(learningRate), random(0, 0) {}
+
+OnlineTuner::~OnlineTuner() {
+    cancel();
+}
+
+void OnlineTuner::setReplayPath(const std::string& path) {
+    cancel(); // The worker reads the replay set without the mutex
+    replayPath = path;
+    replaySet.clear();
+}
+
+void OnlineTuner::addCorrection(const Checkpoint& current, const std::vector<float>& input, int label) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (corrections.size() < ONLINE_REPLAY_CAPACITY) {
+        newest = corrections.size();
+        corrections.push_back({ label, input });
+    }
+    else {
+        newest = (newest + 1) % ONLINE_REPLAY_CAPACITY;
+        corrections[newest] = { label, input };
+    }
+    pendingSteps += ONLINE_STEPS;
+    if (running) return; // The running job picks up the new steps
+    if (worker.joinable()) worker.join(); // Finished job, it no longer needs the mutex
+    running = true;
+    stopping = false;
+    random = threadRandom().split();
+    worker = std::thread(&OnlineTuner::run, this, current);
+}
+
+void OnlineTuner::makeBatch(std::vector<std::pair<int, std::vector<float>>>& batch) {
+    batch.clear();
+    batch.push_back(corrections[newest]);
+    size_t userSamples = replaySet.empty() ? ONLINE_BATCH : ONLINE_USER_SAMPLES;
+    while (batch.size() < std::min(userSamples, corrections.size())) {
+        batch.push_back(corrections[random.uniformInt(static_cast<int>(corrections.size()))]);
+    }
+    std::pair<int, std::vector<float>> sample;
+    while (!replaySet.empty() && batch.size() < ONLINE_BATCH) {
+        replaySet.sample(random.uniformInt(static_cast<int>(replaySet.size())), sample);
+        batch.push_back(sample);
+    }
+}
+
+void OnlineTuner::run(Checkpoint start) {
+    lowerThreadPriority();
+    setTraceThreadName("Online tuning");
+    if (replaySet.empty() && !replayPath.empty()) {
+        TraceScope trace("Load replay data", "io");
+        replaySet.loadCsv(replayPath, static_cast<size_t>(start.sizes.front()));
+    }
+    Network network(start, learningRate, 1);
+    int layerCount = network.getLayerCount();
+    std::vector<std::vector<float>> gradients(layerCount);
+    std::vector<std::pair<int, std::vector<float>>> batch;
+    Workspace work;
+    for (;;) {
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping || pendingSteps == 0) {
+                running = false;
+                return;
+            }
+            pendingSteps--;
+            last = pendingSteps == 0;
+            makeBatch(batch);
+        }
+        {
+            TraceScope trace("Online step", "training");
+            for (const auto& sample : batch) {
+                network.prepareWorkspace(work, sample.second);
+                for (int l = 0; l < layerCount; ++l) network.forwardLayer(l, work);
+                network.outputError(sample.first, work);
+                for (int l = layerCount - 1; l >= 0; --l) network.backwardLayer(l, work, gradients[l]);
+            }
+            for (int l = 0; l < layerCount; ++l) network.applyGradients(l, gradients[l], 1.0f);
+        }
+        // Published whenever the queue runs dry; corrections that arrive meanwhile continue from these weights
+        if (last) std::atomic_store(&published, std::make_shared<const Checkpoint>(network.getCheckpoint()));
+    }
+}
+
+bool OnlineTuner::takeUpdate(Checkpoint& weights) {
+    std::shared_ptr<const Checkpoint> update = std::atomic_exchange(&published, std::shared_ptr<const Checkpoint>());
+    if (!update) return false;
+    weights = *update;
+    return true;
+}
+
+void OnlineTuner::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        pendingSteps = 0;
+    }
+    if (worker.joinable()) worker.join();
+    std::atomic_store(&published, std::shared_ptr<const Checkpoint>());
+}
+
+bool OnlineTuner::isBusy() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return running;
+}
+
+size_t OnlineTuner::correctionCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return corrections.size();
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "Checkpoint.h"
+#include "Dataset.h"
+#include "Random.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+const size_t ONLINE_REPLAY_CAPACITY = 256; // Corrections kept, the oldest is replaced when full
+const int ONLINE_STEPS = 8; // Mini-batch steps per correction
+const size_t ONLINE_BATCH = 16; // Samples per step
+const size_t ONLINE_USER_SAMPLES = 4; // Corrections per step (the newest always), the rest is replayed training data
+
+// Online fine-tuning from digits drawn on the canvas and labelled by the user.
+// Every correction goes into a replay buffer and schedules a few mini-batch steps. A background thread with
+// lowered OS priority trains a headless copy of the network on batches that mix corrections with replayed
+// training samples (so the model adapts to new handwriting without forgetting the rest), then publishes the
+// weights by swapping a shared pointer atomically. The UI thread picks them up with takeUpdate() and never waits.
+class OnlineTuner
+{
+private:
+	std::string replayPath; // Training data replayed next to the corrections, loaded by the first job
+	float learningRate;
+	Dataset replaySet;
+	std::vector<std::pair<int, std::vector<float>>> corrections; // Replay buffer of user samples
+	size_t newest = 0; // Index of the latest correction
+	int pendingSteps = 0;
+	bool running = false; // Worker thread active
+	bool stopping = false;
+	std::mutex mutex; // Guards corrections, pendingSteps, running and stopping
+	std::thread worker;
+	RandomStream random; // Batch composition, reseeded from the caller's stream for every job
+	std::shared_ptr<const Checkpoint> published; // Latest weights, accessed only with std::atomic_load/store/exchange
+
+	void run(Checkpoint start); // Worker: take steps until none are pending
+	void makeBatch(std::vector<std::pair<int, std::vector<float>>>& batch); // Corrections and replayed samples, caller holds mutex
+
+public:
+	OnlineTuner(const std::string& replayPath, float learningRate);
+	~OnlineTuner();
+	OnlineTuner(const OnlineTuner&) = delete;
+	OnlineTuner& operator=(const OnlineTuner&) = delete;
+
+	void setReplayPath(const std::string& path); // Training data of another dataset (before the first correction)
+	// Store a labelled canvas sample and schedule steps; current is the live network, the starting point if no job is running
+	void addCorrection(const Checkpoint& current, const std::vector<float>& input, int label);
+	bool takeUpdate(Checkpoint& weights); // True if new weights were published since the last call
+	void cancel(); // Stop the job and drop unpublished results (training starts, the network is rebuilt)
+	bool isBusy();
+	size_t correctionCount();
+};
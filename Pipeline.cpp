@@ -0,0 +1,225 @@
+#include "Pipeline.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+BoundedQueue::BoundedQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {}
+
+void BoundedQueue::push(int item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return items.size() < capacity; });
+    items.push_back(item);
+    changed.notify_all();
+}
+
+int BoundedQueue::pop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return !items.empty(); });
+    int item = items.front();
+    items.pop_front();
+    changed.notify_all();
+    return item;
+}
+
+PipelineTrainer::PipelineTrainer(Network& network, int stages, int microBatches, int microBatchSize)
+    : network(network), stageCount(std::max(1, stages)), microBatches(std::max(1, microBatches)),
+      microBatchSize(std::max(1, microBatchSize)), busySeconds(stageCount, 0.0) {
+    // 1F1B keeps at most stageCount micro-batches in flight, which also bounds the queues and the workspaces
+    slots.resize(static_cast<size_t>(stageCount) * this->microBatchSize);
+    for (int s = 0; s < stageCount; ++s) {
+        forwardQueues.emplace_back(new BoundedQueue(stageCount));
+        backwardQueues.emplace_back(new BoundedQueue(stageCount));
+    }
+    for (int s = 0; s < stageCount; ++s) {
+        threads.emplace_back(&PipelineTrainer::stageLoop, this, s);
+    }
+}
+
+PipelineTrainer::~PipelineTrainer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    started.notify_all();
+    for (auto& thread : threads) thread.join();
+}
+
+size_t PipelineTrainer::batchSize() const {
+    return static_cast<size_t>(microBatches) * microBatchSize;
+}
+
+// Contiguous layer ranges with roughly equal multiply-adds. Stages may stay empty if there are fewer layers
+// than stages; they only pass micro-batches on.
+void PipelineTrainer::partition() {
+    int layerCount = network.getLayerCount();
+    std::vector<double> prefix(layerCount + 1, 0.0);
+    for (int l = 0; l < layerCount; ++l) {
+        prefix[l + 1] = prefix[l] + static_cast<double>(network.layerWork(l));
+    }
+    firstLayer.assign(stageCount + 1, layerCount);
+    firstLayer[0] = 0;
+    for (int s = 1; s < stageCount; ++s) {
+        double target = prefix[layerCount] * s / stageCount;
+        int lastAllowed = std::max(0, layerCount - (stageCount - s)); // Leave one layer for every later stage
+        int layer = std::min(layerCount, firstLayer[s - 1] + 1); // At least one layer per stage
+        // Move the boundary on while that brings the work before it closer to this stage's share
+        while (layer < lastAllowed && prefix[layer + 1] - target < target - prefix[layer]) {
+            ++layer;
+        }
+        firstLayer[s] = layer;
+    }
+    gradients.resize(layerCount);
+    partitionedLayers = layerCount; // The layers of every stage are listed by printReport
+}
+
+float PipelineTrainer::trainBatch(const DatasetView& samples, size_t begin, size_t end) {
+    end = std::min(end, samples.size());
+    if (begin >= end) return 0.f;
+    // Topology edits between batches change the layer count, the weights are already adapted by the network
+    if (partitionedLayers != network.getLayerCount()) partition();
+
+    auto batchStart = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batchSamples = &samples;
+        batchBegin = begin;
+        batchEnd = end;
+        batchMicroBatches = static_cast<int>((end - begin + microBatchSize - 1) / microBatchSize);
+        batchLoss = 0.f;
+        finishedStages = 0;
+        batchId++;
+    }
+    started.notify_all();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this]() { return finishedStages == stageCount; });
+    }
+    wallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+    batches++;
+    return batchLoss;
+}
+
+void PipelineTrainer::stageLoop(int stage) {
+    setTraceThreadName("Pipeline stage " + std::to_string(stage));
+    int seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            started.wait(lock, [this, seen]() { return stopping || batchId != seen; });
+            if (stopping) return;
+            seen = batchId;
+        }
+        runSchedule(stage);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finishedStages++;
+        }
+        finished.notify_all();
+    }
+}
+
+// 1F1B: stage s runs (stages - s - 1) warm-up forwards, then alternates one forward and one backward,
+// then drains the remaining backwards. The last stage turns every forward straight into a backward.
+void PipelineTrainer::runSchedule(int stage) {
+    int count = batchMicroBatches;
+    int warmup = std::min(stageCount - stage - 1, count);
+    int nextForward = 0, nextBackward = 0;
+    while (nextForward < warmup) forward(stage, nextForward++);
+    while (nextForward < count) {
+        forward(stage, nextForward++);
+        backward(stage, nextBackward++);
+    }
+    while (nextBackward < count) backward(stage, nextBackward++);
+
+    // Flush: this stage's layers are not read by any other stage, so each stage updates its own
+    auto start = std::chrono::steady_clock::now();
+    for (int l = firstLayer[stage]; l < firstLayer[stage + 1]; ++l) {
+        network.applyGradients(l, gradients[l], 1.0f);
+    }
+    busySeconds[stage] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+Workspace& PipelineTrainer::slot(int microBatch, int sample) {
+    return slots[static_cast<size_t>(microBatch % stageCount) * microBatchSize + sample];
+}
+
+void PipelineTrainer::forward(int stage, int microBatch) {
+    if (stage > 0) forwardQueues[stage]->pop(); // Micro-batches arrive in order
+    TraceScope trace("Micro-batch forward", "pipeline", microBatch);
+    auto start = std::chrono::steady_clock::now();
+    size_t first = batchBegin + static_cast<size_t>(microBatch) * microBatchSize;
+    size_t last = std::min(batchEnd, first + microBatchSize);
+    for (size_t i = first; i < last; ++i) {
+        Workspace& work = slot(microBatch, static_cast<int>(i - first));
+        if (stage == 0) {
+            stageInput.resize(batchSamples->inputSize());
+            batchSamples->input(i, stageInput.data());
+            network.prepareWorkspace(work, stageInput);
+        }
+        for (int l = firstLayer[stage]; l < firstLayer[stage + 1]; ++l) {
+            network.forwardLayer(l, work);
+        }
+        if (stage == stageCount - 1) {
+            int label = batchSamples->label(i);
+            batchLoss += network.outputError(label, work);
+        }
+    }
+    busySeconds[stage] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    trace.end();
+    if (stage < stageCount - 1) forwardQueues[stage + 1]->push(microBatch);
+}
+
+void PipelineTrainer::backward(int stage, int microBatch) {
+    if (stage < stageCount - 1) backwardQueues[stage]->pop();
+    TraceScope trace("Micro-batch backward", "pipeline", microBatch);
+    auto start = std::chrono::steady_clock::now();
+    size_t first = batchBegin + static_cast<size_t>(microBatch) * microBatchSize;
+    size_t last = std::min(batchEnd, first + microBatchSize);
+    for (size_t i = first; i < last; ++i) {
+        Workspace& work = slot(microBatch, static_cast<int>(i - first));
+        for (int l = firstLayer[stage + 1] - 1; l >= firstLayer[stage]; --l) {
+            network.backwardLayer(l, work, gradients[l]);
+        }
+    }
+    busySeconds[stage] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    trace.end();
+    if (stage > 0) backwardQueues[stage - 1]->push(microBatch);
+}
+
+std::vector<BackwardActivity> PipelineTrainer::takeActivity() {
+    std::vector<BackwardActivity> total;
+    for (Workspace& work : slots) {
+        total.resize(std::max(total.size(), work.activity.size()));
+        for (size_t l = 0; l < work.activity.size(); ++l) {
+            const BackwardActivity& layer = work.activity[l];
+            total[l].activeUnits += layer.activeUnits;
+            total[l].units += layer.units;
+            total[l].activeInputs += layer.activeInputs;
+            total[l].inputs += layer.inputs;
+            total[l].sparsePasses += layer.sparsePasses;
+            total[l].passes += layer.passes;
+        }
+        std::fill(work.activity.begin(), work.activity.end(), BackwardActivity());
+    }
+    return total;
+}
+
+void PipelineTrainer::printReport() const {
+    if (batches == 0 || wallSeconds <= 0.0) return;
+    double utilizationSum = 0.0;
+    std::cout << "Pipeline: " << stageCount << " stages, " << microBatches << " micro-batches of " << microBatchSize
+        << " samples, " << batches << " batches in " << wallSeconds << " s" << std::endl;
+    for (int s = 0; s < stageCount; ++s) {
+        double utilization = busySeconds[s] / wallSeconds;
+        utilizationSum += utilization;
+        std::cout << "  Stage " << s << " (layers " << firstLayer[s] << "-" << firstLayer[s + 1] - 1 << "): "
+            << std::fixed << std::setprecision(1) << utilization * 100.0 << "% busy" << std::defaultfloat << std::endl;
+    }
+    // Idle share of all stages; an ideal balanced 1F1B pipeline idles (S - 1) / (M + S - 1)
+    double bubble = 1.0 - utilizationSum / stageCount;
+    double ideal = static_cast<double>(stageCount - 1) / (microBatches + stageCount - 1);
+    std::cout << "  Bubble fraction " << std::fixed << std::setprecision(1) << bubble * 100.0 << "% (ideal "
+        << ideal * 100.0 << "%)" << std::defaultfloat << std::setprecision(6) << std::endl;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "Network.h"
+#include "Dataset.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Blocking FIFO of micro-batch indices between two pipeline stages
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t capacity);
+	void push(int item); // Waits while the queue is full
+	int pop(); // Waits while the queue is empty
+
+private:
+	size_t capacity;
+	std::deque<int> items;
+	std::mutex mutex;
+	std::condition_variable changed;
+};
+
+// Pipeline-parallel training: the layers are split into contiguous stages (balanced by multiply-adds),
+// each owned by its own thread. A batch is cut into micro-batches that flow forward and backward through the
+// stages over bounded queues in a 1F1B schedule; gradients are accumulated per layer and applied once at the
+// end of the batch (pipeline flush), so every micro-batch sees the same weights.
+class PipelineTrainer
+{
+public:
+	PipelineTrainer(Network& network, int stages, int microBatches, int microBatchSize);
+	~PipelineTrainer();
+	float trainBatch(const DatasetView& samples, size_t begin, size_t end); // One update, returns the summed loss
+	size_t batchSize() const; // Samples per full batch (microBatches * microBatchSize)
+	void printReport() const; // Bubble fraction and utilization of every stage since construction
+	std::vector<BackwardActivity> takeActivity(); // Backward activity of all micro-batch slots since the last call, then reset
+
+private:
+	Network& network;
+	int stageCount;
+	int microBatches;
+	int microBatchSize;
+	int partitionedLayers = -1; // Layer count the stage boundaries were computed for
+	std::vector<int> firstLayer; // Stage s owns layers [firstLayer[s], firstLayer[s + 1])
+	std::vector<std::vector<float>> gradients; // Accumulated gradients of every layer
+	std::vector<Workspace> slots; // One workspace per sample of the micro-batches in flight
+	std::vector<std::unique_ptr<BoundedQueue>> forwardQueues; // Input of stage s from stage s - 1
+	std::vector<std::unique_ptr<BoundedQueue>> backwardQueues; // Input of stage s from stage s + 1
+	std::vector<std::thread> threads;
+
+	// Current batch, written by trainBatch while the stages are idle
+	const DatasetView* batchSamples = nullptr;
+	size_t batchBegin = 0;
+	size_t batchEnd = 0;
+	int batchMicroBatches = 0;
+	float batchLoss = 0.f; // Written by the last stage only
+	std::vector<float> stageInput; // Decoded sample, used by the first stage only
+
+	std::mutex mutex;
+	std::condition_variable started;
+	std::condition_variable finished;
+	int batchId = 0;
+	int finishedStages = 0;
+	bool stopping = false;
+
+	std::vector<double> busySeconds; // Compute time of every stage, each written by its own thread
+	double wallSeconds = 0.0; // Time spent inside trainBatch
+	int batches = 0;
+
+	void partition(); // Balance contiguous layer ranges over the stages
+	void stageLoop(int stage);
+	void runSchedule(int stage);
+	void forward(int stage, int microBatch);
+	void backward(int stage, int microBatch);
+	Workspace& slot(int microBatch, int sample);
+};
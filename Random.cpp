@@ -0,0 +1,120 @@
+#include "Random.h"
+#include <atomic>
+#include <cmath>
+#include <random>
+
+// Philox4x32 constants (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+const std::uint32_t PHILOX_M0 = 0xD2511F53u;
+const std::uint32_t PHILOX_M1 = 0xCD9E8D57u;
+const std::uint32_t PHILOX_W0 = 0x9E3779B9u;
+const std::uint32_t PHILOX_W1 = 0xBB67AE85u;
+const int PHILOX_ROUNDS = 10;
+
+// Streams created by randomStream() live in the upper half of the id space, thread streams in the lower half
+const std::uint64_t FIXED_STREAM_BIT = 1ull << 63;
+
+static std::atomic<std::uint64_t> globalSeed(std::random_device{}() | (static_cast<std::uint64_t>(std::random_device{}()) << 32));
+static std::atomic<std::uint64_t> seedGeneration(0); // Bumped by setRandomSeed so thread streams restart
+static std::atomic<std::uint64_t> nextThreadStream(0);
+
+RandomStream::RandomStream(std::uint64_t seed, std::uint64_t stream) : stream(stream) {
+    key[0] = static_cast<std::uint32_t>(seed);
+    key[1] = static_cast<std::uint32_t>(seed >> 32);
+}
+
+void RandomStream::nextBlock(std::uint32_t out[4]) {
+    std::uint32_t counter[4] = {
+        static_cast<std::uint32_t>(block), static_cast<std::uint32_t>(block >> 32),
+        static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32)
+    };
+    std::uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < PHILOX_ROUNDS; ++round) {
+        std::uint64_t product0 = static_cast<std::uint64_t>(PHILOX_M0) * counter[0];
+        std::uint64_t product1 = static_cast<std::uint64_t>(PHILOX_M1) * counter[2];
+        std::uint32_t next[4] = {
+            static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ k0, static_cast<std::uint32_t>(product1),
+            static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ k1, static_cast<std::uint32_t>(product0)
+        };
+        for (int i = 0; i < 4; ++i) counter[i] = next[i];
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    for (int i = 0; i < 4; ++i) out[i] = counter[i];
+    block++;
+}
+
+RandomStream::result_type RandomStream::operator()() {
+    if (used == 4) {
+        nextBlock(buffer);
+        used = 0;
+    }
+    return buffer[used++];
+}
+
+float RandomStream::uniform() {
+    return ((*this)() >> 8) * (1.0f / 16777216.0f); // 24 random mantissa bits
+}
+
+int RandomStream::uniformInt(int count) {
+    return static_cast<int>((static_cast<std::uint64_t>((*this)()) * static_cast<std::uint64_t>(count)) >> 32);
+}
+
+float RandomStream::normal(float mean, float stddev) {
+    float value;
+    fillNormal(&value, 1, mean, stddev);
+    return value;
+}
+
+void RandomStream::fillNormal(float* out, size_t count, float mean, float stddev) {
+    // Box-Muller on whole Philox blocks: 4 random words give 4 normal samples.
+    // Words are generated first, then transformed in a separate loop without branches so it can vectorize.
+    const size_t CHUNK = 256;
+    std::uint32_t words[CHUNK];
+    const float twoPi = 6.28318530718f;
+    for (size_t start = 0; start < count; start += CHUNK) {
+        size_t n = (count - start < CHUNK) ? count - start : CHUNK;
+        size_t pairs = (n + 1) / 2;
+        for (size_t i = 0; i < 2 * pairs; i += 4) {
+            nextBlock(words + i); // Fills up to 3 words past 2 * pairs, CHUNK is a multiple of 4
+        }
+        for (size_t i = 0; i < pairs; ++i) {
+            float u1 = ((words[2 * i] >> 8) + 1) * (1.0f / 16777216.0f); // (0, 1], log is finite
+            float u2 = (words[2 * i + 1] >> 8) * (1.0f / 16777216.0f);
+            float radius = stddev * std::sqrt(-2.0f * std::log(u1));
+            float angle = twoPi * u2;
+            float first = mean + radius * std::cos(angle);
+            float second = mean + radius * std::sin(angle);
+            out[start + 2 * i] = first;
+            if (2 * i + 1 < n) out[start + 2 * i + 1] = second;
+        }
+    }
+}
+
+RandomStream RandomStream::split() {
+    std::uint64_t id = (static_cast<std::uint64_t>((*this)()) << 32) | (*this)();
+    return RandomStream(static_cast<std::uint64_t>(key[1]) << 32 | key[0], id | FIXED_STREAM_BIT);
+}
+
+void setRandomSeed(std::uint64_t seed) {
+    globalSeed = seed;
+    nextThreadStream = 0;
+    seedGeneration++;
+}
+
+std::uint64_t getRandomSeed() {
+    return globalSeed;
+}
+
+RandomStream& threadRandom() {
+    thread_local RandomStream random(0, 0);
+    thread_local std::uint64_t generation = ~0ull;
+    if (generation != seedGeneration) {
+        generation = seedGeneration;
+        random = RandomStream(globalSeed, nextThreadStream++);
+    }
+    return random;
+}
+
+RandomStream randomStream(std::uint64_t id) {
+    return RandomStream(globalSeed, id | FIXED_STREAM_BIT);
+}
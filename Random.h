@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Central random number service.
+// Every stream is a counter-based Philox4x32-10 generator keyed by the global seed: a stream id and a block
+// counter are encrypted into 4 random words, so streams are independent and need no shared state.
+// Weight initialization, Net2Net noise and data shuffling draw from here; the same seed gives bit-identical runs.
+
+class RandomStream
+{
+private:
+	std::uint32_t key[2]; // Seed
+	std::uint64_t stream; // Stream id, upper half of the counter
+	std::uint64_t block = 0; // Block index, lower half of the counter
+	std::uint32_t buffer[4]; // Words of the current block
+	int used = 4; // Words of buffer already returned
+
+	void nextBlock(std::uint32_t out[4]); // Encrypt the next counter value
+
+public:
+	typedef std::uint32_t result_type; // Usable as a UniformRandomBitGenerator (std::shuffle, <random> distributions)
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return 0xFFFFFFFFu; }
+
+	RandomStream(std::uint64_t seed, std::uint64_t stream);
+	result_type operator()(); // Next 32 random bits
+	float uniform(); // Uniform in [0, 1)
+	int uniformInt(int count); // Uniform in [0, count)
+	float normal(float mean, float stddev); // One normal sample
+	void fillNormal(float* out, size_t count, float mean, float stddev); // Normal samples for a whole weight row/matrix
+	RandomStream split(); // New independent stream derived from this one
+};
+
+void setRandomSeed(std::uint64_t seed); // Reset all streams to a new seed
+std::uint64_t getRandomSeed();
+RandomStream& threadRandom(); // Stream of the calling thread, ids are assigned in order of first use
+RandomStream randomStream(std::uint64_t id); // Stream for a fixed purpose (e.g. one sweep run), independent of threads
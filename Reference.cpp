@@ -0,0 +1,252 @@
+#include "Reference.h"
+#include <algorithm>
+#include <cmath>
+
+// Everything the backward pass needs from one forward pass
+struct ReferenceTrace
+{
+    std::vector<Shape> shapes; // Input shape of every layer, the last one is the output shape
+    std::vector<size_t> offsets; // Offset of every layer's parameters in the checkpoint
+    std::vector<std::vector<float>> inputs; // Input of every layer, the last one is the output
+    std::vector<std::vector<float>> z; // Pre-activations of dense/conv layers
+};
+
+static LayerType layerType(const Checkpoint& checkpoint, size_t layer) {
+    return layer < checkpoint.types.size() ? static_cast<LayerType>(checkpoint.types[layer]) : LayerType::Dense;
+}
+
+static Activation layerActivation(const Checkpoint& checkpoint, size_t layer) {
+    return layer < checkpoint.activations.size() ? static_cast<Activation>(checkpoint.activations[layer]) : Activation::ReLU;
+}
+
+// Activation with the C library functions (the runtime uses the vectorized approximations of Activation.h)
+static float activation(Activation type, float z) {
+    switch (type) {
+    case Activation::Sigmoid: return 1.0f / (1.0f + std::exp(-z));
+    case Activation::Tanh: return std::tanh(z);
+    case Activation::LeakyReLU: return z > 0.0f ? z : LEAKY_RELU_SLOPE * z;
+    case Activation::GELU: return 0.5f * z * (1.0f + std::tanh(0.797884560802865355f * (z + 0.044715f * z * z * z)));
+    default: return std::max(0.0f, z);
+    }
+}
+
+// f'(z)
+static float activationDerivative(Activation type, float z) {
+    switch (type) {
+    case Activation::Sigmoid: {
+        float s = 1.0f / (1.0f + std::exp(-z));
+        return s * (1.0f - s);
+    }
+    case Activation::Tanh: {
+        float t = std::tanh(z);
+        return 1.0f - t * t;
+    }
+    case Activation::LeakyReLU: return z > 0.0f ? 1.0f : LEAKY_RELU_SLOPE;
+    case Activation::GELU: {
+        float inner = 0.797884560802865355f * (z + 0.044715f * z * z * z);
+        float t = std::tanh(inner);
+        return 0.5f * (1.0f + t) + 0.5f * z * (1.0f - t * t) * 0.797884560802865355f * (1.0f + 3.0f * 0.044715f * z * z);
+    }
+    default: return z > 0.0f ? 1.0f : 0.0f;
+    }
+}
+
+static void forwardTrace(const Checkpoint& checkpoint, const std::vector<float>& input, ReferenceTrace& trace) {
+    size_t layers = checkpoint.sizes.size() - 1;
+    trace.shapes.assign(1, checkpoint.input);
+    trace.offsets.clear();
+    trace.inputs.assign(1, input);
+    trace.z.assign(layers, std::vector<float>());
+    size_t offset = 0;
+
+    for (size_t l = 0; l < layers; ++l) {
+        LayerType type = layerType(checkpoint, l);
+        Activation act = layerActivation(checkpoint, l);
+        const Shape in = trace.shapes[l];
+        const Shape out = outputShape(type, in, checkpoint.sizes[l + 1]);
+        const std::vector<float>& x = trace.inputs[l];
+        const float* params = checkpoint.params.data() + offset;
+        std::vector<float> y(out.size());
+        bool isOutput = (l + 1 == layers);
+        trace.offsets.push_back(offset);
+
+        if (type == LayerType::Dense) {
+            size_t inputSize = x.size();
+            trace.z[l].resize(out.size());
+            for (int o = 0; o < out.size(); ++o) {
+                const float* w = params + o * (inputSize + 1);
+                float z = w[inputSize];
+                for (size_t k = 0; k < inputSize; ++k) {
+                    z += w[k] * x[k];
+                }
+                trace.z[l][o] = z;
+                y[o] = isOutput ? z : activation(act, z);
+            }
+            offset += out.size() * (inputSize + 1);
+        }
+        else if (type == LayerType::Conv2D) {
+            int weights = weightsPerNeuron(type, in);
+            trace.z[l].resize(out.size());
+            for (int o = 0; o < out.channels; ++o) {
+                const float* w = params + o * (weights + 1);
+                for (int py = 0; py < in.height; ++py) {
+                    for (int px = 0; px < in.width; ++px) {
+                        float z = w[weights];
+                        for (int c = 0; c < in.channels; ++c) {
+                            for (int ky = 0; ky < CONV_KERNEL; ++ky) {
+                                for (int kx = 0; kx < CONV_KERNEL; ++kx) {
+                                    int sy = py + ky - CONV_PADDING, sx = px + kx - CONV_PADDING;
+                                    if (sy < 0 || sy >= in.height || sx < 0 || sx >= in.width) continue;
+                                    z += w[(c * CONV_KERNEL + ky) * CONV_KERNEL + kx] * x[(c * in.height + sy) * in.width + sx];
+                                }
+                            }
+                        }
+                        int index = (o * out.height + py) * out.width + px;
+                        trace.z[l][index] = z;
+                        y[index] = activation(act, z);
+                    }
+                }
+            }
+            offset += out.channels * (weights + 1);
+        }
+        else {
+            for (int c = 0; c < out.channels; ++c) {
+                for (int py = 0; py < out.height; ++py) {
+                    for (int px = 0; px < out.width; ++px) {
+                        float best = -INFINITY, sum = 0.f;
+                        for (int dy = 0; dy < POOL_SIZE; ++dy) {
+                            for (int dx = 0; dx < POOL_SIZE; ++dx) {
+                                float value = x[(c * in.height + py * POOL_SIZE + dy) * in.width + px * POOL_SIZE + dx];
+                                best = std::max(best, value);
+                                sum += value;
+                            }
+                        }
+                        y[(c * out.height + py) * out.width + px] = (type == LayerType::MaxPool) ? best : sum / (POOL_SIZE * POOL_SIZE);
+                    }
+                }
+            }
+        }
+
+        if (isOutput) {
+            float maxLogit = *std::max_element(y.begin(), y.end());
+            float sumExp = 0.f;
+            for (float& value : y) {
+                value = std::exp(value - maxLogit);
+                sumExp += value;
+            }
+            for (float& value : y) {
+                value /= sumExp;
+            }
+        }
+        trace.shapes.push_back(out);
+        trace.inputs.push_back(y);
+    }
+}
+
+std::vector<float> referenceForward(const Checkpoint& checkpoint, const std::vector<float>& input) {
+    ReferenceTrace trace;
+    forwardTrace(checkpoint, input, trace);
+    return trace.inputs.back();
+}
+
+float referenceLoss(const Checkpoint& checkpoint, const std::pair<int, std::vector<float>>& sample) {
+    std::vector<float> out = referenceForward(checkpoint, sample.second);
+    if (sample.first < 0 || sample.first >= static_cast<int>(out.size())) return 0.f;
+    return -std::log(std::max(1e-6f, out[sample.first]));
+}
+
+std::vector<float> referenceGradient(const Checkpoint& checkpoint, const std::pair<int, std::vector<float>>& sample) {
+    ReferenceTrace trace;
+    forwardTrace(checkpoint, sample.second, trace);
+    std::vector<float> gradient(checkpoint.params.size(), 0.0f);
+    size_t layers = checkpoint.sizes.size() - 1;
+
+    // dL/d(output) of the current layer; softmax + cross-entropy gives p - target directly as dL/dz
+    std::vector<float> error = trace.inputs.back();
+    if (sample.first >= 0 && sample.first < static_cast<int>(error.size())) error[sample.first] -= 1.0f;
+
+    for (size_t l = layers; l-- > 0;) {
+        LayerType type = layerType(checkpoint, l);
+        const Shape in = trace.shapes[l];
+        const Shape out = trace.shapes[l + 1];
+        const std::vector<float>& x = trace.inputs[l];
+        const float* params = checkpoint.params.data() + trace.offsets[l];
+        float* grad = gradient.data() + trace.offsets[l];
+        std::vector<float> inputError(x.size(), 0.0f);
+
+        if (type == LayerType::Dense || type == LayerType::Conv2D) {
+            // Activation derivative on hidden layers, the output layer already holds dL/dz
+            std::vector<float> delta(error);
+            if (l + 1 != layers) {
+                Activation act = layerActivation(checkpoint, l);
+                for (size_t i = 0; i < delta.size(); ++i) {
+                    delta[i] *= activationDerivative(act, trace.z[l][i]);
+                }
+            }
+            if (type == LayerType::Dense) {
+                size_t inputSize = x.size();
+                for (int o = 0; o < out.size(); ++o) {
+                    const float* w = params + o * (inputSize + 1);
+                    float* g = grad + o * (inputSize + 1);
+                    for (size_t k = 0; k < inputSize; ++k) {
+                        g[k] = delta[o] * x[k];
+                        inputError[k] += delta[o] * w[k];
+                    }
+                    g[inputSize] = delta[o];
+                }
+            }
+            else {
+                int weights = weightsPerNeuron(type, in);
+                for (int o = 0; o < out.channels; ++o) {
+                    const float* w = params + o * (weights + 1);
+                    float* g = grad + o * (weights + 1);
+                    for (int py = 0; py < in.height; ++py) {
+                        for (int px = 0; px < in.width; ++px) {
+                            float d = delta[(o * out.height + py) * out.width + px];
+                            if (d == 0.0f) continue;
+                            g[weights] += d;
+                            for (int c = 0; c < in.channels; ++c) {
+                                for (int ky = 0; ky < CONV_KERNEL; ++ky) {
+                                    for (int kx = 0; kx < CONV_KERNEL; ++kx) {
+                                        int sy = py + ky - CONV_PADDING, sx = px + kx - CONV_PADDING;
+                                        if (sy < 0 || sy >= in.height || sx < 0 || sx >= in.width) continue;
+                                        int k = (c * CONV_KERNEL + ky) * CONV_KERNEL + kx;
+                                        int source = (c * in.height + sy) * in.width + sx;
+                                        g[k] += d * x[source];
+                                        inputError[source] += d * w[k];
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        else {
+            for (int c = 0; c < out.channels; ++c) {
+                for (int py = 0; py < out.height; ++py) {
+                    for (int px = 0; px < out.width; ++px) {
+                        float e = error[(c * out.height + py) * out.width + px];
+                        int bestIndex = (c * in.height + py * POOL_SIZE) * in.width + px * POOL_SIZE; // Window's first pixel, like maxPoolForward
+                        float best = x[bestIndex];
+                        for (int dy = 0; dy < POOL_SIZE; ++dy) {
+                            for (int dx = 0; dx < POOL_SIZE; ++dx) {
+                                int index = (c * in.height + py * POOL_SIZE + dy) * in.width + px * POOL_SIZE + dx;
+                                if (type == LayerType::AvgPool) {
+                                    inputError[index] += e / (POOL_SIZE * POOL_SIZE);
+                                }
+                                else if (x[index] > best) {
+                                    best = x[index];
+                                    bestIndex = index;
+                                }
+                            }
+                        }
+                        if (type == LayerType::MaxPool) inputError[bestIndex] += e;
+                    }
+                }
+            }
+        }
+        error.swap(inputError);
+    }
+    return gradient;
+}
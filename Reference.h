@@ -0,0 +1,18 @@
+#pragma once
+#include "Checkpoint.h"
+#include <utility>
+#include <vector>
+
+// Reference backend: plain scalar math on a Checkpoint, kept as the oracle for optimized backends.
+// Dense layers use the original Network loop order (z = b, then z += w[k] * x[k] for k = 0..n-1),
+// convolution and pooling use direct loops instead of im2col/GEMM, activations and softmax use the C library
+// functions instead of the approximations of Activation.h. Nothing here should be optimized.
+
+// Softmax probabilities for one input
+std::vector<float> referenceForward(const Checkpoint& checkpoint, const std::vector<float>& input);
+
+// Cross-entropy loss for one sample (same clamping as Network::computeLoss)
+float referenceLoss(const Checkpoint& checkpoint, const std::pair<int, std::vector<float>>& sample);
+
+// dL/dparams for one sample in the checkpoint layout, all layers use the weights before any update
+std::vector<float> referenceGradient(const Checkpoint& checkpoint, const std::pair<int, std::vector<float>>& sample);
@@ -0,0 +1,294 @@
+#include "SelfCheck.h"
+#include "Network.h"
+#include "Kernels.h"
+#include "Pipeline.h"
+#include "Random.h"
+#include "Reference.h"
+#include "Snapshot.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Forward outputs may differ by this many units in the last place (summation order) ...
+const std::int64_t MAX_FORWARD_ULP = 512;
+// ... or by this much in absolute terms (tiny probabilities have huge ULP distances)
+const float FORWARD_ABS_TOLERANCE = 1e-6f;
+// Gradients read out of an SGD step only lose the float resolution of (before - after), see NETWORK_GRADIENT_STEP
+const float GRADIENT_REL_TOLERANCE = 1e-3f;
+const float FD_REL_TOLERANCE = 2e-2f;
+const float FD_ABS_TOLERANCE = 2e-3f;
+const float FD_MAX_FAILURES = 0.05f; // ReLU and max-pool kinks make a few finite differences meaningless
+// Learning rate used to read gradients out of Network::backPropagation. All gradients are computed before the
+// update, so any step is exact up to rounding; smaller ones lose float resolution in (before - after)
+const float NETWORK_GRADIENT_STEP = 1e-3f;
+
+// Distance between two floats in units in the last place
+static std::int64_t ulpDistance(float a, float b) {
+    std::int32_t ia, ib;
+    std::memcpy(&ia, &a, sizeof(float));
+    std::memcpy(&ib, &b, sizeof(float));
+    // Map the sign-magnitude bit patterns to a monotonic integer line
+    std::int64_t la = ia < 0 ? static_cast<std::int64_t>(INT32_MIN) - ia : ia;
+    std::int64_t lb = ib < 0 ? static_cast<std::int64_t>(INT32_MIN) - ib : ib;
+    return la > lb ? la - lb : lb - la;
+}
+
+// Gradient read out of one SGD step with a small learning rate: (before - after) / learning rate
+static std::vector<float> stepGradient(const Checkpoint& before, const Checkpoint& after) {
+    std::vector<float> gradient(before.params.size());
+    for (size_t i = 0; i < gradient.size() && i < after.params.size(); ++i) {
+        gradient[i] = static_cast<float>((static_cast<double>(before.params[i]) - after.params[i]) / NETWORK_GRADIENT_STEP);
+    }
+    return gradient;
+}
+
+// The backend run with other kernel parameters, the previous ones are restored after every call
+static Backend withTuning(const Backend& backend, const std::string& variant, const KernelTuning& tuning) {
+    Backend tuned;
+    tuned.name = backend.name + " (" + variant + ")";
+    auto forward = backend.forward;
+    auto gradient = backend.gradient;
+    if (forward) {
+        tuned.forward = [forward, tuning](const Checkpoint& checkpoint, const std::vector<float>& input) {
+            KernelTuning previous = kernelTuning();
+            setKernelTuning(tuning);
+            std::vector<float> out = forward(checkpoint, input);
+            setKernelTuning(previous);
+            return out;
+        };
+    }
+    if (gradient) {
+        tuned.gradient = [gradient, tuning](const Checkpoint& checkpoint, const std::pair<int, std::vector<float>>& sample) {
+            KernelTuning previous = kernelTuning();
+            setKernelTuning(tuning);
+            std::vector<float> out = gradient(checkpoint, sample);
+            setKernelTuning(previous);
+            return out;
+        };
+    }
+    return tuned;
+}
+
+std::vector<Backend> checkedBackends() {
+    std::vector<Backend> backends;
+
+    // Runtime Network: dense loops, im2col + GEMM convolution, pooling kernels
+    Backend network;
+    network.name = "Network";
+    network.forward = [](const Checkpoint& checkpoint, const std::vector<float>& input) {
+        Network net(checkpoint, 0.f, 1);
+        return net.forwardPass({ 0, input });
+    };
+    network.gradient = [](const Checkpoint& checkpoint, const std::pair<int, std::vector<float>>& sample) {
+        Network net(checkpoint, NETWORK_GRADIENT_STEP, 1);
+        net.forwardPass(sample);
+        net.backPropagation(sample);
+        return stepGradient(checkpoint, net.getCheckpoint());
+    };
+
+    // Inference snapshots (pure forward pass used by the visualizer, validation and canvas predictions)
+    Backend snapshot;
+    snapshot.name = "WeightSnapshot";
+    snapshot.forward = [](const Checkpoint& checkpoint, const std::vector<float>& input) {
+        WeightSnapshot weights(checkpoint, 0);
+        Workspace work;
+        weights.forward(input, work);
+        return work.activations.back();
+    };
+
+    // Pipeline-parallel training: one sample through two stages, gradients applied at the flush
+    Backend pipeline;
+    pipeline.name = "PipelineTrainer";
+    pipeline.gradient = [](const Checkpoint& checkpoint, const std::pair<int, std::vector<float>>& sample) {
+        Dataset batch;
+        std::vector<std::uint8_t> pixels(sample.second.size());
+        for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = static_cast<std::uint8_t>(std::lround(sample.second[i] * 255.f));
+        batch.add(sample.first, pixels.data(), pixels.size());
+        batch.setShape({ checkpoint.input, 10 });
+        Network net(checkpoint, NETWORK_GRADIENT_STEP, 1);
+        {
+            PipelineTrainer trainer(net, 2, 1, 1);
+            trainer.trainBatch(batch, 0, 1);
+        }
+        return stepGradient(checkpoint, net.getCheckpoint());
+    };
+
+    // The paths the autotuner can pick (Tuning.h), each forced on: the default tuning never runs the sparse
+    // forward pass, and uses the sparse backward pass only on sparse inputs
+    KernelTuning denseBackward;
+    denseBackward.backwardDensity = 0.f;
+    KernelTuning sparse;
+    sparse.sparseDensity = 2.f; // Every share of nonzero inputs is below it
+    sparse.backwardDensity = 2.f;
+    KernelTuning blocked;
+    blocked.gemmBlockN = 8;
+    blocked.gemmBlockK = 4;
+    blocked.dotUnroll = 8;
+    blocked.parallelMinWork = 64; // Many small chunks
+    KernelTuning oddBlocks;
+    oddBlocks.gemmBlockN = 5;
+    oddBlocks.gemmBlockK = 3;
+    oddBlocks.dotUnroll = 2;
+    oddBlocks.sparseDensity = 0.75f;
+
+    backends.push_back(network);
+    backends.push_back(withTuning(network, "dense backward", denseBackward));
+    backends.push_back(withTuning(network, "sparse", sparse));
+    backends.push_back(withTuning(network, "blocked GEMM, unroll 8", blocked));
+    backends.push_back(withTuning(network, "odd blocks, unroll 2", oddBlocks));
+    backends.push_back(snapshot);
+    backends.push_back(withTuning(snapshot, "sparse", sparse));
+    backends.push_back(withTuning(snapshot, "blocked GEMM, unroll 8", blocked));
+    backends.push_back(pipeline);
+    backends.push_back(withTuning(pipeline, "sparse", sparse));
+    return backends;
+}
+
+// Random topology with a 1x28x28 input and 10 outputs: dense only, or convolution blocks followed by dense layers.
+// Half of the dense/conv layers get a random activation other than ReLU.
+static void randomTopology(RandomStream& random, std::vector<int>& sizes, std::vector<LayerType>& types, std::vector<Activation>& activations,
+    std::string& description) {
+    sizes.clear();
+    types.clear();
+    if (random.uniformInt(2) == 1) {
+        int blocks = 1 + random.uniformInt(2);
+        for (int b = 0; b < blocks; ++b) {
+            sizes.push_back(1 + random.uniformInt(4));
+            types.push_back(LayerType::Conv2D);
+            int pool = random.uniformInt(3);
+            if (pool > 0) {
+                sizes.push_back(1);
+                types.push_back(pool == 1 ? LayerType::MaxPool : LayerType::AvgPool);
+            }
+        }
+    }
+    int hidden = random.uniformInt(3);
+    for (int h = 0; h < hidden; ++h) {
+        sizes.push_back(1 + random.uniformInt(48));
+        types.push_back(LayerType::Dense);
+    }
+    sizes.push_back(10);
+    types.push_back(LayerType::Dense);
+    activations.clear();
+    for (size_t i = 0; i < types.size(); ++i) {
+        bool randomActivation = hasParameters(types[i]) && i + 1 < types.size() && random.uniformInt(2) == 1;
+        activations.push_back(randomActivation ? static_cast<Activation>(1 + random.uniformInt(4)) : Activation::ReLU);
+    }
+
+    description.clear();
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        description += i ? "-" : "";
+        if (types[i] == LayerType::Conv2D) description += "c" + std::to_string(sizes[i]);
+        else if (types[i] == LayerType::MaxPool) description += "m";
+        else if (types[i] == LayerType::AvgPool) description += "a";
+        else description += std::to_string(sizes[i]);
+        if (activations[i] != Activation::ReLU) description += std::string("(") + activationName(activations[i]) + ")";
+    }
+}
+
+bool runSelfCheck(const std::vector<std::string>& args) {
+    int cases = 20;
+    int fdChecks = 20;
+    std::uint64_t seed = 1; // Fixed by default so failures can be reproduced
+    for (auto& arg : args) {
+        if (arg.compare(0, 6, "cases=") == 0) cases = std::max(1, std::atoi(arg.c_str() + 6));
+        else if (arg.compare(0, 3, "fd=") == 0) fdChecks = std::max(0, std::atoi(arg.c_str() + 3));
+        else if (arg.compare(0, 5, "seed=") == 0) seed = std::strtoull(arg.c_str() + 5, nullptr, 10);
+        else {
+            std::cout << "Unknown self-check option " << arg << ", use cases=N, fd=N and seed=N." << std::endl;
+            return false;
+        }
+    }
+    setRandomSeed(seed);
+
+    std::vector<Backend> backends = checkedBackends();
+    std::vector<std::int64_t> maxUlp(backends.size(), 0);
+    std::vector<float> maxAbs(backends.size(), 0.f), maxGradientError(backends.size(), 0.f);
+    std::vector<int> failures(backends.size(), 0);
+    int fdTotal = 0, fdFailed = 0;
+
+    for (int c = 0; c < cases; ++c) {
+        RandomStream random = randomStream(static_cast<std::uint64_t>(c));
+        std::vector<int> sizes;
+        std::vector<LayerType> types;
+        std::vector<Activation> activations;
+        std::string description;
+        randomTopology(random, sizes, types, activations, description);
+
+        // Random weights (He initialization plus noise so biases are not all zero) and a sparse random input.
+        // The input values are bytes / 255 like dataset pixels, so backends that read a Dataset see the same input.
+        Checkpoint checkpoint = Network(sizes, 0.f, 1, types, activations).getCheckpoint();
+        for (float& p : checkpoint.params) p += random.normal(0.f, 0.05f);
+        std::pair<int, std::vector<float>> sample(random.uniformInt(10), std::vector<float>(checkpoint.input.size()));
+        for (float& x : sample.second) x = random.uniformInt(2) ? static_cast<float>(random.uniformInt(256)) / 255.0f : 0.f;
+
+        std::vector<float> expected = referenceForward(checkpoint, sample.second);
+        std::vector<float> expectedGradient = referenceGradient(checkpoint, sample);
+
+        for (size_t b = 0; b < backends.size(); ++b) {
+            bool ok = true;
+            std::vector<float> out = backends[b].forward ? backends[b].forward(checkpoint, sample.second) : expected;
+            if (out.size() != expected.size()) {
+                ok = false;
+            }
+            else {
+                for (size_t i = 0; i < out.size(); ++i) {
+                    std::int64_t ulp = ulpDistance(out[i], expected[i]);
+                    float diff = std::abs(out[i] - expected[i]);
+                    maxUlp[b] = std::max(maxUlp[b], ulp);
+                    maxAbs[b] = std::max(maxAbs[b], diff);
+                    if (ulp > MAX_FORWARD_ULP && diff > FORWARD_ABS_TOLERANCE) ok = false;
+                }
+            }
+            if (backends[b].gradient) {
+                std::vector<float> gradient = backends[b].gradient(checkpoint, sample);
+                // Relative to the largest gradient of the case, so near-zero entries do not dominate
+                float scale = 1e-6f;
+                for (float g : expectedGradient) scale = std::max(scale, std::abs(g));
+                for (size_t i = 0; i < gradient.size() && i < expectedGradient.size(); ++i) {
+                    float error = std::abs(gradient[i] - expectedGradient[i]) / scale;
+                    maxGradientError[b] = std::max(maxGradientError[b], error);
+                    if (error > GRADIENT_REL_TOLERANCE) ok = false;
+                }
+                if (gradient.size() != expectedGradient.size()) ok = false;
+            }
+            if (!ok) {
+                failures[b]++;
+                std::cout << "  " << backends[b].name << " differs from the reference on case " << c << " (" << description << ")" << std::endl;
+            }
+        }
+
+        // Central finite differences of the reference loss
+        for (int f = 0; f < fdChecks; ++f) {
+            size_t index = static_cast<size_t>(random.uniformInt(static_cast<int>(checkpoint.params.size())));
+            const float h = 1e-2f;
+            Checkpoint plus = checkpoint, minus = checkpoint;
+            plus.params[index] += h;
+            minus.params[index] -= h;
+            float numeric = (referenceLoss(plus, sample) - referenceLoss(minus, sample)) / (2 * h);
+            float analytic = expectedGradient[index];
+            fdTotal++;
+            if (std::abs(numeric - analytic) > FD_REL_TOLERANCE * std::max(std::abs(numeric), std::abs(analytic)) + FD_ABS_TOLERANCE) {
+                fdFailed++;
+            }
+        }
+    }
+
+    bool passed = true;
+    std::cout << std::endl << "Self-check on " << cases << " random cases (seed " << seed << ")" << std::endl;
+    for (size_t b = 0; b < backends.size(); ++b) {
+        std::cout << "  " << backends[b].name << ":";
+        if (backends[b].forward) std::cout << " max forward difference " << maxUlp[b] << " ULP (" << maxAbs[b] << " abs)" << (backends[b].gradient ? "," : "");
+        if (backends[b].gradient) std::cout << " max gradient error " << maxGradientError[b] * 100.0f << "%";
+        std::cout << ", " << failures[b] << " failed cases" << std::endl;
+        passed = passed && failures[b] == 0;
+    }
+    bool fdPassed = fdFailed <= FD_MAX_FAILURES * fdTotal;
+    std::cout << "  Reference gradient: " << fdTotal - fdFailed << "/" << fdTotal << " finite-difference checks agree" << std::endl;
+    passed = passed && fdPassed;
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    return passed;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "Checkpoint.h"
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Differential checks (run the app with --self-check [cases=N] [fd=N] [seed=N])
+//
+// Every backend is run on random topologies, weights and inputs and compared against the reference backend
+// (Reference.h): forward outputs within a ULP / absolute bound, parameter gradients within a relative bound.
+// The reference gradient itself is checked with central finite differences on fd random parameters per case.
+
+// A backend under test. forward returns the probabilities, gradient dL/dparams in the checkpoint layout;
+// either may be empty if the backend only implements the other one.
+struct Backend
+{
+	std::string name;
+	std::function<std::vector<float>(const Checkpoint&, const std::vector<float>&)> forward;
+	std::function<std::vector<float>(const Checkpoint&, const std::pair<int, std::vector<float>>&)> gradient;
+};
+
+std::vector<Backend> checkedBackends(); // Every optimized path registers here, kernel-tuned variants included
+bool runSelfCheck(const std::vector<std::string>& args); // True if every check passed
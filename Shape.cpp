@@ -0,0 +1,52 @@
+#include "Shape.h"
+
+int Shape::size() const {
+    return channels * height * width;
+}
+
+bool Shape::operator==(const Shape& other) const {
+    return channels == other.channels && height == other.height && width == other.width;
+}
+
+bool Shape::operator!=(const Shape& other) const {
+    return !(*this == other);
+}
+
+Shape outputShape(LayerType type, const Shape& input, int neuronCount) {
+    switch (type) {
+    case LayerType::Conv2D:
+        // Stride 1 with padding keeps the spatial size, one output channel per neuron (filter)
+        return Shape{ neuronCount, input.height + 2 * CONV_PADDING - CONV_KERNEL + 1, input.width + 2 * CONV_PADDING - CONV_KERNEL + 1 };
+    case LayerType::MaxPool:
+    case LayerType::AvgPool:
+        // Channels pass through, odd borders are dropped
+        return Shape{ input.channels, input.height / POOL_SIZE, input.width / POOL_SIZE };
+    default:
+        return Shape{ neuronCount, 1, 1 };
+    }
+}
+
+int weightsPerNeuron(LayerType type, const Shape& input) {
+    switch (type) {
+    case LayerType::Conv2D:
+        return input.channels * CONV_KERNEL * CONV_KERNEL;
+    case LayerType::MaxPool:
+    case LayerType::AvgPool:
+        return 0;
+    default:
+        return input.size(); // Dense layers see the flattened input
+    }
+}
+
+bool hasParameters(LayerType type) {
+    return type == LayerType::Dense || type == LayerType::Conv2D;
+}
+
+const char* layerTypeName(LayerType type) {
+    switch (type) {
+    case LayerType::Conv2D: return "Conv";
+    case LayerType::MaxPool: return "MaxPool";
+    case LayerType::AvgPool: return "AvgPool";
+    default: return "Dense";
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// Layer types that can be added from the GUI
+enum class LayerType { Dense = 0, Conv2D = 1, MaxPool = 2, AvgPool = 3 };
+
+// Convolution and pooling hyperparameters ("same" 3x3 convolution, 2x2 pooling)
+const int CONV_KERNEL = 3;
+const int CONV_PADDING = 1;
+const int POOL_SIZE = 2;
+
+// Channels x height x width of the activations flowing between layers.
+// Dense layers produce (neurons, 1, 1), the input shape comes from the dataset (MNIST: (1, 28, 28)).
+struct Shape
+{
+	int channels;
+	int height;
+	int width;
+
+	int size() const; // Total number of values
+	bool operator==(const Shape& other) const;
+	bool operator!=(const Shape& other) const;
+};
+
+const Shape DEFAULT_INPUT_SHAPE = { 1, 28, 28 }; // MNIST, used when no dataset provides a shape
+
+Shape outputShape(LayerType type, const Shape& input, int neuronCount); // Shape produced by a layer
+int weightsPerNeuron(LayerType type, const Shape& input); // Incoming weights of one neuron (0 for pooling)
+bool hasParameters(LayerType type); // False for pooling layers
+const char* layerTypeName(LayerType type); // Short name used in the GUI and logs
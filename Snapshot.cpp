@@ -0,0 +1,137 @@
+#include "Snapshot.h"
+#include "Network.h"
+#include "Kernels.h"
+#include "TaskScheduler.h"
+#include "Trace.h"
+#include <algorithm>
+
+// Items per parallel chunk, same rule as Network::minChunk
+static size_t minChunk(size_t workPerItem) {
+    return std::max<size_t>(1, kernelTuning().parallelMinWork / std::max<size_t>(1, workPerItem));
+}
+
+WeightSnapshot::WeightSnapshot(const Checkpoint& checkpoint, std::uint64_t version)
+    : version(version), inputShape(checkpoint.input) {
+    shapes.push_back(inputShape);
+    const float* params = checkpoint.params.data();
+    for (size_t i = 1; i < checkpoint.sizes.size(); ++i) {
+        LayerWeights layer;
+        layer.type = (i - 1 < checkpoint.types.size()) ? static_cast<LayerType>(checkpoint.types[i - 1]) : LayerType::Dense;
+        layer.activation = (i - 1 < checkpoint.activations.size()) ? static_cast<Activation>(checkpoint.activations[i - 1]) : Activation::ReLU;
+        layer.neurons = checkpoint.sizes[i];
+        layer.fanIn = hasParameters(layer.type) ? weightsPerNeuron(layer.type, shapes.back()) : 0;
+        if (hasParameters(layer.type)) {
+            layer.weights.resize(layer.neurons * layer.fanIn);
+            layer.biases.resize(layer.neurons);
+            for (int n = 0; n < layer.neurons; ++n) {
+                std::copy(params, params + layer.fanIn, layer.weights.begin() + n * layer.fanIn);
+                layer.biases[n] = params[layer.fanIn];
+                params += layer.fanIn + 1;
+            }
+        }
+        shapes.push_back(outputShape(layer.type, shapes.back(), layer.neurons));
+        layers.push_back(std::move(layer));
+    }
+}
+
+std::uint64_t WeightSnapshot::getVersion() const {
+    return version;
+}
+
+size_t WeightSnapshot::inputSize() const {
+    return inputShape.size();
+}
+
+size_t WeightSnapshot::layerCount() const {
+    return layers.size();
+}
+
+void WeightSnapshot::forward(const std::vector<float>& input, Workspace& work) const {
+    TraceScope trace("Snapshot forward", "inference");
+    work.activations.resize(layers.size() + 1);
+    work.preActivations.resize(layers.size());
+    work.columns.resize(layers.size());
+    work.poolIndices.resize(layers.size());
+    work.activations[0] = input;
+    for (size_t l = 0; l < layers.size(); ++l) {
+        const Shape& in = shapes[l];
+        std::vector<float>& out = work.activations[l + 1];
+        switch (layers[l].type) {
+        case LayerType::Dense:
+            denseForward(l, work);
+            break;
+        case LayerType::Conv2D:
+            convForward(l, work);
+            break;
+        case LayerType::MaxPool:
+            out.resize(shapes[l + 1].size());
+            work.poolIndices[l].resize(out.size());
+            maxPoolForward(work.activations[l].data(), in, out.data(), work.poolIndices[l].data());
+            break;
+        default:
+            out.resize(shapes[l + 1].size());
+            avgPoolForward(work.activations[l].data(), in, out.data());
+            break;
+        }
+    }
+}
+
+void WeightSnapshot::denseForward(size_t layerIndex, Workspace& work) const {
+    const LayerWeights& layer = layers[layerIndex];
+    bool isOutputLayer = layerIndex + 1 == layers.size();
+    const std::vector<float>& x = work.activations[layerIndex];
+    std::vector<float>& z = work.preActivations[layerIndex];
+    std::vector<float>& out = work.activations[layerIndex + 1];
+    z.resize(layer.neurons);
+    out.resize(layer.neurons);
+
+    std::vector<int>& active = work.activeInputs;
+    bool sparse = false;
+    if (kernelTuning().sparseDensity > 0.f) {
+        active.clear();
+        for (size_t k = 0; k < x.size(); ++k) {
+            if (x[k] != 0.0f) active.push_back(static_cast<int>(k));
+        }
+        sparse = active.size() < kernelTuning().sparseDensity * x.size();
+    }
+    taskScheduler().parallelFor(0, layer.neurons, minChunk(sparse ? active.size() : x.size()), [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j) {
+            const float* row = layer.weights.data() + j * layer.fanIn;
+            z[j] = sparse ? sparseDot(row, x.data(), active.data(), active.size(), layer.biases[j])
+                : dot(row, x.data(), layer.fanIn, layer.biases[j]);
+        }
+        if (!isOutputLayer) activate(layer.activation, z.data() + begin, out.data() + begin, end - begin);
+    });
+    if (isOutputLayer) softmax(z.data(), out.data(), layer.neurons);
+}
+
+void WeightSnapshot::convForward(size_t layerIndex, Workspace& work) const {
+    const LayerWeights& layer = layers[layerIndex];
+    const Shape& in = shapes[layerIndex];
+    int weightCount = static_cast<int>(layer.fanIn);
+    int pixels = in.height * in.width;
+    std::vector<float>& columns = work.columns[layerIndex];
+    columns.resize(static_cast<size_t>(weightCount) * pixels);
+    im2col(work.activations[layerIndex].data(), in, columns.data());
+
+    std::vector<float>& z = work.preActivations[layerIndex];
+    std::vector<float>& out = work.activations[layerIndex + 1];
+    z.resize(static_cast<size_t>(layer.neurons) * pixels);
+    out.resize(z.size());
+    taskScheduler().parallelFor(0, layer.neurons, minChunk(static_cast<size_t>(weightCount) * pixels), [&](size_t begin, size_t end) {
+        gemm(static_cast<int>(end - begin), pixels, weightCount, layer.weights.data() + begin * weightCount, columns.data(), z.data() + begin * pixels);
+        for (size_t o = begin; o < end; ++o) {
+            float* row = z.data() + o * pixels;
+            for (int p = 0; p < pixels; ++p) {
+                row[p] += layer.biases[o];
+            }
+            activate(layer.activation, row, out.data() + o * pixels, pixels);
+        }
+    });
+}
+
+int WeightSnapshot::predict(const std::vector<float>& input, Workspace& work) const {
+    forward(input, work);
+    const std::vector<float>& probabilities = work.activations.back();
+    return static_cast<int>(std::max_element(probabilities.begin(), probabilities.end()) - probabilities.begin());
+}
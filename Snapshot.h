@@ -0,0 +1,43 @@
+#pragma once
+#include "Checkpoint.h"
+#include "Shape.h"
+#include "Activation.h"
+#include <cstdint>
+#include <vector>
+
+struct Workspace;
+
+// Immutable, versioned copy of a network's weights for inference.
+// The trainer publishes a new snapshot with Network::publishSnapshot (an atomic shared_ptr swap) and readers keep
+// the one they loaded for as long as they use it, so canvas predictions, test evaluation and the visualizer never
+// touch the weights being trained and never wait for the optimizer. forward() is a pure function: it only writes
+// the caller's workspace, several threads can run the same snapshot at once.
+// The kernels and their order are the ones of Network::forwardLayer, results are bit-identical.
+class WeightSnapshot
+{
+private:
+	struct LayerWeights
+	{
+		LayerType type;
+		Activation activation;
+		int neurons;
+		size_t fanIn; // Incoming weights per neuron (0 for pooling)
+		std::vector<float> weights; // neurons x fanIn, packed without the biases (the GEMM operand of convolutions)
+		std::vector<float> biases;
+	};
+	std::uint64_t version;
+	Shape inputShape;
+	std::vector<Shape> shapes; // Input shape of every layer, shapes.back() is the output shape
+	std::vector<LayerWeights> layers;
+
+	void denseForward(size_t layerIndex, Workspace& work) const;
+	void convForward(size_t layerIndex, Workspace& work) const;
+
+public:
+	WeightSnapshot(const Checkpoint& checkpoint, std::uint64_t version); // The checkpoint must be complete (expectedParamCount)
+	std::uint64_t getVersion() const; // Increases with every published snapshot of a network
+	size_t inputSize() const;
+	size_t layerCount() const;
+	void forward(const std::vector<float>& input, Workspace& work) const; // work.activations.back() holds the probabilities
+	int predict(const std::vector<float>& input, Workspace& work) const; // Class with the highest probability
+};
@@ -0,0 +1,165 @@
+#pragma once
+#include "Checkpoint.h"
+#include <array>
+#include <algorithm>
+#include <cmath>
+
+// Compile-time specialized version of Network for a fixed dense topology.
+// Layer sizes are template parameters, so every loop has a constant trip count and stride,
+// storage is std::array and no size checks run inside forward/backward.
+// Topologies are exported from the GUI with Network::exportSpecializedHeader.
+// Large topologies do not fit on the stack: allocate instances with new.
+
+// Dot product with a compile-time length, 4 independent accumulators and a constant tail
+template <int N>
+inline float staticDot(const float* w, const float* x) {
+	float acc0 = 0.f, acc1 = 0.f, acc2 = 0.f, acc3 = 0.f;
+	for (int i = 0; i < N - N % 4; i += 4) {
+		acc0 += w[i] * x[i];
+		acc1 += w[i + 1] * x[i + 1];
+		acc2 += w[i + 2] * x[i + 2];
+		acc3 += w[i + 3] * x[i + 3];
+	}
+	for (int i = N - N % 4; i < N; ++i) {
+		acc0 += w[i] * x[i];
+	}
+	return (acc0 + acc1) + (acc2 + acc3);
+}
+
+// Fully connected layer with In inputs and Out neurons (ReLU, or softmax if it is the output layer)
+template <int In, int Out>
+struct StaticDense
+{
+	std::array<float, In * Out> weights; // Row-major, one row of In weights per neuron
+	std::array<float, Out> biases;
+	std::array<float, Out> preActivation; // z = w.x + b, kept for backprop
+	std::array<float, Out> output; // Activation after ReLU / softmax
+	std::array<float, Out> delta; // dL/dz
+	std::array<float, Out> error; // dL/d(output), filled by the next layer
+};
+
+template <int... Sizes>
+struct StaticStack;
+
+// Terminal case: nothing after the output layer
+template <int In>
+struct StaticStack<In>
+{
+	static constexpr int outputSize = In;
+	const float* forward(const float* x) { return x; }
+	void backward(const float*, float*, int, float) {}
+	const float* load(const float* params) { return params; }
+};
+
+template <int In, int Out, int... Rest>
+struct StaticStack<In, Out, Rest...>
+{
+	static constexpr bool isOutput = sizeof...(Rest) == 0;
+	static constexpr int outputSize = StaticStack<Out, Rest...>::outputSize;
+
+	StaticDense<In, Out> layer;
+	StaticStack<Out, Rest...> next;
+
+	const float* forward(const float* x) {
+		for (int o = 0; o < Out; ++o) {
+			float z = layer.biases[o] + staticDot<In>(&layer.weights[o * In], x);
+			layer.preActivation[o] = z;
+			layer.output[o] = isOutput ? z : std::max(0.0f, z);
+		}
+		if (isOutput) {
+			float maxLogit = *std::max_element(layer.output.begin(), layer.output.end());
+			float sumExp = 0.f;
+			for (int o = 0; o < Out; ++o) {
+				layer.output[o] = std::exp(layer.output[o] - maxLogit);
+				sumExp += layer.output[o];
+			}
+			for (int o = 0; o < Out; ++o) {
+				layer.output[o] /= sumExp;
+			}
+		}
+		return next.forward(layer.output.data());
+	}
+
+	// x is this layer's input, inputError receives dL/dx (computed before this layer is updated)
+	void backward(const float* x, float* inputError, int label, float learningRate) {
+		if (isOutput) {
+			for (int o = 0; o < Out; ++o) {
+				layer.delta[o] = layer.output[o] - (o == label ? 1.0f : 0.0f);
+			}
+		}
+		else {
+			next.backward(layer.output.data(), layer.error.data(), label, learningRate);
+			for (int o = 0; o < Out; ++o) {
+				layer.delta[o] = (layer.preActivation[o] > 0.f) ? layer.error[o] : 0.0f;
+			}
+		}
+		if (inputError) {
+			std::fill(inputError, inputError + In, 0.0f);
+			for (int o = 0; o < Out; ++o) {
+				const float* w = &layer.weights[o * In];
+				for (int i = 0; i < In; ++i) {
+					inputError[i] += w[i] * layer.delta[o];
+				}
+			}
+		}
+		for (int o = 0; o < Out; ++o) {
+			float step = learningRate * layer.delta[o];
+			float* w = &layer.weights[o * In];
+			for (int i = 0; i < In; ++i) {
+				w[i] -= step * x[i];
+			}
+			layer.biases[o] -= step;
+		}
+	}
+
+	// Copies one layer from the checkpoint layout (per neuron: weights, bias)
+	const float* load(const float* params) {
+		for (int o = 0; o < Out; ++o) {
+			std::copy(params, params + In, &layer.weights[o * In]);
+			params += In;
+			layer.biases[o] = *params++;
+		}
+		return next.load(params);
+	}
+};
+
+template <int First, int... Rest>
+class StaticNetwork
+{
+private:
+	StaticStack<First, Rest...> stack;
+
+public:
+	static constexpr int inputSize = First;
+	static constexpr int outputSize = StaticStack<First, Rest...>::outputSize;
+
+	// Copies weights from a checkpoint; the topology is checked once here instead of on every pass
+	bool setCheckpoint(const Checkpoint& checkpoint) {
+		const int sizes[] = { First, Rest... };
+		if (checkpoint.sizes.size() != sizeof...(Rest) + 1 ||
+			!std::equal(checkpoint.sizes.begin(), checkpoint.sizes.end(), sizes) ||
+			std::any_of(checkpoint.types.begin(), checkpoint.types.end(), [](int type) { return type != static_cast<int>(LayerType::Dense); }) ||
+			(checkpoint.activations.size() > 1 && std::any_of(checkpoint.activations.begin(), checkpoint.activations.end() - 1,
+				[](int activation) { return activation != static_cast<int>(Activation::ReLU); })) ||
+			checkpoint.params.size() != checkpoint.expectedParamCount()) {
+			return false;
+		}
+		stack.load(checkpoint.params.data());
+		return true;
+	}
+
+	// Returns a pointer to outputSize softmax probabilities (valid until the next call)
+	const float* forwardPass(const float* input) {
+		return stack.forward(input);
+	}
+
+	// SGD step with cross-entropy loss, must follow forwardPass on the same input
+	void backPropagation(const float* input, int label, float learningRate) {
+		stack.backward(input, nullptr, label, learningRate);
+	}
+
+	int predict(const float* input) {
+		const float* out = forwardPass(input);
+		return static_cast<int>(std::max_element(out, out + outputSize) - out);
+	}
+};
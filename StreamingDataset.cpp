@@ -0,0 +1,314 @@
+#include "StreamingDataset.h"
+#include "MappedDataset.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+StreamingDataset::StreamingDataset(size_t chunkSamples, size_t shuffleSamples)
+    : chunkSamples(std::max<size_t>(1, chunkSamples)), shuffleCapacity(std::max<size_t>(1, shuffleSamples)), random(0, 0) {}
+
+StreamingDataset::~StreamingDataset() {
+    close();
+}
+
+bool StreamingDataset::open(const std::string& path, float holdoutFraction) {
+    TraceScope trace("Open stream", "io");
+    close();
+    std::uint64_t length = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Error opening dataset " << path << std::endl;
+        return false;
+    }
+    fileHandle = file;
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    length = static_cast<std::uint64_t>(fileSize.QuadPart);
+#else
+    fileDescriptor = ::open(path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        std::cerr << "Error opening dataset " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    fstat(fileDescriptor, &info);
+    length = static_cast<std::uint64_t>(info.st_size);
+#endif
+    std::uint32_t headerWords[DATASET_HEADER / sizeof(std::uint32_t)] = {};
+    size_t available = static_cast<size_t>(std::min<std::uint64_t>(length, sizeof(headerWords)));
+    DatasetHeader header;
+    if (!readBytes(0, headerWords, available) || !parseDatasetHeader(headerWords, available, header) || length != header.fileSize()) {
+        std::cerr << path << " is not a valid dataset file" << std::endl;
+        close();
+        return false;
+    }
+    count = header.count;
+    pixelCount = header.pixels;
+    labelOffset = header.bytes;
+    dataShape = header.shape;
+    if (dataShape.classes == 0) {
+        // Version 1 files do not store the class count, the labels are one byte per sample and read once
+        std::vector<std::uint8_t> labels(std::min(count, chunkSamples));
+        for (size_t begin = 0; begin < count; begin += labels.size()) {
+            size_t samples = std::min(labels.size(), count - begin);
+            if (!readBytes(labelOffset + begin, labels.data(), samples)) break;
+            dataShape.classes = std::max<int>(dataShape.classes, *std::max_element(labels.begin(), labels.begin() + samples) + 1);
+        }
+    }
+    size_t holdout = std::min(STREAM_MAX_HOLDOUT, static_cast<size_t>(count * std::max(0.0f, holdoutFraction)));
+    streamed = count - std::min(holdout, count);
+    if (streamed == 0) {
+        std::cerr << path << " has no samples left to train on" << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void StreamingDataset::close() {
+    finishRead();
+#ifdef _WIN32
+    if (fileHandle) CloseHandle(fileHandle);
+    fileHandle = nullptr;
+#else
+    if (fileDescriptor >= 0) ::close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+    count = streamed = pixelCount = 0;
+    labelOffset = 0;
+    dataShape = DataShape();
+    chunkOrder.clear();
+    nextChunk = 0;
+    current.count = current.position = 0;
+    buffered = 0;
+}
+
+bool StreamingDataset::isOpen() const {
+#ifdef _WIN32
+    return fileHandle != nullptr;
+#else
+    return fileDescriptor >= 0;
+#endif
+}
+
+size_t StreamingDataset::size() const {
+    return streamed;
+}
+
+size_t StreamingDataset::inputSize() const {
+    return pixelCount;
+}
+
+DataShape StreamingDataset::shape() const {
+    return dataShape;
+}
+
+bool StreamingDataset::failed() const {
+    return readFailed;
+}
+
+bool StreamingDataset::readBytes(std::uint64_t offset, void* out, size_t bytes) const {
+    std::uint8_t* target = static_cast<std::uint8_t*>(out);
+    while (bytes > 0) {
+#ifdef _WIN32
+        OVERLAPPED position = {};
+        position.Offset = static_cast<DWORD>(offset);
+        position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD request = static_cast<DWORD>(std::min<size_t>(bytes, 1u << 30)), done = 0;
+        if (!ReadFile(static_cast<HANDLE>(fileHandle), target, request, &done, &position) || done == 0) return false;
+#else
+        ssize_t done = pread(fileDescriptor, target, bytes, static_cast<off_t>(offset));
+        if (done < 0 && errno == EINTR) continue;
+        if (done <= 0) return false;
+#endif
+        target += done;
+        offset += static_cast<std::uint64_t>(done);
+        bytes -= static_cast<size_t>(done);
+    }
+    return true;
+}
+
+void StreamingDataset::readAhead(std::uint64_t offset, size_t bytes) const {
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+    posix_fadvise(fileDescriptor, static_cast<off_t>(offset), static_cast<off_t>(bytes), POSIX_FADV_WILLNEED);
+#else
+    (void)offset;
+    (void)bytes; // Windows has no hint for plain file reads, its cache manager reads ahead on its own
+#endif
+}
+
+// Labels and pixels are two separate blocks of the file, so a chunk is two reads
+bool StreamingDataset::readRange(size_t begin, size_t end, Chunk& out) const {
+    size_t samples = end - begin;
+    out.labels.resize(samples);
+    out.pixels.resize(samples * pixelCount);
+    out.count = 0;
+    out.position = 0;
+    if (!readBytes(labelOffset + begin, out.labels.data(), samples) ||
+        !readBytes(labelOffset + count + static_cast<std::uint64_t>(begin) * pixelCount, out.pixels.data(), samples * pixelCount)) {
+        return false;
+    }
+    out.count = samples;
+    return true;
+}
+
+void StreamingDataset::startRead() {
+    if (nextChunk >= chunkOrder.size()) return;
+    size_t begin = chunkOrder[nextChunk++] * chunkSamples;
+    size_t end = std::min(begin + chunkSamples, streamed);
+    // The chunk after this one is announced now, so the OS reads it while this one is consumed
+    if (nextChunk < chunkOrder.size()) {
+        size_t nextBegin = chunkOrder[nextChunk] * chunkSamples;
+        size_t nextSamples = std::min(nextBegin + chunkSamples, streamed) - nextBegin;
+        readAhead(labelOffset + nextBegin, nextSamples);
+        readAhead(labelOffset + count + static_cast<std::uint64_t>(nextBegin) * pixelCount, nextSamples * pixelCount);
+    }
+    pendingRead = std::async(std::launch::async, [this, begin, end]() {
+        TraceScope trace("Read chunk", "io");
+        return readRange(begin, end, ahead);
+    });
+}
+
+void StreamingDataset::finishRead() {
+    if (pendingRead.valid()) pendingRead.wait();
+}
+
+bool StreamingDataset::pullSample(size_t slot) {
+    if (current.position == current.count) {
+        if (!pendingRead.valid()) return false;
+        if (!pendingRead.get()) {
+            readFailed = true;
+            return false;
+        }
+        std::swap(current, ahead);
+        startRead(); // Double buffering: the next chunk is read while this one is consumed
+        if (current.count == 0) return false;
+    }
+    bufferLabels[slot] = current.labels[current.position];
+    std::memcpy(bufferPixels.data() + slot * pixelCount, current.pixels.data() + current.position * pixelCount, pixelCount);
+    current.position++;
+    return true;
+}
+
+void StreamingDataset::startEpoch(RandomStream& generator) {
+    finishRead();
+    pendingRead = std::future<bool>();
+    chunkOrder.resize((streamed + chunkSamples - 1) / chunkSamples);
+    for (size_t i = 0; i < chunkOrder.size(); ++i) chunkOrder[i] = i;
+    std::shuffle(chunkOrder.begin(), chunkOrder.end(), generator);
+    random = generator.split();
+    nextChunk = 0;
+    current.count = current.position = 0;
+    buffered = 0;
+    readFailed = false;
+    bufferLabels.resize(shuffleCapacity);
+    bufferPixels.resize(shuffleCapacity * pixelCount);
+    startRead();
+}
+
+size_t StreamingDataset::nextBatch(Dataset& batch, size_t samples) {
+    batch.clear();
+    batch.setShape(dataShape);
+    while (batch.size() < samples) {
+        // The buffer is filled up first, afterwards every slot that is handed out is refilled right away
+        while (buffered < shuffleCapacity && pullSample(buffered)) buffered++;
+        if (buffered == 0) break;
+        size_t slot = static_cast<size_t>(random.uniformInt(static_cast<int>(buffered)));
+        batch.add(bufferLabels[slot], bufferPixels.data() + slot * pixelCount, pixelCount);
+        if (!pullSample(slot)) {
+            // End of the epoch: the buffer drains, the last sample takes the free slot
+            --buffered;
+            bufferLabels[slot] = bufferLabels[buffered];
+            std::memcpy(bufferPixels.data() + slot * pixelCount, bufferPixels.data() + buffered * pixelCount, pixelCount);
+        }
+    }
+    return batch.size();
+}
+
+Dataset StreamingDataset::holdoutSet() const {
+    Dataset holdout;
+    holdout.setShape(dataShape);
+    Chunk chunk;
+    if (streamed == count || !readRange(streamed, count, chunk)) return holdout;
+    for (size_t i = 0; i < chunk.count; ++i) {
+        holdout.add(chunk.labels[i], chunk.pixels.data() + i * pixelCount, pixelCount);
+    }
+    return holdout;
+}
+
+// Two passes over the CSV: the first counts the rows and classes, because the header and labels are stored before the pixels.
+// Pixels are then written in file order and labels in blocks at their position, so memory use stays flat.
+bool StreamingDataset::convertCsv(const std::string& csvPath, const std::string& binaryPath, size_t expectedPixels) {
+    TraceScope trace("Convert dataset", "io");
+    std::ifstream input(csvPath);
+    if (!input) {
+        std::cerr << "Error loading dataset " << csvPath << std::endl;
+        return false;
+    }
+    std::string line;
+    std::vector<std::uint8_t> row;
+    int label = 0;
+    size_t rows = 0;
+    DataShape shape;
+    while (std::getline(input, line)) {
+        if (!parseCsvLine(line, label, row) || row.empty()) continue;
+        if (expectedPixels == 0) expectedPixels = row.size();
+        if (row.size() != expectedPixels) continue;
+        rows++;
+        shape.classes = std::max(shape.classes, label + 1);
+    }
+    if (rows == 0 || rows > 0xFFFFFFFFu) {
+        std::cerr << csvPath << " has no usable samples" << std::endl;
+        return false;
+    }
+
+    std::ofstream output(binaryPath, std::ios::binary);
+    if (!output) {
+        std::cerr << "Error writing dataset " << binaryPath << std::endl;
+        return false;
+    }
+    shape.input = inferShape(expectedPixels);
+    std::uint32_t header[DATASET_HEADER / sizeof(std::uint32_t)];
+    makeDatasetHeader(rows, shape, header);
+    output.write(reinterpret_cast<const char*>(header), sizeof(header));
+    output.seekp(static_cast<std::streamoff>(DATASET_HEADER + rows));
+
+    input.clear();
+    input.seekg(0);
+    std::vector<std::uint8_t> labels;
+    size_t labelsWritten = 0;
+    auto flushLabels = [&]() {
+        std::streampos pixelPosition = output.tellp();
+        output.seekp(static_cast<std::streamoff>(DATASET_HEADER + labelsWritten));
+        output.write(reinterpret_cast<const char*>(labels.data()), labels.size());
+        output.seekp(pixelPosition);
+        labelsWritten += labels.size();
+        labels.clear();
+    };
+    while (std::getline(input, line) && labelsWritten + labels.size() < rows) {
+        if (!parseCsvLine(line, label, row) || row.size() != expectedPixels) continue;
+        labels.push_back(static_cast<std::uint8_t>(label));
+        output.write(reinterpret_cast<const char*>(row.data()), row.size());
+        if (labels.size() == STREAM_CHUNK_SAMPLES) flushLabels();
+    }
+    flushLabels();
+    if (!output || labelsWritten != rows) {
+        std::cerr << "Error writing dataset " << binaryPath << std::endl;
+        return false;
+    }
+    std::cout << "Converted " << rows << " samples of " << csvPath << " to " << binaryPath << std::endl;
+    return true;
+}
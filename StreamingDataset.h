@@ -0,0 +1,81 @@
+#pragma once
+#include "Dataset.h"
+#include "Random.h"
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+const size_t STREAM_CHUNK_SAMPLES = 4096; // Samples per read (about 3 MB of MNIST-sized images)
+const size_t STREAM_SHUFFLE_SAMPLES = 16384; // Capacity of the shuffle buffer
+const size_t STREAM_MAX_HOLDOUT = 10000; // Upper bound of the in-memory validation set taken from a stream
+
+// Training samples streamed from a binary dataset file (MappedDataset layout) for datasets larger than RAM.
+// Chunks of consecutive samples are read with positioned reads in a shuffled order; while the trainer consumes
+// one chunk the next is read on another thread (double buffering) and the one after it is announced to the OS
+// as read-ahead. Samples pass through a bounded shuffle buffer: each output is a random buffer slot, refilled
+// from the chunk stream, so the order is shuffled across chunks without holding the file.
+// Memory use is two chunks plus the shuffle buffer, independent of the file size.
+class StreamingDataset
+{
+private:
+	struct Chunk
+	{
+		std::vector<std::uint8_t> labels;
+		std::vector<std::uint8_t> pixels;
+		size_t count = 0; // Samples in the chunk
+		size_t position = 0; // Samples already moved into the shuffle buffer
+	};
+
+	size_t chunkSamples;
+	size_t shuffleCapacity;
+	size_t count = 0; // Samples in the file
+	size_t streamed = 0; // Samples streamed per epoch (the rest is the holdout)
+	size_t pixelCount = 0; // Pixels per sample
+	std::uint64_t labelOffset = 0; // Header size, the labels start here
+	DataShape dataShape; // From the header
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+
+	std::vector<size_t> chunkOrder; // Chunk indices of the current epoch
+	size_t nextChunk = 0; // Position in chunkOrder of the next chunk to read
+	Chunk current; // Chunk being consumed
+	Chunk ahead; // Chunk being read in the background
+	std::future<bool> pendingRead; // Read of ahead
+	std::vector<std::uint8_t> bufferLabels; // Shuffle buffer
+	std::vector<std::uint8_t> bufferPixels;
+	size_t buffered = 0; // Samples in the shuffle buffer
+	RandomStream random; // Picks shuffle buffer slots
+	bool readFailed = false;
+
+	bool readBytes(std::uint64_t offset, void* out, size_t bytes) const; // Positioned read, false on errors or end of file
+	void readAhead(std::uint64_t offset, size_t bytes) const; // Hint the OS to start reading a range
+	bool readRange(size_t begin, size_t end, Chunk& out) const; // Samples [begin, end) into a chunk
+	void startRead(); // Read the next chunk of chunkOrder into ahead on another thread
+	bool pullSample(size_t slot); // Move the next sample of the chunk stream into a shuffle buffer slot, false at the end of the epoch
+	void finishRead(); // Wait for the background read
+
+public:
+	StreamingDataset(size_t chunkSamples = STREAM_CHUNK_SAMPLES, size_t shuffleSamples = STREAM_SHUFFLE_SAMPLES);
+	~StreamingDataset();
+	StreamingDataset(const StreamingDataset&) = delete;
+	StreamingDataset& operator=(const StreamingDataset&) = delete;
+
+	bool open(const std::string& path, float holdoutFraction); // Check the header; the last holdoutFraction of the samples (at most STREAM_MAX_HOLDOUT) is not streamed
+	void close();
+	bool isOpen() const;
+	size_t size() const; // Samples streamed per epoch
+	size_t inputSize() const; // Pixels per sample
+	DataShape shape() const; // Sample shape and class count from the header
+	Dataset holdoutSet() const; // The held-out samples, read into memory once (validation)
+	void startEpoch(RandomStream& generator); // New chunk order, empty shuffle buffer, starts reading
+	size_t nextBatch(Dataset& batch, size_t samples); // Replace batch with up to samples shuffled samples, 0 at the end of the epoch
+	bool failed() const; // True if a read failed during the epoch (the epoch ends early)
+
+	// CSV to binary dataset without loading the CSV into memory ("label,pixel,..." lines, other sizes are skipped,
+	// expectedPixels 0: the first line fixes the size). The header stores the inferred shape and the class count.
+	static bool convertCsv(const std::string& csvPath, const std::string& binaryPath, size_t expectedPixels = 0);
+};
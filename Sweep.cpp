@@ -0,0 +1,233 @@
+#include "Sweep.h"
+#include "Network.h"
+#include "Random.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <thread>
+
+// Splits text at every separator
+static std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator)) {
+        if (!part.empty()) parts.push_back(part);
+    }
+    return parts;
+}
+
+bool parseTopology(const std::string& spec, SweepRun& run) {
+    run.topology = spec;
+    run.sizes.clear();
+    run.types.clear();
+    for (auto& token : split(spec, '-')) {
+        if (token == "m" || token == "a") {
+            run.types.push_back(token == "m" ? LayerType::MaxPool : LayerType::AvgPool);
+            run.sizes.push_back(1);
+        }
+        else {
+            bool conv = token[0] == 'c';
+            int size = std::atoi(token.c_str() + (conv ? 1 : 0));
+            if (size <= 0) return false;
+            run.types.push_back(conv ? LayerType::Conv2D : LayerType::Dense);
+            run.sizes.push_back(size);
+        }
+    }
+    return !run.types.empty() && run.types.back() == LayerType::Dense;
+}
+
+// Fraction of the validation samples predicted correctly
+static float validationAccuracy(Network& network, const DatasetView& dataset, size_t first, std::pair<int, std::vector<float>>& sample) {
+    int correct = 0;
+    for (size_t i = first; i < dataset.size(); ++i) {
+        dataset.sample(i, sample);
+        auto out = network.forwardPass(sample);
+        if (network.predict(out) == sample.first) correct++;
+    }
+    return static_cast<float>(correct) / (dataset.size() - first);
+}
+
+// Trains one configuration on the first trainCount samples, validating a few times per epoch
+static void trainRun(SweepRun& run, Network& network, const DatasetView& dataset, size_t trainCount, float target, RandomStream generator) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<size_t> order(trainCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::pair<int, std::vector<float>> sample;
+    const size_t evalEvery = std::max<size_t>(1, trainCount / 4);
+    size_t seen = 0;
+
+    for (int epoch = 0; epoch < run.epochs; ++epoch) {
+        std::shuffle(order.begin(), order.end(), generator);
+        for (size_t i = 0; i < trainCount; ++i) {
+            dataset.sample(order[i], sample);
+            network.forwardPass(sample);
+            network.backPropagation(sample);
+            if (++seen % evalEvery != 0 && i + 1 != trainCount) continue;
+
+            float accuracy = validationAccuracy(network, dataset, trainCount, sample);
+            if (accuracy > run.bestAccuracy) {
+                run.bestAccuracy = accuracy;
+                run.best = network.getCheckpoint();
+            }
+            if (run.secondsToTarget < 0 && accuracy >= target) {
+                run.secondsToTarget = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                run.samplesToTarget = seen;
+            }
+        }
+    }
+    run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void runSweep(const DatasetView& dataset, const std::vector<std::string>& args) {
+    std::map<std::string, std::string> spec = {
+        { "lr", "0.0005,0.001,0.002" }, { "epochs", "1" }, { "layers", "32-10,64-10" }, { "random", "0" },
+        { "threads", std::to_string(std::max(1u, std::thread::hardware_concurrency())) },
+        { "val", "0.1" }, { "target", "0.9" }, { "seed", std::to_string(getRandomSeed()) }, { "out", "sweep_best.ckpt" }
+    };
+    for (auto& arg : args) {
+        size_t equals = arg.find('=');
+        if (equals == std::string::npos || !spec.count(arg.substr(0, equals))) {
+            std::cout << "Unknown sweep option " << arg << ", see Sweep.h for the options." << std::endl;
+            return;
+        }
+        spec[arg.substr(0, equals)] = arg.substr(equals + 1);
+    }
+
+    int randomCount = std::atoi(spec["random"].c_str());
+    int threadCount = std::max(1, std::atoi(spec["threads"].c_str()));
+    float valFraction = static_cast<float>(std::atof(spec["val"].c_str()));
+    float target = static_cast<float>(std::atof(spec["target"].c_str()));
+    std::uint64_t seed = std::strtoull(spec["seed"].c_str(), nullptr, 10);
+    setRandomSeed(seed); // Configurations, initial weights and shuffling all follow from the seed
+    size_t valCount = static_cast<size_t>(dataset.size() * valFraction);
+    size_t trainCount = dataset.size() - valCount;
+    if (valCount == 0 || trainCount == 0) {
+        std::cout << "val must leave samples for both training and validation." << std::endl;
+        return;
+    }
+
+    // Parse the value lists of every hyperparameter
+    std::vector<SweepRun> topologies;
+    for (auto& layers : split(spec["layers"], ',')) {
+        SweepRun run;
+        if (!parseTopology(layers, run)) {
+            std::cout << "Invalid topology " << layers << ", the last layer must be dense." << std::endl;
+            return;
+        }
+        topologies.push_back(run);
+    }
+    std::vector<int> epochList;
+    for (auto& value : split(spec["epochs"], ',')) epochList.push_back(std::max(1, std::atoi(value.c_str())));
+    std::vector<float> lrList;
+    bool lrRange = spec["lr"].find(':') != std::string::npos;
+    for (auto& value : split(spec["lr"], lrRange ? ':' : ',')) lrList.push_back(static_cast<float>(std::atof(value.c_str())));
+    if (topologies.empty() || epochList.empty() || lrList.empty() || (lrRange && lrList.size() != 2)) {
+        std::cout << "Every sweep option needs at least one value." << std::endl;
+        return;
+    }
+    if (lrRange && randomCount <= 0) {
+        std::cout << "A learning rate range needs random=N." << std::endl;
+        return;
+    }
+
+    // Grid: every combination; random: randomCount draws
+    std::vector<SweepRun> runs;
+    RandomStream& generator = threadRandom();
+    if (randomCount > 0) {
+        for (int i = 0; i < randomCount; ++i) {
+            SweepRun run = topologies[std::uniform_int_distribution<size_t>(0, topologies.size() - 1)(generator)];
+            run.epochs = epochList[std::uniform_int_distribution<size_t>(0, epochList.size() - 1)(generator)];
+            if (lrRange) {
+                std::uniform_real_distribution<float> logRate(std::log(lrList[0]), std::log(lrList[1]));
+                run.learningRate = std::exp(logRate(generator));
+            }
+            else {
+                run.learningRate = lrList[std::uniform_int_distribution<size_t>(0, lrList.size() - 1)(generator)];
+            }
+            runs.push_back(run);
+        }
+    }
+    else {
+        for (auto& topology : topologies) {
+            for (int epochCount : epochList) {
+                for (float rate : lrList) {
+                    SweepRun run = topology;
+                    run.epochs = epochCount;
+                    run.learningRate = rate;
+                    runs.push_back(run);
+                }
+            }
+        }
+    }
+
+    // Networks print while initializing, so build and validate them on this thread first; the input shape comes from the dataset
+    DataShape shape = dataset.shape();
+    std::vector<std::unique_ptr<Network>> networks;
+    for (auto& run : runs) {
+        networks.emplace_back(new Network(run.sizes, run.learningRate, run.epochs, run.types, {}, shape.input));
+        if (!networks.back()->isReady() || run.sizes.back() < shape.classes) {
+            std::cout << "Topology " << run.topology << " does not fit the " << shape.input.channels << "x" << shape.input.height << "x"
+                << shape.input.width << " input and " << shape.classes << " classes." << std::endl;
+            return;
+        }
+    }
+
+    std::cout << "Sweeping " << runs.size() << " configurations on " << threadCount << " threads (seed " << seed << ", "
+        << trainCount << " training / " << valCount << " validation samples)" << std::endl;
+
+    // Workers take the next configuration until none is left; all of them read the same mapping
+    std::atomic<size_t> next(0);
+    std::mutex printMutex;
+    auto sweepStart = std::chrono::steady_clock::now();
+    auto worker = [&]() {
+        for (size_t i = next++; i < runs.size(); i = next++) {
+            trainRun(runs[i], *networks[i], dataset, trainCount, target, randomStream(i));
+            std::lock_guard<std::mutex> lock(printMutex);
+            std::cout << "Finished " << runs[i].topology << " lr=" << runs[i].learningRate << " epochs=" << runs[i].epochs
+                << ": validation accuracy " << runs[i].bestAccuracy << std::endl;
+        }
+    };
+    // Runs share the task scheduler with the layer loops inside them; this thread takes one share itself
+    std::vector<std::future<void>> jobs;
+    for (int t = 1; t < threadCount; ++t) jobs.push_back(taskScheduler().submit(worker));
+    worker();
+    for (auto& job : jobs) job.get();
+    double sweepSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - sweepStart).count();
+
+    // Best validation accuracy first, ties broken by the faster time-to-accuracy
+    std::sort(runs.begin(), runs.end(), [](const SweepRun& a, const SweepRun& b) {
+        if (a.bestAccuracy != b.bestAccuracy) return a.bestAccuracy > b.bestAccuracy;
+        if ((a.secondsToTarget < 0) != (b.secondsToTarget < 0)) return b.secondsToTarget < 0;
+        return a.secondsToTarget < b.secondsToTarget;
+    });
+
+    std::cout << std::endl << "Rank  Topology          lr         Epochs  ValAcc   Time to " << target << " (samples)  Total s" << std::endl;
+    for (size_t i = 0; i < runs.size(); ++i) {
+        const SweepRun& run = runs[i];
+        std::ostringstream toTarget;
+        if (run.secondsToTarget < 0) toTarget << "-";
+        else toTarget << std::fixed << std::setprecision(2) << run.secondsToTarget << "s (" << run.samplesToTarget << ")";
+        std::cout << std::left << std::setw(6) << i + 1 << std::setw(18) << run.topology << std::setw(11) << std::setprecision(4) << run.learningRate
+            << std::setw(8) << run.epochs << std::setw(9) << std::fixed << std::setprecision(4) << run.bestAccuracy
+            << std::setw(25) << toTarget.str() << std::setprecision(2) << run.seconds << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+    std::cout << std::right << std::setprecision(6);
+    std::cout << "Sweep took " << sweepSeconds << " s. Time-to-accuracy includes contention between parallel runs." << std::endl;
+
+    if (!runs.empty() && !runs[0].best.params.empty() && saveCheckpoint(spec["out"], runs[0].best)) {
+        std::cout << "Best checkpoint (" << runs[0].topology << ", lr=" << runs[0].learningRate << ") saved to " << spec["out"] << std::endl;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "Dataset.h"
+#include "Checkpoint.h"
+#include "Shape.h"
+#include <string>
+#include <vector>
+
+// Hyperparameter sweep (run the app with --sweep [key=value ...])
+//
+//   lr=0.0005,0.001,0.002   learning rates (random mode also accepts a log-uniform range lo:hi)
+//   epochs=1,2              epoch counts
+//   layers=32-10,c4-m-10    topologies: N dense, cN convolution, m max pool, a average pool
+//   random=N                draw N random configurations instead of the full grid
+//   threads=N               parallel trainings (default: hardware threads)
+//   val=0.1                 fraction of the training file held out for validation
+//   target=0.9              validation accuracy used for time-to-accuracy
+//   seed=N                  seed for configurations, initial weights and shuffling (default: the app seed)
+//   out=sweep_best.ckpt     where the best checkpoint is written
+
+// One training run of the sweep and its results
+struct SweepRun
+{
+	std::string topology; // Layer spec as given on the command line
+	std::vector<int> sizes; // Neuron count of every layer
+	std::vector<LayerType> types; // Type of every layer
+	float learningRate = 0.f;
+	int epochs = 0;
+
+	float bestAccuracy = 0.f; // Best validation accuracy seen during training
+	double secondsToTarget = -1.0; // Wall time until the target accuracy was reached (-1 if never)
+	size_t samplesToTarget = 0; // Training samples until the target accuracy was reached
+	double seconds = 0.0; // Total wall time of the run
+	Checkpoint best; // Weights at the best validation accuracy
+};
+
+// Parses a layer spec such as "c4-m-32-10" into run's topology, sizes and types; false if a token is not understood
+bool parseTopology(const std::string& spec, SweepRun& run);
+
+// Trains every configuration of the spec on the shared dataset and prints them ranked
+void runSweep(const DatasetView& dataset, const std::vector<std::string>& args);
@@ -0,0 +1,193 @@
+#include "TaskScheduler.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+
+// Index of the worker running on this thread in the scheduler that owns it (-1 on other threads)
+thread_local const TaskScheduler* currentScheduler = nullptr;
+thread_local int currentWorker = -1;
+
+TaskScheduler::TaskScheduler(int workers) : stopping(false), queued(0), queuedJobs(0), nextQueue(0) {
+    // On a single hardware thread splitting a loop only adds context switches
+    hardwareLoopThreads = std::min<size_t>(workers + 1, std::max(1u, std::thread::hardware_concurrency()));
+    loopThreads = hardwareLoopThreads;
+    for (int i = 0; i < workers; ++i) {
+        queues.emplace_back(new WorkerQueue());
+    }
+    for (int i = 0; i < workers; ++i) {
+        threads.emplace_back(&TaskScheduler::workerLoop, this, i);
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) thread.join();
+}
+
+int TaskScheduler::workerCount() const {
+    return static_cast<int>(queues.size());
+}
+
+int TaskScheduler::maxLoopThreads() const {
+    return static_cast<int>(hardwareLoopThreads);
+}
+
+void TaskScheduler::setLoopThreads(int threads) {
+    loopThreads = threads > 0 ? std::min<size_t>(threads, hardwareLoopThreads) : hardwareLoopThreads;
+}
+
+void TaskScheduler::push(Task task) {
+    if (queues.empty()) {
+        task(); // No workers, submitted jobs run synchronously
+        return;
+    }
+    int self = (currentScheduler == this) ? currentWorker : -1;
+    int target = self >= 0 ? self : static_cast<int>(nextQueue++ % queues.size());
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->mutex);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    queued++;
+    // Taking the lock orders the notify after a worker's empty check, so the wakeup is not lost
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    wake.notify_one();
+}
+
+void TaskScheduler::pushJob(Task task) {
+    if (queues.empty()) {
+        task(); // No workers, submitted jobs run synchronously
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        jobs.push_back(std::move(task));
+    }
+    queuedJobs++;
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    wake.notify_one();
+}
+
+bool TaskScheduler::popJob(Task& task) {
+    if (queuedJobs == 0) return false;
+    std::lock_guard<std::mutex> lock(jobMutex);
+    if (jobs.empty()) return false;
+    task = std::move(jobs.front());
+    jobs.pop_front();
+    queuedJobs--;
+    return true;
+}
+
+bool TaskScheduler::popOrSteal(int self, Task& task) {
+    if (queued == 0) return false;
+    if (self >= 0) {
+        WorkerQueue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+    // Steal the oldest task of another worker, starting after self so thieves spread out
+    int count = static_cast<int>(queues.size());
+    for (int offset = 1; offset <= count; ++offset) {
+        int victim = ((self >= 0 ? self : 0) + offset) % count;
+        if (victim == self) continue;
+        WorkerQueue& queue = *queues[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::workerLoop(int index) {
+    currentScheduler = this;
+    currentWorker = index;
+    setTraceThreadName("Worker " + std::to_string(index));
+    Task task;
+    while (true) {
+        // Loop chunks first: some thread is waiting for them, while a job's caller only holds a future
+        if (popOrSteal(index, task) || popJob(task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() { return stopping || queued > 0 || queuedJobs > 0; });
+        if (stopping) return;
+    }
+}
+
+void TaskScheduler::parallelFor(size_t begin, size_t end, size_t minChunk, const std::function<void(size_t, size_t)>& body) {
+    size_t count = end > begin ? end - begin : 0;
+    minChunk = std::max<size_t>(1, minChunk);
+    if (count <= minChunk || loopThreads < 2 || queues.empty()) {
+        if (count > 0) body(begin, end);
+        return;
+    }
+
+    // A few chunks per thread, so stealing can even out uneven neurons and busy workers.
+    // A limited loop gets one chunk per thread, so no more threads than allowed work on it.
+    size_t maxChunks = loopThreads < hardwareLoopThreads ? loopThreads : 4 * loopThreads;
+    size_t chunks = std::min(maxChunks, (count + minChunk - 1) / minChunk);
+    size_t chunkSize = (count + chunks - 1) / chunks;
+    chunks = (count + chunkSize - 1) / chunkSize;
+
+    // A throwing chunk must not leave the others running on a returned stack frame: keep the first exception
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto run = [&body, &error, &errorMutex](size_t chunkBegin, size_t chunkEnd) {
+        try {
+            body(chunkBegin, chunkEnd);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+        }
+    };
+    std::atomic<size_t> remaining(chunks - 1);
+    for (size_t c = 1; c < chunks; ++c) {
+        size_t chunkBegin = begin + c * chunkSize;
+        size_t chunkEnd = std::min(end, chunkBegin + chunkSize);
+        push([&run, &remaining, chunkBegin, chunkEnd]() {
+            run(chunkBegin, chunkEnd);
+            remaining--; // Last access to the caller's stack
+        });
+    }
+    run(begin, std::min(end, begin + chunkSize));
+
+    // Help with queued loop chunks (ours or a nested loop's, never a submitted job) until every chunk is done
+    int self = (currentScheduler == this) ? currentWorker : -1;
+    Task task;
+    while (remaining > 0) {
+        if (popOrSteal(self, task)) {
+            task();
+            task = nullptr;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+static int schedulerWorkers = -1; // -1: one per hardware thread minus the main thread
+
+TaskScheduler& taskScheduler() {
+    static TaskScheduler scheduler(schedulerWorkers >= 0 ? schedulerWorkers : std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+    return scheduler;
+}
+
+void setTaskSchedulerWorkers(int workers) {
+    schedulerWorkers = std::max(0, workers);
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool shared by training, evaluation and inference.
+// Every worker owns a deque: it pushes and pops its own tasks at the back (newest first, cache-warm),
+// idle workers steal from the front of other deques (oldest, usually the largest pieces of work).
+// Threads waiting in parallelFor execute queued loop chunks instead of blocking, so parallel loops can nest inside jobs.
+// Submitted jobs wait in a separate FIFO that only idle workers take from: a loop never runs a whole job inline.
+class TaskScheduler
+{
+public:
+	typedef std::function<void()> Task;
+
+	explicit TaskScheduler(int workers);
+	~TaskScheduler();
+	int workerCount() const;
+	int maxLoopThreads() const; // Threads a parallelFor can use at most (workers plus caller, capped by the hardware)
+	void setLoopThreads(int threads); // Limit parallelFor to fewer threads (0: maxLoopThreads), only between parallel loops
+
+	// Runs body(chunkBegin, chunkEnd) over [begin, end) in chunks of at least minChunk items.
+	// Ranges of at most minChunk items run serially on the calling thread. If a chunk throws, the other chunks
+	// still finish and the first exception is rethrown on the calling thread.
+	void parallelFor(size_t begin, size_t end, size_t minChunk, const std::function<void(size_t, size_t)>& body);
+
+	// Queues a long-running job (training run, validation, batch inference) and returns its result as a future
+	template <typename Job>
+	std::future<decltype(std::declval<Job>()())> submit(Job job) {
+		typedef decltype(job()) Result;
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+		std::future<Result> result = task->get_future();
+		pushJob([task]() { (*task)(); });
+		return result;
+	}
+
+private:
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+	std::vector<std::unique_ptr<WorkerQueue>> queues; // One deque per worker
+	std::vector<std::thread> threads;
+	size_t hardwareLoopThreads; // Workers plus caller, capped by the hardware
+	size_t loopThreads; // Threads a parallelFor keeps busy (hardwareLoopThreads unless limited)
+	std::atomic<bool> stopping;
+	std::atomic<int> queued; // Tasks in all deques, lets idle workers sleep
+	std::mutex jobMutex;
+	std::deque<Task> jobs; // Submitted jobs, oldest first
+	std::atomic<int> queuedJobs;
+	std::atomic<unsigned> nextQueue; // Round-robin target for tasks pushed by non-worker threads
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+
+	void push(Task task); // Loop chunk: own deque for workers, round-robin otherwise
+	void pushJob(Task task); // Submitted job
+	bool popOrSteal(int self, Task& task); // Own deque (back) first, then the front of the others
+	bool popJob(Task& task); // Oldest submitted job, idle workers only
+	void workerLoop(int index);
+};
+
+// Process-wide scheduler with one worker per hardware thread (minus the main thread, at least one)
+TaskScheduler& taskScheduler();
+// Worker count of taskScheduler() instead of the default (0 runs everything on the calling thread).
+// Only effective before the first taskScheduler() call, e.g. in processes that share the machine.
+void setTaskSchedulerWorkers(int workers);
@@ -0,0 +1,133 @@
+#include "Trace.h"
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> tracingEnabled(false);
+
+// One complete ("X") event, or a counter ("C") whose duration field holds the value
+struct TraceRecord
+{
+    const char* name;
+    const char* category;
+    double start;
+    double duration;
+    int arg;
+    bool counter;
+};
+
+// Events of one thread. The mutex is only contended while the file is written.
+struct ThreadTrace
+{
+    std::mutex mutex;
+    std::vector<TraceRecord> records;
+    std::string name;
+    int id = 0;
+};
+
+static std::mutex registryMutex;
+static std::vector<std::shared_ptr<ThreadTrace>> threadTraces; // Kept after their threads exit
+static std::atomic<std::int64_t> origin(0); // steady_clock nanoseconds at startTracing
+static std::string tracePath;
+
+// Buffer of the calling thread, registered on first use
+static ThreadTrace& localTrace() {
+    thread_local std::shared_ptr<ThreadTrace> trace;
+    if (!trace) {
+        trace = std::make_shared<ThreadTrace>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        trace->id = static_cast<int>(threadTraces.size()) + 1;
+        threadTraces.push_back(trace);
+    }
+    return *trace;
+}
+
+static std::int64_t nowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double traceClock() {
+    return (nowNanoseconds() - origin.load(std::memory_order_relaxed)) / 1000.0;
+}
+
+void startTracing(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto& trace : threadTraces) {
+            std::lock_guard<std::mutex> traceLock(trace->mutex);
+            trace->records.clear();
+        }
+        tracePath = path;
+    }
+    origin = nowNanoseconds();
+    tracingEnabled = true;
+    std::cout << "Tracing to " << path << std::endl;
+}
+
+void traceEvent(const char* name, const char* category, double start, double duration, int arg) {
+    if (!tracingEnabled.load(std::memory_order_relaxed)) return;
+    ThreadTrace& trace = localTrace();
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    trace.records.push_back({ name, category, start, duration, arg, false });
+}
+
+void traceCounter(const char* name, double time, double value, int arg) {
+    if (!tracingEnabled.load(std::memory_order_relaxed)) return;
+    ThreadTrace& trace = localTrace();
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    trace.records.push_back({ name, "counter", time, value, arg, true });
+}
+
+void setTraceThreadName(const std::string& name) {
+    ThreadTrace& trace = localTrace();
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    trace.name = name;
+}
+
+bool stopTracing() {
+    if (!tracingEnabled.exchange(false)) return false;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::ofstream file(tracePath);
+    if (!file) {
+        std::cerr << "Error writing trace " << tracePath << std::endl;
+        return false;
+    }
+
+    size_t count = 0;
+    bool first = true;
+    file << std::fixed << std::setprecision(3); // Microseconds with nanosecond resolution
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (auto& trace : threadTraces) {
+        std::lock_guard<std::mutex> traceLock(trace->mutex);
+        if (!trace->name.empty()) {
+            file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << trace->id
+                << ",\"args\":{\"name\":\"" << trace->name << "\"}}";
+            first = false;
+        }
+        for (const TraceRecord& record : trace->records) {
+            file << (first ? "\n" : ",\n") << "{\"name\":\"" << record.name << "\",\"cat\":\"" << record.category;
+            if (record.counter) {
+                // The id gives every layer its own counter track
+                file << "\",\"ph\":\"C\",\"pid\":1,\"ts\":" << record.start;
+                if (record.arg >= 0) file << ",\"id\":" << record.arg;
+                file << ",\"args\":{\"value\":" << record.duration << "}}";
+                first = false;
+                continue;
+            }
+            file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << trace->id << ",\"ts\":" << record.start << ",\"dur\":" << record.duration;
+            if (record.arg >= 0) file << ",\"args\":{\"index\":" << record.arg << "}";
+            file << "}";
+            first = false;
+        }
+        count += trace->records.size();
+        trace->records.clear();
+    }
+    file << "\n]}\n";
+    std::cout << "Wrote " << count << " trace events to " << tracePath << std::endl;
+    return static_cast<bool>(file);
+}
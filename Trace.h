@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <string>
+
+// Timeline tracing in the Chrome trace-event format (open the file in Perfetto or chrome://tracing).
+// Run the app with --trace [file] (default trace.json); the file is written when the app exits.
+// Every thread appends finished events to its own buffer, so recording never contends between threads.
+// While tracing is off a TraceScope costs one relaxed atomic load.
+
+extern std::atomic<bool> tracingEnabled;
+
+void startTracing(const std::string& path); // Start recording, stopTracing writes the events to path
+bool stopTracing(); // Stop and write the trace file, false if tracing was not started or the file could not be written
+double traceClock(); // Microseconds since tracing started
+void traceEvent(const char* name, const char* category, double start, double duration, int arg = -1); // Record a finished event
+void traceCounter(const char* name, double time, double value, int arg = -1); // Record a counter value, one track per name and arg
+void setTraceThreadName(const std::string& name); // Label the calling thread in the timeline
+
+// Records the time between construction and destruction (or end()) as one event.
+// name and category must be string literals, arg (e.g. a layer or epoch index) is shown if not negative.
+class TraceScope
+{
+public:
+	TraceScope(const char* name, const char* category, int arg = -1)
+		: name(name), category(category), arg(arg), start(tracingEnabled.load(std::memory_order_relaxed) ? traceClock() : -1.0) {}
+	~TraceScope() { end(); }
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+	void end() {
+		if (start < 0.0) return;
+		traceEvent(name, category, start, traceClock() - start, arg);
+		start = -1.0;
+	}
+
+private:
+	const char* name;
+	const char* category;
+	int arg;
+	double start; // Negative if tracing was off when the scope began
+};
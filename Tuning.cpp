@@ -0,0 +1,222 @@
+#include "Tuning.h"
+#include "Network.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+const size_t TUNING_SAMPLES = 32; // Training steps per timing
+const int TUNING_REPEATS = 3; // Timings per candidate, the fastest counts
+const double TUNING_MIN_GAIN = 0.02; // A candidate must beat the current choice by this fraction (timing noise)
+
+// Host name with only file-name safe characters
+static std::string hostName() {
+    std::string name;
+#ifdef _WIN32
+    char buffer[MAX_COMPUTERNAME_LENGTH + 1] = {};
+    DWORD length = sizeof(buffer);
+    if (GetComputerNameA(buffer, &length)) name = buffer;
+#else
+    char buffer[256] = {};
+    if (gethostname(buffer, sizeof(buffer) - 1) == 0) name = buffer;
+#endif
+    for (char& c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_') c = '_';
+    }
+    return name.empty() ? "host" : name;
+}
+
+std::string tuningFilePath() {
+    return "kernel_tuning_" + hostName() + ".txt";
+}
+
+std::string topologyKey(const Checkpoint& checkpoint) {
+    std::ostringstream key;
+    key << checkpoint.sizes[0] << ":";
+    for (size_t i = 1; i < checkpoint.sizes.size(); ++i) {
+        LayerType type = (i - 1 < checkpoint.types.size()) ? static_cast<LayerType>(checkpoint.types[i - 1]) : LayerType::Dense;
+        if (i > 1) key << "-";
+        if (type == LayerType::MaxPool) key << "m";
+        else if (type == LayerType::AvgPool) key << "a";
+        else key << (type == LayerType::Conv2D ? "c" : "") << checkpoint.sizes[i];
+    }
+    return key.str();
+}
+
+// "topology key=value ..." with every field of KernelTuning
+static std::string formatEntry(const std::string& topology, const KernelTuning& tuning) {
+    std::ostringstream line;
+    line << topology << " gemmBlockN=" << tuning.gemmBlockN << " gemmBlockK=" << tuning.gemmBlockK << " dotUnroll=" << tuning.dotUnroll
+        << " threads=" << tuning.threads << " parallelMinWork=" << tuning.parallelMinWork << " sparseDensity=" << tuning.sparseDensity
+        << " backwardDensity=" << tuning.backwardDensity;
+    return line.str();
+}
+
+bool loadTuning(const std::string& path, const std::string& topology, KernelTuning& tuning) {
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string key, field;
+        if (!(stream >> key) || key != topology) continue;
+        KernelTuning loaded;
+        while (stream >> field) {
+            size_t equals = field.find('=');
+            if (equals == std::string::npos) return false;
+            std::string name = field.substr(0, equals);
+            const char* value = field.c_str() + equals + 1;
+            if (name == "gemmBlockN") loaded.gemmBlockN = std::atoi(value);
+            else if (name == "gemmBlockK") loaded.gemmBlockK = std::atoi(value);
+            else if (name == "dotUnroll") loaded.dotUnroll = std::atoi(value);
+            else if (name == "threads") loaded.threads = std::atoi(value);
+            else if (name == "parallelMinWork") loaded.parallelMinWork = std::strtoull(value, nullptr, 10);
+            else if (name == "sparseDensity") loaded.sparseDensity = static_cast<float>(std::atof(value));
+            else if (name == "backwardDensity") loaded.backwardDensity = static_cast<float>(std::atof(value));
+        }
+        tuning = loaded;
+        return true;
+    }
+    return false;
+}
+
+bool saveTuning(const std::string& path, const std::string& topology, const KernelTuning& tuning) {
+    // Keep the entries of other topologies
+    std::vector<std::string> lines;
+    {
+        std::ifstream file(path);
+        std::string line, key;
+        while (std::getline(file, line)) {
+            std::istringstream stream(line);
+            if (line.empty() || line[0] == '#' || !(stream >> key) || key == topology) continue;
+            lines.push_back(line);
+        }
+    }
+    lines.push_back(formatEntry(topology, tuning));
+
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Error writing kernel tuning " << path << std::endl;
+        return false;
+    }
+    file << "# Kernel tuning of " << hostName() << ", " << std::thread::hardware_concurrency()
+        << " hardware threads. Delete a line or run with --retune to measure again." << std::endl;
+    for (auto& line : lines) file << line << std::endl;
+    return static_cast<bool>(file);
+}
+
+void applyTuning(const KernelTuning& tuning) {
+    setKernelTuning(tuning);
+    taskScheduler().setLoopThreads(tuning.threads);
+}
+
+void printTuning(const KernelTuning& tuning) {
+    std::cout << "Kernel tuning: gemm blocks ";
+    if (tuning.gemmBlockN > 0 || tuning.gemmBlockK > 0) {
+        std::cout << (tuning.gemmBlockK > 0 ? std::to_string(tuning.gemmBlockK) : "all") << " deep x "
+            << (tuning.gemmBlockN > 0 ? std::to_string(tuning.gemmBlockN) : "all") << " wide";
+    }
+    else {
+        std::cout << "off";
+    }
+    std::cout << ", dot unroll " << tuning.dotUnroll << ", "
+        << (tuning.threads > 0 ? std::to_string(tuning.threads) : std::to_string(taskScheduler().maxLoopThreads())) << " threads, "
+        << tuning.parallelMinWork << " multiply-adds per chunk, sparse inputs ";
+    if (tuning.sparseDensity > 0.f) std::cout << "below " << tuning.sparseDensity * 100.f << "% density";
+    else std::cout << "off";
+    std::cout << " (backward ";
+    if (tuning.backwardDensity > 0.f) std::cout << "below " << tuning.backwardDensity * 100.f << "%)";
+    else std::cout << "off)";
+    std::cout << std::endl;
+}
+
+// Seconds per training step with the given parameters, fastest of TUNING_REPEATS passes
+static double timeSteps(Network& network, const DatasetView& samples, size_t count, const KernelTuning& tuning) {
+    applyTuning(tuning);
+    std::pair<int, std::vector<float>> sample;
+    double best = 0.0;
+    for (int repeat = 0; repeat <= TUNING_REPEATS; ++repeat) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            samples.sample(i, sample);
+            network.forwardPass(sample);
+            network.backPropagation(sample);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (repeat == 1 || (repeat > 1 && seconds < best)) best = seconds; // Pass 0 warms the caches up
+    }
+    return best / count;
+}
+
+// Candidate values of one parameter are tried with the others fixed (coordinate descent)
+template <typename T>
+static void tuneParameter(T KernelTuning::*field, const std::vector<T>& candidates, Network& network, const DatasetView& samples,
+    size_t count, KernelTuning& best, double& bestSeconds) {
+    for (const T& value : candidates) {
+        if (value == best.*field) continue;
+        KernelTuning candidate = best;
+        candidate.*field = value;
+        double seconds = timeSteps(network, samples, count, candidate);
+        if (seconds < bestSeconds * (1.0 - TUNING_MIN_GAIN)) {
+            best = candidate;
+            bestSeconds = seconds;
+        }
+    }
+}
+
+KernelTuning autotune(const Checkpoint& checkpoint, const DatasetView& samples) {
+    // Learning rate 0 keeps the weights, and with them the sparsity of the activations, fixed while timing
+    Network network(checkpoint, 0.0f, 1);
+    size_t count = std::min(samples.size(), TUNING_SAMPLES);
+    KernelTuning best;
+    if (count == 0) return best;
+    double defaultSeconds = timeSteps(network, samples, count, best);
+    double bestSeconds = defaultSeconds;
+
+    tuneParameter(&KernelTuning::sparseDensity, { 0.25f, 0.5f, 0.75f, 1.0f }, network, samples, count, best, bestSeconds);
+    tuneParameter(&KernelTuning::backwardDensity, { 0.f, 0.25f, 0.75f, 1.0f }, network, samples, count, best, bestSeconds);
+    tuneParameter(&KernelTuning::dotUnroll, { 2, 4, 8 }, network, samples, count, best, bestSeconds);
+    bool hasConvolution = std::find(checkpoint.types.begin(), checkpoint.types.end(), static_cast<int>(LayerType::Conv2D)) != checkpoint.types.end();
+    if (hasConvolution) {
+        tuneParameter(&KernelTuning::gemmBlockN, { 64, 128, 256, 512 }, network, samples, count, best, bestSeconds);
+        tuneParameter(&KernelTuning::gemmBlockK, { 16, 32, 64, 128 }, network, samples, count, best, bestSeconds);
+    }
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < taskScheduler().maxLoopThreads(); threads *= 2) threadCounts.push_back(threads);
+    tuneParameter(&KernelTuning::threads, threadCounts, network, samples, count, best, bestSeconds);
+    tuneParameter(&KernelTuning::parallelMinWork, { size_t(1) << 12, size_t(1) << 13, size_t(1) << 14, size_t(1) << 16, size_t(1) << 17 },
+        network, samples, count, best, bestSeconds);
+
+    applyTuning(KernelTuning());
+    std::cout << "Autotuned " << topologyKey(checkpoint) << ": " << defaultSeconds * 1000.0 << " ms per training step untuned, "
+        << bestSeconds * 1000.0 << " ms tuned" << std::endl;
+    return best;
+}
+
+void prepareTuning(const Checkpoint& checkpoint, const DatasetView& samples, bool retune) {
+    std::string path = tuningFilePath();
+    std::string topology = topologyKey(checkpoint);
+    KernelTuning tuning;
+    if (!retune && loadTuning(path, topology, tuning)) {
+        std::cout << "Loaded kernel tuning for " << topology << " from " << path << std::endl;
+    }
+    else {
+        std::cout << "Autotuning kernels for " << topology << "..." << std::endl;
+        tuning = autotune(checkpoint, samples);
+        if (saveTuning(path, topology, tuning)) std::cout << "Saved kernel tuning to " << path << std::endl;
+    }
+    applyTuning(tuning);
+    printTuning(tuning);
+}
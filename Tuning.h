@@ -0,0 +1,19 @@
+#pragma once
+#include "Kernels.h"
+#include "Checkpoint.h"
+#include "Dataset.h"
+#include <string>
+
+// Kernel autotuner. The first training of a topology on a host times candidate kernel parameters (gemm cache
+// blocks, dot product unrolling, sparse/dense crossover, threads and chunk size of the layer loops) on a few
+// training steps and stores the fastest combination in kernel_tuning_<host>.txt, one line per topology.
+// Later runs load that line instead of measuring again; run the app with --retune to measure anew.
+
+std::string tuningFilePath(); // Tuning file of this host
+std::string topologyKey(const Checkpoint& checkpoint); // Input size and layer spec, e.g. "784:c4-m-64-10"
+bool loadTuning(const std::string& path, const std::string& topology, KernelTuning& tuning); // False if the file has no entry for the topology
+bool saveTuning(const std::string& path, const std::string& topology, const KernelTuning& tuning); // Add or replace the topology's entry
+KernelTuning autotune(const Checkpoint& checkpoint, const DatasetView& samples); // Time the candidates on training steps of the samples
+void applyTuning(const KernelTuning& tuning); // Kernels and the task scheduler use the parameters from now on
+void printTuning(const KernelTuning& tuning); // Report of the chosen parameters
+void prepareTuning(const Checkpoint& checkpoint, const DatasetView& samples, bool retune); // Load or measure (and save) the host's tuning, then apply it
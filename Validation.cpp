@@ -0,0 +1,127 @@
+#include "Validation.h"
+#include "Network.h"
+#include "Snapshot.h"
+#include "TaskScheduler.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+// Runs the validation set through the pure forward pass of the weights, the live network is never touched
+static ValidationResult evaluateSnapshot(const Checkpoint& snapshot, const DatasetView& samples, int epoch) {
+    TraceScope trace("Validation", "training", epoch);
+    ValidationResult result;
+    result.epoch = epoch;
+    WeightSnapshot weights(snapshot, 0);
+    Workspace work;
+    int correct = 0;
+    std::pair<int, std::vector<float>> sample;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples.sample(i, sample);
+        weights.forward(sample.second, work);
+        const std::vector<float>& out = work.activations.back();
+        result.loss += Network::computeLoss(sample.first, out);
+        if (std::max_element(out.begin(), out.end()) - out.begin() == sample.first) correct++;
+    }
+    result.accuracy = static_cast<float>(correct) / samples.size();
+    result.loss /= samples.size();
+    return result;
+}
+
+Validator::Validator(int patience) : patience(patience) {}
+
+Validator::~Validator() {
+    queuedEpoch = 0;
+    finish();
+}
+
+void Validator::reset(Dataset samples) {
+    queuedEpoch = 0; // The old run's weights are not worth evaluating any more
+    finish();
+    validationSet = std::move(samples);
+    best = Checkpoint();
+    bestAccuracy = -1.f;
+    bestEpoch = 0;
+    badEvaluations = 0;
+}
+
+bool Validator::isEnabled() const {
+    return !validationSet.empty();
+}
+
+void Validator::submit(Checkpoint snapshot, int epoch) {
+    if (!isEnabled()) return;
+    poll();
+    if (pending.valid()) {
+        // Still evaluating: the trainer does not wait, only the newest snapshot is kept for later
+        if (queuedEpoch > 0) std::cout << "Validation of epoch " << queuedEpoch << " skipped, epoch " << epoch << " is newer" << std::endl;
+        queuedSnapshot = std::move(snapshot);
+        queuedEpoch = epoch;
+        return;
+    }
+    start(std::move(snapshot), epoch);
+}
+
+void Validator::start(Checkpoint snapshot, int epoch) {
+    pendingSnapshot = std::move(snapshot);
+    const Checkpoint* weights = &pendingSnapshot;
+    const Dataset* samples = &validationSet;
+    pending = taskScheduler().submit([weights, samples, epoch]() {
+        return evaluateSnapshot(*weights, *samples, epoch);
+    });
+}
+
+void Validator::startQueued() {
+    if (queuedEpoch == 0) return;
+    int epoch = queuedEpoch;
+    queuedEpoch = 0;
+    start(std::move(queuedSnapshot), epoch);
+}
+
+bool Validator::poll() {
+    if (!pending.valid() || pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+    handle(pending.get());
+    startQueued();
+    return true;
+}
+
+void Validator::finish() {
+    while (pending.valid()) {
+        handle(pending.get());
+        startQueued();
+    }
+}
+
+void Validator::handle(const ValidationResult& result) {
+    std::cout << "Validation in epoch " << result.epoch << ": accuracy " << result.accuracy * 100.0f
+        << "%, loss " << result.loss << std::endl;
+    if (result.accuracy > bestAccuracy) {
+        bestAccuracy = result.accuracy;
+        bestEpoch = result.epoch;
+        best = std::move(pendingSnapshot);
+        badEvaluations = 0;
+    }
+    else {
+        badEvaluations++;
+    }
+}
+
+bool Validator::shouldStop() const {
+    return badEvaluations >= patience;
+}
+
+bool Validator::hasBest() const {
+    return bestAccuracy >= 0.f;
+}
+
+const Checkpoint& Validator::getBest() const {
+    return best;
+}
+
+float Validator::getBestAccuracy() const {
+    return bestAccuracy;
+}
+
+int Validator::getBestEpoch() const {
+    return bestEpoch;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "Checkpoint.h"
+#include "Dataset.h"
+#include <future>
+#include <utility>
+#include <vector>
+
+// Result of evaluating one weight snapshot on the validation set
+struct ValidationResult
+{
+	int epoch = 0; // Epoch the snapshot was taken in (1-based)
+	float accuracy = 0.f;
+	float loss = 0.f; // Mean cross-entropy
+};
+
+// Evaluates weight snapshots on a held-out validation set in a background thread and tracks early stopping.
+// The trainer keeps running while a snapshot is evaluated; results are picked up with poll(). submit() never waits:
+// a snapshot that arrives while the previous one is still evaluated is queued, and a newer one replaces it.
+class Validator
+{
+private:
+	Dataset validationSet; // Held-out samples, not modified while an evaluation runs
+	std::future<ValidationResult> pending; // Evaluation in progress (if valid)
+	Checkpoint pendingSnapshot; // Weights being evaluated
+	Checkpoint queuedSnapshot; // Latest snapshot submitted during an evaluation, started by poll() or finish()
+	int queuedEpoch = 0; // Epoch of queuedSnapshot, 0 if nothing is queued
+	Checkpoint best; // Weights with the best validation accuracy so far
+	float bestAccuracy = -1.f;
+	int bestEpoch = 0;
+	int patience; // Evaluations without improvement before stopping
+	int badEvaluations = 0; // Evaluations since the last improvement
+	void handle(const ValidationResult& result); // Update best weights and patience
+	void start(Checkpoint snapshot, int epoch); // Evaluate in the background, no evaluation may be running
+	void startQueued(); // Start the queued snapshot, if any
+
+public:
+	Validator(int patience = 3);
+	~Validator();
+	void reset(Dataset samples); // New training run with a new validation set
+	bool isEnabled() const; // True if there are validation samples
+	void submit(Checkpoint snapshot, int epoch); // Start evaluating a snapshot, or queue it if one is running (never waits)
+	bool poll(); // Handle a finished evaluation and start the queued one without blocking, true if one was handled
+	void finish(); // Wait for the evaluation in progress and the queued one
+	bool shouldStop() const; // True once patience is exhausted
+	bool hasBest() const; // True if at least one snapshot was evaluated
+	const Checkpoint& getBest() const; // Weights with the best validation accuracy
+	float getBestAccuracy() const;
+	int getBestEpoch() const;
+};
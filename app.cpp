@@ -2,6 +2,22 @@
 #include "Button.h"
 #include "Layer.h"
 #include "Network.h"
+#include "Benchmark.h"
+#include "Dataset.h"
+#include "MappedDataset.h"
+#include "StreamingDataset.h"
+#include "Sweep.h"
+#include "DataParallel.h"
+#include "Validation.h"
+#include "Random.h"
+#include "Export.h"
+#include "SelfCheck.h"
+#include "Pipeline.h"
+#include "Trace.h"
+#include "Tuning.h"
+#include "Ensemble.h"
+#include "OnlineTuning.h"
+#include "TaskScheduler.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -9,16 +25,23 @@
 ################################################################
 
 After several test some of the ideal parameters in order to get best results:
--> Learning rate: 0.001
+-> Learning rate: 0.001 (run the app with --sweep to search learning rates and topologies in parallel)
 
 Number of epochs can increased but each epoch lasts for approximately 30 seconds to finish
-(Model with maximum layer count (5) and maximum neuron count (58) lasts 38 seconds per epoch)
+(Model with 5 layers and 58 neurons in total lasts 38 seconds per epoch)
 
 ################################################################
 */
 
 float learning_rate = 0.001f; // Learning rate for gradient descent
 int epochs = 10; // Number of epochs for training
+int fineTuneEpochs = 2; // Number of epochs after editing a trained network in place
+float validationSplit = 0.1f; // Fraction of the training data held out for validation
+int patience = 3; // Validations without improvement before training stops early
+int validateEvery = 0; // Training samples between validations (0: once per epoch)
+int pipelineStages = 1; // Threads for pipeline-parallel training (P key toggles), 1 trains sample by sample
+int microBatches = 8; // Micro-batches per pipeline batch (one weight update)
+int microBatchSize = 4; // Samples per micro-batch
 
 // This function initializes button positions and checks their pressed state
 void initializeButtons(Button* buttonList[MAX_BUTTONS], GUI& window, sf::Event& event, int padding = 10) {
@@ -32,36 +55,11 @@ void initializeButtons(Button* buttonList[MAX_BUTTONS], GUI& window, sf::Event&
     }
 }
 
-// This function loads the dataset from a CSV file and normalizes pixel values
-std::vector<std::pair<int, std::vector<float>>> loadDataset(const std::string& filename) {
-    std::vector<std::pair<int, std::vector<float>>> dataset;
-    std::ifstream file(filename);
-    if (!file) {
-        std::cerr << "Error loading dataset " << filename << std::endl;
-        return dataset;
-    }
-
-    std::string line;
-    while (std::getline(file, line)) {
-        std::vector<char> buffer(line.begin(), line.end());
-        buffer.push_back('\0');
-        char* next_token;
-        const char* delim = ",";
-        char* token = strtok_s(buffer.data(), delim, &next_token);
-        if (!token) continue;
-        int label = std::atoi(token);
-        std::vector<float> pixels;
-        token = strtok_s(nullptr, delim, &next_token);
-        while (token != nullptr) {
-            float value = std::atof(token) / 255.0f;
-            pixels.push_back(value);
-            token = strtok_s(nullptr, delim, &next_token);
-        }
-        if (pixels.size() == GRID_COUNT * GRID_COUNT) {
-            dataset.emplace_back(label, pixels);
-        }
-    }
-
+// This function loads the dataset from a CSV file (one byte per pixel, scaled to [0, 1] when a sample is used).
+// The first line fixes the number of pixels, the labels the number of classes.
+Dataset loadDataset(const std::string& filename) {
+    Dataset dataset;
+    dataset.loadCsv(filename);
     return dataset;
 }
 bool neuron_flag = false; // Used to track if a neuron is selected
@@ -71,12 +69,234 @@ bool trainPressed = false; // True if train button was pressed
 Layer* prevLayer = nullptr; // Tracks the previously selected layer
 Network* network = nullptr; // Pointer to the neural network instance
 bool trainingMode = false; // Indicates if the network is in training mode
+bool editNotified = false; // True once the user was told about an in-place edit
+
+// Number of neurons added/removed per click: Shift x16, Ctrl x128 (for wide layers)
+int neuronStep() {
+    if (sf::Keyboard::isKeyPressed(sf::Keyboard::LControl) || sf::Keyboard::isKeyPressed(sf::Keyboard::RControl)) return 128;
+    if (sf::Keyboard::isKeyPressed(sf::Keyboard::LShift) || sf::Keyboard::isKeyPressed(sf::Keyboard::RShift)) return 16;
+    return 1;
+}
 int currentEpoch = 0; // Current epoch during training
-int sampleIndex = 0; // Index of current training sample
-std::vector<std::pair<int, std::vector<float>>> dataset; // Training or test dataset
+size_t sampleIndex = 0; // Index of current training sample
+Dataset dataset; // Training or test dataset
+Dataset trainingData; // Training CSV parsed once: its shape is read at startup and every training run copies it
+std::pair<int, std::vector<float>> currentSample; // Decoded sample, reused by the training and test loops
 static float epochLoss = 0.f; // Accumulates loss over one epoch
+Validator validator(patience); // Evaluates weight snapshots in the background and decides early stopping
+PipelineTrainer* pipeline = nullptr; // Stage threads while training in pipeline-parallel mode
+double epochStart = 0.0; // Trace clock at the start of the current epoch
+bool retuneKernels = false; // --retune: measure the kernel parameters again instead of loading this host's tuning file
+std::string trainPath = "assets/mnist_data_train.csv"; // --data: training and test CSV files
+std::string testPath = "assets/mnist_data_test.csv";
+std::string streamPath; // --stream: binary dataset streamed from disk instead of loading the CSV into memory
+StreamingDataset stream; // Open while training from streamPath
+Dataset streamBatch; // Samples of the current training step when streaming
+const size_t STREAM_TUNING_SAMPLES = 1024; // Samples drawn from the stream for the kernel autotuner
+Ensemble ensemble; // Checkpoints from --ensemble and snapshots added with the M key, used by Test and the canvas
+OnlineTuner onlineTuner("assets/mnist_data_train.csv", learning_rate); // Fine-tunes on canvas digits labelled with the number keys
+std::vector<float> canvasInput; // Last digit drawn on the canvas that the network predicted
+const double SNAPSHOT_INTERVAL = 2e5; // Trace clock microseconds between weight snapshots while training (readers see weights at most this old)
+double lastSnapshot = 0.0; // Trace clock of the last published snapshot
+Workspace displayWork; // Buffers of canvas predictions and the visualizer, run on weight snapshots
+std::pair<int, std::vector<float>> displaySample; // Training sample the visualizer shows
+
+// The training CSV, parsed by the first call (the class count needs every label)
+const Dataset& loadedTrainingData() {
+    if (trainingData.empty()) trainingData = loadDataset(trainPath);
+    return trainingData;
+}
+
+// Input shape and class count of the training data, read once (binary header when streaming, else the CSV).
+// New networks take their input shape from it and the output layer is limited to its classes.
+const DataShape& trainingShape() {
+    static DataShape shape;
+    static bool known = false;
+    if (!known) {
+        StreamingDataset header;
+        if (!streamPath.empty() && header.open(streamPath, 0.f)) shape = header.shape();
+        else shape = loadedTrainingData().shape();
+        known = true;
+    }
+    return shape;
+}
+
+// Canvas prediction on the latest weight snapshot, safe while training runs
+void printCanvasPrediction(const std::vector<float>& input) {
+    std::shared_ptr<const WeightSnapshot> model = network->snapshot();
+    if (!model || model->inputSize() != input.size()) return;
+    int predictedDigit = model->predict(input, displayWork);
+    const std::vector<float>& prediction = displayWork.activations.back();
+    network->showActivity(displayWork);
+    std::cout << "Predicted digit: " << predictedDigit << std::endl;
+    std::cout << "Confidence scores:" << std::endl;
+    for (size_t i = 0; i < prediction.size(); i++) {
+        std::cout << "  " << i << ": " << prediction[i] * 100.0f << "%" << std::endl;
+    }
+}
+
+// Combined prediction of the ensemble for the drawing canvas
+void printEnsemblePrediction(const std::vector<float>& input) {
+    std::vector<float> probabilities = ensemble.predict(input);
+    if (probabilities.empty()) return;
+    int digit = static_cast<int>(std::max_element(probabilities.begin(), probabilities.end()) - probabilities.begin());
+    std::cout << "Ensemble of " << ensemble.size() << " predicts digit " << digit << " (" << probabilities[digit] * 100.0f << "%)" << std::endl;
+}
+
+// The 28x28 canvas scaled to the input shape of the network and of the ensemble
+void predictCanvas(const std::vector<float>& grid) {
+    if (network && network->isReady()) {
+        canvasInput = Input::resample(grid, network->getInputShape());
+        printCanvasPrediction(canvasInput);
+    }
+    if (!ensemble.empty()) printEnsemblePrediction(Input::resample(grid, ensemble.inputShape()));
+}
+
+// Opens the stream or loads the training CSV; false if it cannot be read or does not fit the network input
+bool openTrainingData() {
+    if (!streamPath.empty() && !stream.open(streamPath, validationSplit)) {
+        std::cout << "Cannot stream " << streamPath << ", training not started.\n";
+        return false;
+    }
+    if (!stream.isOpen()) dataset = loadedTrainingData(); // A copy, training shuffles and splits it
+    size_t inputs = stream.isOpen() ? stream.inputSize() : dataset.inputSize();
+    if (inputs != static_cast<size_t>(network->getInputShape().size())) {
+        std::cout << (stream.isOpen() ? streamPath : trainPath) << " has " << inputs << " pixels per sample, the network "
+            << network->getInputShape().size() << " inputs, training not started.\n";
+        stream.close();
+        dataset.clear();
+        return false;
+    }
+    return true;
+}
+
+// Ends training, waits for the last validation and restores the best validated weights
+void finishTraining(GUI& window) {
+    trainingMode = false;
+    if (pipeline) {
+        pipeline->printReport();
+        delete pipeline;
+        pipeline = nullptr;
+    }
+    stream.close();
+    validator.finish();
+    if (validator.hasBest()) {
+        if (network->setCheckpoint(validator.getBest())) {
+            std::cout << "Restored weights from epoch " << validator.getBestEpoch() << " (validation accuracy "
+                << validator.getBestAccuracy() * 100.0f << "%)" << std::endl;
+        }
+        else {
+            std::cout << "Topology changed during training, keeping the current weights." << std::endl;
+        }
+    }
+    std::cout << "Training finished.\n";
+    window.getInput()->clearGrid();
+    window.drawInput();
+}
+
+int main(int argc, char* argv[]) {
+    // Options before the mode: --seed N (fixed seed for reproducible runs), --trace [file] (timeline, default trace.json),
+    // --retune (autotune the kernels again at the next training), --stream [file] (train from a binary dataset read
+    // from disk in chunks, default assets/mnist_data_train.bin, converted from the CSV of the same name if missing),
+    // --ensemble file[:weight] ... (checkpoints evaluated together with the network by Test and the canvas),
+    // --data train.csv [test.csv] (other datasets, e.g. Fashion-MNIST or EMNIST; input shape and classes come from the data)
+    std::vector<std::string> ensembleFiles;
+    int firstArg = 1;
+    while (argc > firstArg) {
+        std::string option = argv[firstArg];
+        if (option == "--seed" && argc > firstArg + 1) {
+            setRandomSeed(std::strtoull(argv[firstArg + 1], nullptr, 10));
+            firstArg += 2;
+        }
+        else if (option == "--trace") {
+            bool hasPath = argc > firstArg + 1 && argv[firstArg + 1][0] != '-';
+            startTracing(hasPath ? argv[firstArg + 1] : "trace.json");
+            firstArg += hasPath ? 2 : 1;
+        }
+        else if (option == "--retune") {
+            retuneKernels = true;
+            firstArg++;
+        }
+        else if (option == "--stream") {
+            bool hasPath = argc > firstArg + 1 && argv[firstArg + 1][0] != '-';
+            streamPath = hasPath ? argv[firstArg + 1] : "assets/mnist_data_train.bin";
+            firstArg += hasPath ? 2 : 1;
+        }
+        else if (option == "--data" && argc > firstArg + 1) {
+            trainPath = argv[firstArg + 1];
+            bool hasTest = argc > firstArg + 2 && argv[firstArg + 2][0] != '-';
+            if (hasTest) testPath = argv[firstArg + 2];
+            onlineTuner.setReplayPath(trainPath);
+            firstArg += hasTest ? 3 : 2;
+        }
+        else if (option == "--ensemble") {
+            for (firstArg++; argc > firstArg && argv[firstArg][0] != '-'; firstArg++) ensembleFiles.push_back(argv[firstArg]);
+        }
+        else break;
+    }
+    struct TraceGuard { ~TraceGuard() { stopTracing(); } } traceGuard; // Writes the trace on every return path
+    setTraceThreadName("Main");
+    std::cout << "Random seed: " << getRandomSeed() << std::endl;
+    if (!streamPath.empty() && !std::ifstream(streamPath)) {
+        size_t extension = streamPath.rfind('.');
+        std::string csvPath = streamPath.substr(0, extension) + ".csv";
+        if (!StreamingDataset::convertCsv(csvPath, streamPath)) return 1;
+    }
+    if (!ensembleFiles.empty()) {
+        if (!ensemble.addFiles(ensembleFiles)) return 1;
+        ensemble.printMembers();
+    }
+
+    // Command line benchmark mode, no window needed
+    if (argc > firstArg && std::string(argv[firstArg]) == "--bench") {
+        runSpecializedBenchmark(loadDataset("assets/mnist_data_test.csv").decode(), learning_rate);
+        return 0;
+    }
+
+    // Training throughput as the input width grows, on the training data upscaled to each width
+    if (argc > firstArg && std::string(argv[firstArg]) == "--bench-inputs") {
+        std::vector<int> widths;
+        std::stringstream list(argc > firstArg + 1 ? argv[firstArg + 1] : "28,56,112,224");
+        std::string width;
+        while (std::getline(list, width, ',')) {
+            if (std::atoi(width.c_str()) > 0) widths.push_back(std::atoi(width.c_str()));
+        }
+        runInputScalingBenchmark(loadDataset(trainPath), widths);
+        return 0;
+    }
+
+    // Frame time of the batched renderer against one draw call per shape
+    if (argc > firstArg && std::string(argv[firstArg]) == "--bench-frame") {
+        runFrameBenchmark(loadDataset(trainPath));
+        return 0;
+    }
+
+    // Compare every backend against the reference implementation
+    if (argc > firstArg && std::string(argv[firstArg]) == "--self-check") {
+        return runSelfCheck(std::vector<std::string>(argv + firstArg + 1, argv + argc)) ? 0 : 1;
+    }
+
+    // Self-check of the standalone header written with X / Shift+X
+    if (argc > firstArg && std::string(argv[firstArg]) == "--check-export") {
+        return runExportCheck(loadDataset("assets/mnist_data_test.csv").decode()) ? 0 : 1;
+    }
+
+    // Command line hyperparameter sweep or multi-process training, every run or process reads the same memory-mapped training set
+    if (argc > firstArg && (std::string(argv[firstArg]) == "--sweep" || std::string(argv[firstArg]) == "--data-parallel")) {
+        const std::string binaryPath = trainPath.substr(0, trainPath.rfind('.')) + ".bin";
+        MappedDataset trainSet;
+        if (!std::ifstream(binaryPath)) StreamingDataset::convertCsv(trainPath, binaryPath);
+        if (!trainSet.open(binaryPath)) return 1;
+        std::vector<std::string> options(argv + firstArg + 1, argv + argc);
+        if (std::string(argv[firstArg]) == "--sweep") runSweep(trainSet, options);
+        else runDataParallel(trainSet, options);
+        return 0;
+    }
+
+    const DataShape& shape = trainingShape();
+    std::cout << "Training data: " << shape.input.channels << "x" << shape.input.height << "x" << shape.input.width << " inputs, "
+        << shape.classes << " classes" << std::endl;
 
-int main() {
     // Create the main application window
 	GUI window(1000, 600, "Neural Network GUI");
 
@@ -93,6 +313,8 @@ int main() {
     // Main application loop
     while (window.isOpen())
     {
+        TraceScope frameTrace("Frame", "frame");
+        TraceScope eventsTrace("Events", "frame");
         // check all the window's events that were triggered since the last iteration of the loop
         sf::Event event;
         while (window.pollEvent(event))
@@ -104,10 +326,65 @@ int main() {
             // Layer addition
             if (addLayerButton.isPressed(event, window)) {
                 window.addLayer();
-            }            
+            }
+            // Right click selects the type of the next layer
+            if (addLayerButton.isRightClicked(event, window)) {
+                window.cycleLayerType();
+                addLayerButton.setText(std::string("Add ") + layerTypeName(window.getNextLayerType()));
+            }
+
+            // Export the built topology as a compile-time specialized header (E key)
+            if (network && event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::E) {
+                network->exportSpecializedHeader("ExportedNetwork.h", "exported_network.ckpt");
+            }
+
+            // Export a standalone header for deployment without the app (X key, Shift+X for int8 weights)
+            if (network && event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::X) {
+                if (network->isReady()) {
+                    exportStandaloneHeader(network->getCheckpoint(), "ExportedModel.h", "exported_model.ckpt", event.key.shift);
+                }
+                else {
+                    std::cout << "Cannot export, each layer must have at least one neuron and the last layer must be Dense.\n";
+                }
+            }
+
+            // Add a snapshot of the current network to the ensemble (M key, Shift+M clears the ensemble)
+            if (!trainingMode && event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::M) {
+                if (event.key.shift) {
+                    ensemble.clear();
+                    std::cout << "Ensemble cleared.\n";
+                }
+                else if (network && network->isReady()) {
+                    if (ensemble.add(network->getCheckpoint(), 1.0f, "GUI network " + std::to_string(ensemble.size() + 1))) ensemble.printMembers();
+                }
+                else {
+                    std::cout << "There is no built network to add to the ensemble!\n";
+                }
+            }
+
+            // Number keys label the last drawn digit, a background job fine-tunes the network on it
+            if (!trainingMode && network && network->isReady() && !canvasInput.empty() && event.type == sf::Event::KeyPressed &&
+                event.key.code >= sf::Keyboard::Num0 && event.key.code <= sf::Keyboard::Num9) {
+                int label = event.key.code - sf::Keyboard::Num0;
+                onlineTuner.addCorrection(network->getCheckpoint(), canvasInput, label);
+                std::cout << "Learning the drawn digit as " << label << " (" << onlineTuner.correctionCount() << " corrections)" << std::endl;
+            }
+
+            // Toggle pipeline-parallel training for the next run (P key)
+            if (!trainingMode && event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::P) {
+                pipelineStages = pipelineStages > 1 ? 1 : std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+                if (pipelineStages > 1) {
+                    std::cout << "Pipeline training on " << pipelineStages << " stages, " << microBatches << " micro-batches of "
+                        << microBatchSize << " samples per update.\n";
+                }
+                else {
+                    std::cout << "Sample-by-sample training.\n";
+                }
+            }
 
             bool needToRestartLoop = false;
             auto& layerList = window.getLayerList();
+            HitIndex::Hit hit = window.hitTest(event); // Mouse position is mapped once per event
 
             // Traverse layers to manage interactions
             for (auto it = layerList.begin(); it != layerList.end();) {
@@ -122,11 +399,11 @@ int main() {
                 auto& neuronList = layer->getNeuronList();
                 bool anyNeuronSelected = false;
                 
-                // Traverse neurons in layer
-                if(!neuronList.empty()){
+                // Traverse neurons in layer (wide layers are drawn as a strip without clickable neurons)
+                if(!neuronList.empty() && !layer->isAggregated()){
                     for (auto itt = neuronList.begin(); itt != neuronList.end();) {
                         Neuron* neuron = *itt;
-                        neuron->isSelected(event, window);
+                        neuron->isSelected(event, hit.neuron == neuron);
                         neuron_flag = neuron->checkActive();
 
                         // Delete neuron with DELETE key
@@ -144,7 +421,7 @@ int main() {
                 }
 
                 // Handle layer selection
-                layer->isSelected(event, window);
+                layer->isSelected(event, hit.layer == layer && !hit.neuron);
                 if (layer_flag) {
                     if (prevLayer != nullptr && prevLayer != layer) {
                         if (prevLayer->checkActive()) {
@@ -154,10 +431,14 @@ int main() {
                     prevLayer = layer;
                 }
 
-                // Enforce output layer max 10 neurons
-                if (layer == layerList.back() && layer->getNeuronCount() == 11) {
-                    std::cout << "Last layer must have 10 neurons maximum\n";
-                    window.deleteNeuron(layer, layer->getNeuronList().back());
+                // Enforce output layer max one neuron per class of the training data
+                int classes = trainingShape().classes;
+                if (layer == layerList.back() && classes > 0 && layer->getNeuronCount() > classes) {
+                    std::cout << "Last layer must have " << classes << " neurons maximum\n";
+                    while (layer->getNeuronCount() > classes) {
+                        window.deleteNeuron(layer, layer->getNeuronList().back());
+                    }
+                    window.repositionNeurons(layer);
                     needToRestartLoop = true;
                     continue;
                 }
@@ -172,10 +453,33 @@ int main() {
                     continue;
                 }
                 else if (layer_flag && addNeuronButton.isPressed(event, window)) {
-                    window.addNeuron(layer);
+                    window.addNeuron(layer, neuronStep());
                     addNeuronPressed = true;
                 }
 
+                // Remove neurons from the end of the selected layer with BACKSPACE
+                else if (layer_flag && event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::BackSpace) {
+                    for (int i = neuronStep(); i > 0 && !neuronList.empty(); i--) {
+                        window.deleteNeuron(layer, neuronList.back());
+                    }
+                    window.repositionNeurons(layer);
+                }
+
+                // Cycle the activation of the selected hidden layer with A (also on a built network, weights are kept)
+                else if (layer_flag && event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::A) {
+                    if (!hasParameters(layer->getType())) {
+                        std::cout << "Pooling layers have no activation function.\n";
+                    }
+                    else if (layer == layerList.back()) {
+                        std::cout << "The output layer always uses softmax.\n";
+                    }
+                    else {
+                        layer->setActivation(nextActivation(layer->getActivation()));
+                        if (network) network->weightsChanged();
+                        std::cout << "Layer activation: " << activationName(layer->getActivation()) << "\n";
+                    }
+                }
+
                 // Build the network if all layers are valid
                 else if (buildButton.isPressed(event, window)) {
                     buildPressed = true;
@@ -188,8 +492,14 @@ int main() {
                                 break;
                             }
                         }
+                        if (canBuild && !window.getLayerList().empty() && window.getLayerList().back()->getType() != LayerType::Dense) {
+                            std::cout << "Cannot build network! The last layer must be Dense.\n";
+                            canBuild = false;
+                        }
                         if (canBuild) {
-                            network = new Network(learning_rate, epochs, &window);
+                            onlineTuner.cancel();
+                            network = new Network(learning_rate, epochs, &window, trainingShape().input);
+                            window.setNetwork(network);
                             std::cout << "Network created!" << std::endl;
                            
                         }
@@ -201,10 +511,41 @@ int main() {
                     if (!network) {
                         std::cout << "There is no built network!\n";
                     }
-                    else {
-                        dataset = loadDataset("assets/mnist_data_train.csv");
+                    else if (trainingMode) {
+                        // A restart would replace the running pipeline stages, stream and validation split under the trainer
+                        std::cout << "Training is already running.\n";
+                    }
+                    else if (!network->isReady()) {
+                        std::cout << "Each layer must have at least one neuron and the last layer must be Dense.\n";
+                    }
+                    else if (openTrainingData()) {
+                        onlineTuner.cancel(); // Weights of a job that started before training would overwrite the trained ones
+                        // Edited networks keep their weights and only need a short fine-tune
+                        network->setEpoch(network->wasEdited() ? fineTuneEpochs : epochs);
+                        network->clearEdited();
+                        editNotified = false;
+                        if (stream.isOpen()) {
+                            // Out-of-core training: the end of the file is the validation set, the rest is streamed
+                            dataset.clear();
+                            validator.reset(stream.holdoutSet());
+                            stream.startEpoch(threadRandom());
+                            stream.nextBatch(streamBatch, STREAM_TUNING_SAMPLES);
+                            prepareTuning(network->getCheckpoint(), streamBatch, retuneKernels);
+                            stream.startEpoch(threadRandom());
+                            std::cout << "Streaming " << stream.size() << " samples from " << streamPath << std::endl;
+                        }
+                        else {
+                            // Hold out the end of the shuffled data for validation
+                            dataset.shuffle(threadRandom());
+                            validator.reset(dataset.split(static_cast<size_t>(dataset.size() * validationSplit)));
+                            // Kernel parameters of this topology: loaded from the host's tuning file, measured on first use
+                            prepareTuning(network->getCheckpoint(), dataset, retuneKernels);
+                        }
+                        retuneKernels = false;
                         currentEpoch = 0;
                         sampleIndex = 0;
+                        epochStart = traceClock();
+                        if (pipelineStages > 1) pipeline = new PipelineTrainer(*network, pipelineStages, microBatches, microBatchSize);
                         trainingMode = true;
                         std::cout << "Training started...\n";
                     }
@@ -212,86 +553,152 @@ int main() {
 
                 // Test the network
                 else if (testButton.isPressed(event, window)) {
-                    if (!network) std::cout << "There is no built network!\n";
+                    if (!network && ensemble.empty()) std::cout << "There is no built network!\n";
+                    else if (network && !network->isReady() && ensemble.empty()) std::cout << "Each layer must have at least one neuron and the last layer must be Dense.\n";
                     else {
-                        int score = 0;
-                        dataset = loadDataset("assets/mnist_data_test.csv");
-                        for (auto& elem : dataset) {
-                            auto out = network->forwardPass(elem);
-                            int predictedLbl = network->predict(out);
-                            if (predictedLbl == elem.first) score += 1;
+                        // Own dataset and the latest weight snapshot, so testing while training leaves the trainer alone
+                        Dataset testSet = loadDataset(testPath);
+                        if (network && network->isReady()) network->publishSnapshot();
+                        std::shared_ptr<const WeightSnapshot> model = network ? network->snapshot() : nullptr;
+                        if (model && model->inputSize() == testSet.inputSize()) {
+                            // Snapshot inference is pure, chunks of the test set run in parallel with their own buffers
+                            std::atomic<int> score{ 0 };
+                            taskScheduler().parallelFor(0, testSet.size(), 64, [&](size_t begin, size_t end) {
+                                Workspace testWork;
+                                std::pair<int, std::vector<float>> sample;
+                                int correct = 0;
+                                for (size_t i = begin; i < end; ++i) {
+                                    testSet.sample(i, sample);
+                                    if (model->predict(sample.second, testWork) == sample.first) correct++;
+                                }
+                                score += correct;
+                            });
+                            float accuracy = static_cast<float>(score) / testSet.size() * 100.f;
+                            std::cout << "Accuracy: " << accuracy << "% (weights version " << model->getVersion() << ")" << std::endl;
+                        }
+                        else if (model) {
+                            std::cout << testPath << " has " << testSet.inputSize() << " pixels per sample, the network " << model->inputSize() << " inputs.\n";
+                        }
+                        // The ensemble is compared with its best member and timed against it
+                        if (!ensemble.empty()) {
+                            ensemble.printMembers();
+                            Ensemble::printReport(ensemble.evaluate(testSet));
                         }
-                        float accuracy = static_cast<float>(score) / dataset.size() * 100.f;
-                        std::cout << "Accuracy: " << accuracy << "%" << std::endl;
                     }
                 }
                 ++it;
                 
             }
         }
+        eventsTrace.end();
 
 
         window.clear(sf::Color::White); // Clear the window with white background
+
+        // Weights published by the online fine-tuning job (topology edits in the meantime make them unusable)
+        Checkpoint onlineWeights;
+        if (onlineTuner.takeUpdate(onlineWeights) && network && !trainingMode) {
+            if (network->setCheckpoint(onlineWeights)) std::cout << "Network fine-tuned on the drawn digits." << std::endl;
+            else std::cout << "Topology changed, online fine-tuning result discarded." << std::endl;
+        }
         
         // Training loop
-        if (trainingMode && !dataset.empty()) {
+        if (trainingMode && (stream.isOpen() || !dataset.empty()) && network->isReady()) {
+            TraceScope trainingTrace("Training step", "training");
             if (currentEpoch < network->getEpoch()) {
-                if (trainingMode && sampleIndex < dataset.size()) {
-                    auto currentSample = dataset[sampleIndex];
-                    auto prediction = network->forwardPass(currentSample);
-                    epochLoss += network->computeLoss(currentSample.first, prediction);
-                    network->backPropagation(currentSample);
-                    ++sampleIndex;
+                // When streaming, every step trains on a fresh batch of the stream and an empty batch ends the epoch
+                size_t stepSamples = pipeline ? pipeline->batchSize() : 1;
+                bool hasSamples = stream.isOpen() ? stream.nextBatch(streamBatch, stepSamples) > 0 : sampleIndex < dataset.size();
+                if (trainingMode && hasSamples) {
+                    const DatasetView& samples = stream.isOpen() ? static_cast<const DatasetView&>(streamBatch) : dataset;
+                    size_t first = stream.isOpen() ? 0 : sampleIndex;
+                    size_t previousIndex = sampleIndex;
+                    if (pipeline) {
+                        // One batch per frame, the stage threads work through its micro-batches
+                        epochLoss += pipeline->trainBatch(samples, first, first + stepSamples);
+                        sampleIndex += std::min(samples.size(), first + stepSamples) - first;
+                    }
+                    else {
+                        samples.sample(first, currentSample);
+                        network->forwardPass(currentSample);
+                        epochLoss += network->backPropagation(currentSample); // Loss comes from the fused softmax + cross-entropy
+                        ++sampleIndex;
+                    }
+                    if (validateEvery > 0 && sampleIndex / static_cast<size_t>(validateEvery) != previousIndex / static_cast<size_t>(validateEvery)) {
+                        validator.submit(network->getCheckpoint(), currentEpoch + 1);
+                    }
+                }
+                else if (trainingMode && stream.failed()) {
+                    std::cout << "Reading " << streamPath << " failed, stopping training." << std::endl;
+                    finishTraining(window);
                 }
                 else if (trainingMode) {
 
-                    std::cout << "Epoch " << currentEpoch + 1 << " completed. Loss: " << epochLoss / dataset.size() << std::endl;
+                    std::cout << "Epoch " << currentEpoch + 1 << " completed. Loss: " << epochLoss / std::max<size_t>(1, sampleIndex) << std::endl;
+                    Network::reportActivity(pipeline ? pipeline->takeActivity() : network->takeActivity());
+                    traceEvent("Epoch", "training", epochStart, traceClock() - epochStart, currentEpoch + 1);
+                    epochStart = traceClock();
+                    validator.submit(network->getCheckpoint(), currentEpoch + 1); // Evaluated while the next epoch trains
                     sampleIndex = 0;
                     ++currentEpoch;
                     epochLoss = 0.0f;
-                    std::random_shuffle(dataset.begin(), dataset.end());
+                    if (stream.isOpen()) stream.startEpoch(threadRandom());
+                    else dataset.shuffle(threadRandom());
                     if (currentEpoch >= network->getEpoch()) {
-                        trainingMode = false;
-                        std::cout << "Training finished.\n";
-                        window.getInput()->clearGrid();
-                        window.drawInput();
+                        finishTraining(window);
                     }
                 }
+
+                // Stop early once validation stopped improving
+                if (trainingMode) validator.poll();
+                if (trainingMode && validator.shouldStop()) {
+                    std::cout << "No validation improvement for " << patience << " evaluations, stopping early." << std::endl;
+                    finishTraining(window);
+                }
             }
             else {
-                trainingMode = false;
-                std::cout << "Training finished.\n";
-                window.getInput()->clearGrid();
-                window.drawInput();
+                finishTraining(window);
+            }
+        }
+
+        // Publish the weights for inference: every frame they changed, at SNAPSHOT_INTERVAL while training
+        if (network && (!trainingMode || traceClock() - lastSnapshot >= SNAPSHOT_INTERVAL) && network->publishSnapshot()) {
+            lastSnapshot = traceClock();
+            // The visualizer shows the new snapshot's activity on the sample being trained
+            std::shared_ptr<const WeightSnapshot> model = network->snapshot();
+            bool hasSample = true;
+            if (trainingMode && stream.isOpen() && !streamBatch.empty()) streamBatch.sample(0, displaySample);
+            else if (trainingMode && sampleIndex < dataset.size()) dataset.sample(sampleIndex, displaySample);
+            else hasSample = false;
+            if (hasSample && model->inputSize() == displaySample.second.size()) {
+                model->forward(displaySample.second, displayWork);
+                network->showActivity(displayWork);
             }
         }
 
         initializeButtons(buttonList, window, event); // Update buttons 
         window.drawLayers(); // Draw layers
 
-        if (trainingMode && sampleIndex < dataset.size())
-            window.getInput()->showInGridArr(dataset[sampleIndex].second); // Show sample image
+        if (trainingMode && stream.isOpen() && !streamBatch.empty())
+            window.getInput()->showInGridArr(streamBatch.pixels(0), streamBatch.shape().input); // Show sample image
+        else if (trainingMode && sampleIndex < dataset.size())
+            window.getInput()->showInGridArr(dataset.pixels(sampleIndex), dataset.shape().input);
 
         for (auto& layer : window.getLayerList()) {
             window.drawNeurons(layer); // Draw neurons
         }
 
-        // Reset network if user edits after building
+        // Edits after building are applied to the live network, trained weights are kept
         if (buildPressed) {
-            if ((event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Delete) || addNeuronPressed) {
-                buildPressed = !buildPressed;
-                if (network) {
-                    delete network;
-                    network = nullptr;
-                    std::cout << "Network reset please create another one." << std::endl;
-                }
+            if (network && network->wasEdited() && !editNotified) {
+                editNotified = true;
+                std::cout << "Network updated in place, press Train to fine-tune for " << fineTuneEpochs << " epochs." << std::endl;
             }
 
             // Draw connections
-            if (!window.drawLines().empty()) {
-                for (auto& line : window.drawLines()) {
-                    window.draw(line.data(), 2, sf::Lines);
-                }
+            auto lineList = window.drawLines();
+            if (!lineList.empty()) {
+                window.drawConnections(lineList);
             }
             else {
                 buildPressed = !buildPressed;
@@ -304,17 +711,10 @@ int main() {
         
         // Prediction from grid input
         if (window.getInput()->shouldPredict()) {
-            if (network) {
+            if ((network && network->isReady()) || !ensemble.empty()) {
                 std::vector<float> input = window.getInput()->getGridValues();
                 if (!input.empty() && input.size() == GRID_COUNT * GRID_COUNT) {
-                    std::pair<int, std::vector<float>> sampleData = { -1, input };
-                    auto prediction = network->forwardPass(sampleData);
-                    int predictedDigit = network->predict(prediction);
-                    std::cout << "Predicted digit: " << predictedDigit << std::endl;
-                    std::cout << "Confidence scores:" << std::endl;
-                    for (int i = 0; i < prediction.size(); i++) {
-                        std::cout << "  " << i << ": " << prediction[i] * 100.0f << "%" << std::endl;
-                    }
+                    predictCanvas(input);
                 }
                 else {
                     std::cout << "Debug: Invalid input size: " << input.size() << " (expected " << GRID_COUNT * GRID_COUNT << ")" << std::endl;
@@ -327,17 +727,10 @@ int main() {
         }
         
         for (auto& point : window.getInput()->takeInput(event, window)) {
-            if (window.getInput()->shouldPredict() && network) {
+            if (window.getInput()->shouldPredict() && ((network && network->isReady()) || !ensemble.empty())) {
                 std::vector<float> input = window.getInput()->getGridValues();
                 if (!input.empty() && input.size() == GRID_COUNT * GRID_COUNT) {
-                    std::pair<int, std::vector<float>> sampleData = { -1, input };
-                    auto prediction = network->forwardPass(sampleData);
-                    int predictedDigit = network->predict(prediction);
-                    std::cout << "Predicted digit: " << predictedDigit << std::endl;
-                    std::cout << "Confidence scores:" << std::endl;
-                    for (int i = 0; i < prediction.size(); i++) {
-                        std::cout << "  " << i << ": " << prediction[i] * 100.0f << "%" << std::endl;
-                    }
+                    predictCanvas(input);
                 }
                 else {
                     std::cout << "Invalid input size: " << input.size() << " (expected " << GRID_COUNT * GRID_COUNT << ")" << std::endl;
@@ -345,8 +738,10 @@ int main() {
                 window.getInput()->resetPredictFlag(); 
             }
         }
+        TraceScope displayTrace("display", "frame");
         window.display(); // Update the window
         addNeuronPressed= false; // Reset flag
     }
+    onlineTuner.cancel(); // The job uses the task scheduler, which is destroyed before the globals
 	return 0;
 }